@@ -9,6 +9,7 @@
 #include "globals.hpp"
 #include "ir.hpp"
 #include "ir_algo.hpp"
+#include "pgo.hpp"
 #include "lvar.hpp"
 #include "asm_proc.hpp"
 #include "thread.hpp"
@@ -550,7 +551,7 @@ static void build_incoming(Set& incoming, asm_node_t const& node, cfg_ht cfg)
             build_incoming(incoming, *input, cfg);
 }
 
-std::vector<asm_node_t*> asm_graph_t::order()
+std::vector<asm_node_t*> asm_graph_t::order(pgo_fn_t const* pgo)
 {
     struct edge_t
     {
@@ -581,13 +582,26 @@ std::vector<asm_node_t*> asm_graph_t::order()
                 build_incoming(incoming, node, node.cfg);
 
             unsigned depth = 0;
+            std::optional<std::uint64_t> weight;
+
+            auto const add_edge = [&](cfg_ht from)
+            {
+                depth = std::max<unsigned>(depth, edge_depth(from, other_cfg));
+                if(pgo)
+                    if(auto w = pgo->edge_weight(algo(from).preorder_i, algo(other_cfg).preorder_i))
+                        weight = std::max(weight.value_or(0), *w);
+            };
 
             if(incoming.empty())
-                depth = edge_depth(node.cfg, other_cfg);
+                add_edge(node.cfg);
             else
                 for(cfg_ht cfg : incoming)
-                    depth = std::max<unsigned>(depth, edge_depth(cfg, other_cfg));
+                    add_edge(cfg);
 
+            if(weight)
+                return int(std::min<std::uint64_t>(*weight, 1 << 16));
+            if(pgo)
+                return int(pgo_fn_t::ONCE_WEIGHT) << std::min<unsigned>(12, 2 * depth);
             return 1 << std::min<unsigned>(16, 2 * depth);
         };
 
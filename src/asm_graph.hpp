@@ -22,6 +22,7 @@ struct asm_inst_t;
 class locator_t;
 class fn_t;
 class lvars_manager_t;
+class pgo_fn_t;
 
 struct asm_node_t;
 struct asm_path_t;
@@ -113,7 +114,7 @@ public:
                      rh::batman_map<cfg_ht, switch_table_t> const& switch_tables);
     void finish_appending();
 
-    std::vector<asm_node_t*> order();
+    std::vector<asm_node_t*> order(pgo_fn_t const* pgo = nullptr);
     std::vector<asm_inst_t> to_linear(std::vector<asm_node_t*> order);
     void liveness(fn_t const& fn, lvars_manager_t& lvars);
     void optimize();
@@ -1,9 +1,14 @@
 #include "asm_proc.hpp"
 
+#include <optional>
+
 #include "flat/small_set.hpp"
 
 #include "format.hpp"
 #include "globals.hpp"
+#include "ir_algo.hpp"
+#include "options.hpp"
+#include "pgo.hpp"
 #include "runtime.hpp"
 #include "compiler_error.hpp"
 
@@ -360,9 +365,13 @@ void asm_proc_t::absolute_to_zp()
         if(inst.arg.lclass() == LOC_ADDR && inst.arg.data() >= 0x100)
             continue;
 
-        // 'zp_only' *has* to go on the zero page:
-        if(!inst.arg.mem_zp_only())
+        // 'zp_only' *has* to go on the zero page.
+        // With '--zp-cost', anything linked into the zero page uses it too.
+        if(!inst.arg.mem_zp_only()
+           && !(compiler_options().zp_cost && inst.arg.lclass() == LOC_ADDR && op_addr_mode(inst.op) == MODE_ABSOLUTE))
+        {
             continue;
+        }
 
         // OK! Replace with zp:
 
@@ -419,20 +428,17 @@ void asm_proc_t::convert_long_branch_ops()
             }
             else if(is_long_branch(inst.op))
             {
-                op_t const new_op = get_op(op_name(inst.op), MODE_RELATIVE);
-                int const size_diff = int(op_size(inst.op)) - int(op_size(new_op));
+                op_t const long_op = inst.op;
+                inst.op = get_op(op_name(inst.op), MODE_RELATIVE);
 
-                dist -= size_diff;
+                // Recalculate, as shrinking moves the branch's end.
+                dist = bytes_between(i, label_i) - int(op_size(inst.op));
 
                 // Change to short instruction when in range
                 if(dist <= 127 && dist >= -128)
-                {
-                    inst.op = new_op;
                     progress = true;
-
-                    passert(bytes_between(i, label_i) - int(op_size(inst.op)) <= 127, bytes_between(i, label_i) - int(op_size(inst.op)));
-                    passert(bytes_between(i, label_i) - int(op_size(inst.op)) >= -128, bytes_between(i, label_i) - int(op_size(inst.op)));
-                }
+                else
+                    inst.op = long_op;
             }
         }
     }
@@ -613,92 +619,99 @@ static std::pair<locator_t, locator_t> absolute_locs(asm_inst_t const& inst)
 }
 
 template<typename Fn>
-void asm_proc_t::for_each_inst(Fn const& fn) const
+static void expand_inst(asm_inst_t const& inst, Fn const& fn)
 {
-    for(asm_inst_t const& inst : code)
+    switch(inst.op)
     {
-        if(op_size(inst.op) == 0)
-            continue;
-
-        switch(inst.op)
+    case STORE_C_ABSOLUTE:
+        fn(asm_inst_t{ .op = PHP_IMPLIED });
+        fn(asm_inst_t{ .op = PHA_IMPLIED });
+        fn(asm_inst_t{ .op = LDA_IMMEDIATE, .arg = locator_t::const_byte(0) });
+        fn(asm_inst_t{ .op = ROL_IMPLIED });
+        fn(asm_inst_t{ .op = STA_ABSOLUTE, .arg = inst.arg });
+        fn(asm_inst_t{ .op = PLA_IMPLIED });
+        fn(asm_inst_t{ .op = PLP_IMPLIED });
+        // total bytes: 1+1+2+1+3+1+1 = 10
+        break;
+
+    case STORE_Z_ABSOLUTE:
+        fn(asm_inst_t{ .op = PHP_IMPLIED });
+        fn(asm_inst_t{ .op = PHA_IMPLIED });
+        fn(asm_inst_t{ .op = PHP_IMPLIED });
+        fn(asm_inst_t{ .op = PLA_IMPLIED });
+        fn(asm_inst_t{ .op = ALR_IMMEDIATE, .arg = locator_t::const_byte(0b10) });
+        fn(asm_inst_t{ .op = STA_ABSOLUTE, .arg = inst.arg });
+        fn(asm_inst_t{ .op = PLA_IMPLIED });
+        fn(asm_inst_t{ .op = PLP_IMPLIED });
+        // total bytes: 1+1+1+1+2+3+1+1 = 11
+        break;
+
+    case STORE_N_ABSOLUTE:
+        fn(asm_inst_t{ .op = PHP_IMPLIED });
+        fn(asm_inst_t{ .op = PHA_IMPLIED });
+        fn(asm_inst_t{ .op = PHP_IMPLIED });
+        fn(asm_inst_t{ .op = PLA_IMPLIED });
+        fn(asm_inst_t{ .op = ANC_IMMEDIATE, .arg = locator_t::const_byte(0x80) });
+        fn(asm_inst_t{ .op = ROL_IMPLIED });
+        fn(asm_inst_t{ .op = STA_ABSOLUTE, .arg = inst.arg });
+        fn(asm_inst_t{ .op = PLA_IMPLIED });
+        fn(asm_inst_t{ .op = PLP_IMPLIED });
+        // total bytes: 1+1+1+1+2+1+3+1+1 = 12
+        break;
+
+    case BANKED_Y_JSR:
+    case BANKED_Y_JMP:
         {
-        case STORE_C_ABSOLUTE:
-            fn(asm_inst_t{ .op = PHP_IMPLIED });
-            fn(asm_inst_t{ .op = PHA_IMPLIED });
-            fn(asm_inst_t{ .op = LDA_IMMEDIATE, .arg = locator_t::const_byte(0) });
-            fn(asm_inst_t{ .op = ROL_IMPLIED });
-            fn(asm_inst_t{ .op = STA_ABSOLUTE, .arg = inst.arg });
-            fn(asm_inst_t{ .op = PLA_IMPLIED });
-            fn(asm_inst_t{ .op = PLP_IMPLIED });
-            // total bytes: 1+1+2+1+3+1+1 = 10
-            break;
-
-        case STORE_Z_ABSOLUTE:
-            fn(asm_inst_t{ .op = PHP_IMPLIED });
-            fn(asm_inst_t{ .op = PHA_IMPLIED });
-            fn(asm_inst_t{ .op = PHP_IMPLIED });
-            fn(asm_inst_t{ .op = PLA_IMPLIED });
-            fn(asm_inst_t{ .op = ALR_IMMEDIATE, .arg = locator_t::const_byte(0b10) });
-            fn(asm_inst_t{ .op = STA_ABSOLUTE, .arg = inst.arg });
-            fn(asm_inst_t{ .op = PLA_IMPLIED });
-            fn(asm_inst_t{ .op = PLP_IMPLIED });
-            // total bytes: 1+1+1+1+2+3+1+1 = 11
-            break;
-
-        case STORE_N_ABSOLUTE:
-            fn(asm_inst_t{ .op = PHP_IMPLIED });
-            fn(asm_inst_t{ .op = PHA_IMPLIED });
-            fn(asm_inst_t{ .op = PHP_IMPLIED });
-            fn(asm_inst_t{ .op = PLA_IMPLIED });
-            fn(asm_inst_t{ .op = ANC_IMMEDIATE, .arg = locator_t::const_byte(0x80) });
-            fn(asm_inst_t{ .op = ROL_IMPLIED });
-            fn(asm_inst_t{ .op = STA_ABSOLUTE, .arg = inst.arg });
-            fn(asm_inst_t{ .op = PLA_IMPLIED });
-            fn(asm_inst_t{ .op = PLP_IMPLIED });
-            // total bytes: 1+1+1+1+2+1+3+1+1 = 12
-            break;
-
-        case BANKED_Y_JSR:
-        case BANKED_Y_JMP:
+            assert(!inst.alt);
+            auto locs = absolute_locs(inst);
+
+            fn(asm_inst_t{ .op = LDA_IMMEDIATE, .arg = locs.first });
+            fn(asm_inst_t{ .op = LDX_IMMEDIATE, .arg = locs.second });
+            if(inst.op == BANKED_Y_JSR)
+                fn(asm_inst_t{ .op = JSR_ABSOLUTE, .arg = locator_t::runtime_rom(RTROM_jsr_y_trampoline) });
+            else 
             {
-                assert(!inst.alt);
-                auto locs = absolute_locs(inst);
-
-                fn(asm_inst_t{ .op = LDA_IMMEDIATE, .arg = locs.first });
-                fn(asm_inst_t{ .op = LDX_IMMEDIATE, .arg = locs.second });
-                if(inst.op == BANKED_Y_JSR)
-                    fn(asm_inst_t{ .op = JSR_ABSOLUTE, .arg = locator_t::runtime_rom(RTROM_jsr_y_trampoline) });
-                else 
-                {
-                    assert(inst.op == BANKED_Y_JMP);
-                    fn(asm_inst_t{ .op = JMP_ABSOLUTE, .arg = locator_t::runtime_rom(RTROM_jmp_y_trampoline) });
-                }
+                assert(inst.op == BANKED_Y_JMP);
+                fn(asm_inst_t{ .op = JMP_ABSOLUTE, .arg = locator_t::runtime_rom(RTROM_jmp_y_trampoline) });
             }
-            break;
-
-        case ASM_X_SWITCH:
-            fn(asm_inst_t{ .op = LDA_ABSOLUTE_X, .arg = inst.alt.with_is(IS_DEREF) });
-            fn(asm_inst_t{ .op = PHA_IMPLIED });
-            fn(asm_inst_t{ .op = LDA_ABSOLUTE_X, .arg = inst.arg.with_is(IS_DEREF) });
-            fn(asm_inst_t{ .op = PHA_IMPLIED });
-            fn(asm_inst_t{ .op = RTS_IMPLIED });
-            break;
-
-        case ASM_Y_SWITCH:
-            fn(asm_inst_t{ .op = LDA_ABSOLUTE_Y, .arg = inst.alt.with_is(IS_DEREF) });
-            fn(asm_inst_t{ .op = PHA_IMPLIED });
-            fn(asm_inst_t{ .op = LDA_ABSOLUTE_Y, .arg = inst.arg.with_is(IS_DEREF) });
-            fn(asm_inst_t{ .op = PHA_IMPLIED });
-            fn(asm_inst_t{ .op = RTS_IMPLIED });
-            break;
-
-        default:
-            fn(inst);
-            break;
         }
+        break;
+
+    case ASM_X_SWITCH:
+        fn(asm_inst_t{ .op = LDA_ABSOLUTE_X, .arg = inst.alt.with_is(IS_DEREF) });
+        fn(asm_inst_t{ .op = PHA_IMPLIED });
+        fn(asm_inst_t{ .op = LDA_ABSOLUTE_X, .arg = inst.arg.with_is(IS_DEREF) });
+        fn(asm_inst_t{ .op = PHA_IMPLIED });
+        fn(asm_inst_t{ .op = RTS_IMPLIED });
+        break;
+
+    case ASM_Y_SWITCH:
+        fn(asm_inst_t{ .op = LDA_ABSOLUTE_Y, .arg = inst.alt.with_is(IS_DEREF) });
+        fn(asm_inst_t{ .op = PHA_IMPLIED });
+        fn(asm_inst_t{ .op = LDA_ABSOLUTE_Y, .arg = inst.arg.with_is(IS_DEREF) });
+        fn(asm_inst_t{ .op = PHA_IMPLIED });
+        fn(asm_inst_t{ .op = RTS_IMPLIED });
+        break;
+
+    default:
+        fn(inst);
+        break;
     }
 }
 
+void for_each_expanded_inst(asm_inst_t const& inst, std::function<void(asm_inst_t const&)> const& fn)
+{
+    expand_inst(inst, fn);
+}
+
+template<typename Fn>
+void asm_proc_t::for_each_inst(Fn const& fn) const
+{
+    for(asm_inst_t const& inst : code)
+        if(op_size(inst.op) != 0)
+            expand_inst(inst, fn);
+}
+
 template<typename Fn>
 void asm_proc_t::for_each_locator(Fn const& fn) const
 {
@@ -892,3 +905,57 @@ unsigned asm_proc_t::next_label_id() const
     return next_id;
 }
 
+std::vector<std::uint64_t> inst_weights(asm_proc_t const& asm_proc)
+{
+    auto const& code = asm_proc.code;
+
+    std::vector<int> depth_change(code.size() + 1, 0);
+    for(unsigned i = 0; i < code.size(); ++i)
+    {
+        addr_mode_t const mode = op_addr_mode(code[i].op);
+        if(mode != MODE_RELATIVE && mode != MODE_LONG && code[i].op != JMP_ABSOLUTE)
+            continue;
+
+        if(!is_label(code[i].arg.lclass()))
+            continue;
+
+        if(auto const* info = asm_proc.lookup_label(code[i].arg))
+        {
+            if(info->index <= i)
+            {
+                ++depth_change[info->index];
+                --depth_change[i + 1];
+            }
+        }
+    }
+
+    pgo_fn_t const* pgo = nullptr;
+    rh::batman_map<unsigned, unsigned> preorder_i;
+    if(fn_ht const fn = asm_proc.fn)
+    {
+        pgo = pgo_lookup(fn->global.name);
+        if(pgo && pgo->nodes != fn->cfg_preorder().size())
+            pgo = nullptr;
+        if(pgo)
+            for(unsigned i = 0; i < fn->cfg_preorder().size(); ++i)
+                preorder_i.insert({ fn->cfg_preorder()[i], i });
+    }
+
+    std::vector<std::uint64_t> weights(code.size());
+    std::optional<std::uint64_t> block_weight;
+    int depth = 0;
+
+    for(unsigned i = 0; i < code.size(); ++i)
+    {
+        depth += depth_change[i];
+
+        if(pgo && code[i].op == ASM_LABEL && code[i].arg.lclass() == LOC_CFG_LABEL && code[i].arg.data() == 0)
+            if(unsigned const* cfg_i = preorder_i.mapped(code[i].arg.handle()))
+                block_weight = pgo->block_weight(*cfg_i);
+
+        // Profiled weights are one loop level heavier than 'depth_exp'.
+        weights[i] = block_weight ? *block_weight : depth_exp(depth + bool(pgo));
+    }
+
+    return weights;
+}
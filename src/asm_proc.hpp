@@ -5,6 +5,7 @@
 #include <list>
 #include <vector>
 #include <exception>
+#include <functional>
 
 #include "robin/map.hpp"
 
@@ -194,6 +195,13 @@ private:
 
 std::ostream& operator<<(std::ostream& o, asm_inst_t const& inst);
 
+// Calls 'fn' with each instruction 'inst' is written as, expanding pseudo-ops.
+void for_each_expanded_inst(asm_inst_t const& inst, std::function<void(asm_inst_t const&)> const& fn);
+
+// How often each instruction runs, relative to the others in 'asm_proc'.
+// Uses the profile if there is one, otherwise the nesting of backwards jumps.
+std::vector<std::uint64_t> inst_weights(asm_proc_t const& asm_proc);
+
 struct relocate_error_t : public std::exception
 {
     explicit relocate_error_t(std::string const& msg)
@@ -0,0 +1,130 @@
+#include "asset_cache.hpp"
+
+#include <array>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <system_error>
+
+#include "file.hpp"
+#include "format.hpp"
+#include "options.hpp"
+
+namespace fs = ::std::filesystem;
+
+namespace
+{
+
+// Increment this when the format changes:
+constexpr std::uint32_t ASSET_CACHE_VERSION = 1;
+constexpr std::array<char, 4> ASSET_CACHE_MAGIC = { 'N', 'F', 'A', 'C' };
+
+struct header_t
+{
+    std::array<char, 4> magic;
+    std::uint32_t version;
+    std::uint64_t key;
+};
+
+fs::path entry_path(std::uint64_t key)
+{
+    char name[32];
+    std::snprintf(name, sizeof(name), "%016llx.nfa", static_cast<unsigned long long>(key));
+    return compiler_options().cache_dir / name;
+}
+
+} // end anonymous namespace
+
+asset_key_t::asset_key_t(std::string_view conversion)
+: m_hash(fnv1a<std::uint64_t>::hash(conversion))
+{
+    // Converters can change between builds of the compiler.
+    m_hash = fnv1a<std::uint64_t>::hash(std::string_view(VERSION), m_hash);
+    m_hash = fnv1a<std::uint64_t>::hash(std::string_view(GIT_COMMIT), m_hash);
+    m_hash = fnv1a<std::uint64_t>::hash(std::string_view(__DATE__ " " __TIME__), m_hash);
+}
+
+asset_cache_t::bytes_t asset_cache_t::get(asset_key_t const& key, std::function<bytes_t()> const& convert)
+{
+    std::uint64_t const hash = key.hash();
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if(bytes_t const* result = m_map.mapped(hash))
+        {
+            ++m_hits;
+            return *result;
+        }
+    }
+
+    bytes_t result;
+    if(load(hash, result))
+        ++m_hits;
+    else
+    {
+        ++m_misses;
+        result = convert();
+        store(hash, result);
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_map.emplace(hash, [&]{ return result; });
+    return result;
+}
+
+bool asset_cache_t::load(std::uint64_t key, bytes_t& result)
+{
+    if(compiler_options().cache_dir.empty())
+        return false;
+
+    bytes_t bytes;
+    bool const found = read_binary_file(entry_path(key).string().c_str(), [&](std::size_t size)
+    {
+        bytes.resize(size);
+        return bytes.data();
+    });
+
+    header_t header;
+    if(!found || bytes.size() < sizeof(header))
+        return false;
+
+    std::memcpy(&header, bytes.data(), sizeof(header));
+    if(header.magic != ASSET_CACHE_MAGIC || header.version != ASSET_CACHE_VERSION || header.key != key)
+        return false;
+
+    result.assign(bytes.begin() + sizeof(header), bytes.end());
+    return true;
+}
+
+void asset_cache_t::store(std::uint64_t key, bytes_t const& result)
+{
+    if(compiler_options().cache_dir.empty())
+        return;
+
+    // The cache is best-effort; failing to write an entry isn't an error.
+    std::error_code ec;
+    fs::create_directories(compiler_options().cache_dir, ec);
+    if(ec)
+        return;
+
+    header_t const header = { ASSET_CACHE_MAGIC, ASSET_CACHE_VERSION, key };
+
+    // Write to a temporary file first, so that other processes never see a partial entry.
+    fs::path const path = entry_path(key);
+    fs::path tmp_path = path;
+    tmp_path += fmt(".%.tmp", m_tmp_id++);
+
+    bool written;
+    {
+        std::ofstream of(tmp_path, std::ios::binary);
+        of.write(reinterpret_cast<char const*>(&header), sizeof(header));
+        of.write(reinterpret_cast<char const*>(result.data()), result.size());
+        written = bool(of);
+    }
+
+    if(written)
+        fs::rename(tmp_path, path, ec);
+    if(!written || ec)
+        fs::remove(tmp_path, ec);
+}
@@ -0,0 +1,74 @@
+#ifndef ASSET_CACHE_HPP
+#define ASSET_CACHE_HPP
+
+// Caches the output of asset conversions (PNG to CHR, compression, etc),
+// so that unchanged assets don't get converted again.
+//
+// Each conversion is keyed on its name, the compiler build,
+// and every input byte and argument given to it.
+// Results are kept in memory for the current build,
+// and stored in 'cache_dir' (when set) for later builds.
+// In watch mode, each rebuild is a new process, so it's the latter that carries over.
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+#include "robin/map.hpp"
+
+#include "fnv1a.hpp"
+
+class asset_key_t
+{
+public:
+    explicit asset_key_t(std::string_view conversion);
+
+    asset_key_t& bytes(void const* data, std::size_t size)
+    {
+        add(std::uint64_t(size));
+        m_hash = fnv1a<std::uint64_t>::hash(static_cast<char const*>(data), size, m_hash);
+        return *this;
+    }
+
+    template<typename T>
+    asset_key_t& add(T const& t)
+    {
+        static_assert(std::is_trivially_copyable_v<T>);
+        m_hash = fnv1a<std::uint64_t>::hash(reinterpret_cast<char const*>(&t), sizeof(T), m_hash);
+        return *this;
+    }
+
+    std::uint64_t hash() const { return m_hash; }
+private:
+    std::uint64_t m_hash;
+};
+
+class asset_cache_t
+{
+public:
+    using bytes_t = std::vector<std::uint8_t>;
+
+    // Returns the result of 'convert', only calling it if 'key' isn't cached.
+    // 'convert' must be a pure function of the key.
+    static bytes_t get(asset_key_t const& key, std::function<bytes_t()> const& convert);
+
+    static unsigned hits() { return m_hits; }
+    static unsigned misses() { return m_misses; }
+
+private:
+    static bool load(std::uint64_t key, bytes_t& result);
+    static void store(std::uint64_t key, bytes_t const& result);
+
+    inline static std::mutex m_mutex; // Protects 'm_map'.
+    inline static rh::robin_map<std::uint64_t, bytes_t> m_map;
+
+    inline static std::atomic<unsigned> m_hits = 0;
+    inline static std::atomic<unsigned> m_misses = 0;
+    inline static std::atomic<unsigned> m_tmp_id = 0;
+};
+
+#endif
@@ -62,6 +62,15 @@ unsigned ast_node_t::num_children() const
     }
 }
 
+unsigned ast_node_t::size() const
+{
+    unsigned total = 1;
+    unsigned const n = num_children();
+    for(unsigned i = 0; i < n; ++i)
+        total += children[i].size();
+    return total;
+}
+
 void ast_node_t::weaken_idents()
 {
     if(token.type == lex::TOK_ident)
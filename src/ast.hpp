@@ -22,6 +22,7 @@ struct ast_node_t
     };
 
     unsigned num_children() const;
+    unsigned size() const; // Counts the nodes in this tree.
     void weaken_idents();
 };
 
@@ -1,14 +1,17 @@
 #include "byteify.hpp"
 
+#include <algorithm>
 #include <array>
 
 #include <boost/container/small_vector.hpp>
 
+#include "builtin.hpp"
 #include "globals.hpp"
 #include "ir.hpp"
 #include "ir_util.hpp"
 #include "worklist.hpp"
 #include "format.hpp"
+#include "options.hpp"
 
 namespace bc = ::boost::container;
 
@@ -43,8 +46,9 @@ static bm_t _get_bm(ssa_value_t value)
         bm_t bm;
         fixed_uint_t f = value.fixed().value;
 
+        // Each byte becomes a whole number, which fractional types can't hold.
         type_name_t num_type = value.num_type_name();
-        if(total_bytes(num_type) > 1)
+        if(total_bytes(num_type) > 1 || frac_bytes(num_type))
             num_type = TYPE_U;
 
         for(unsigned i = 0; i < bm.size(); ++i)
@@ -780,6 +784,9 @@ void byteify(ir_t& ir, fn_t const& fn)
 
                     for(int s = 0; s < bit_shifts; ++s)
                     {
+                        // Each pass shifts in a zero, not the bit the last pass shifted out.
+                        carry = ssa_value_t(0u, TYPE_BOOL);
+
                         for(int i = begin + byte_shifts; i < end; ++i)
                         {
                             values[i] = ssa_node->cfg_node()->emplace_ssa(
@@ -806,6 +813,8 @@ void byteify(ir_t& ir, fn_t const& fn)
                         if(is_signed(t))
                            carry = ssa_node->cfg_node()->emplace_ssa(
                                SSA_sign, TYPE_BOOL, values[end - 1]);
+                        else
+                           carry = ssa_value_t(0u, TYPE_BOOL);
 
                         for(int i = end - 1 - byte_shifts; i >= int(begin); --i)
                         {
@@ -910,24 +919,38 @@ void byteify(ir_t& ir, fn_t const& fn)
                 ssa_value_t const lhs = ssa_node->input(0);
                 ssa_value_t const rhs = ssa_node->input(1);
 
-                bm_t const lhs_bm = _get_bm(lhs);
-                bm_t const rhs_bm = _get_bm(rhs);
+                bm_t lhs_bm = _get_bm(lhs);
+                bm_t rhs_bm = _get_bm(rhs);
 
                 type_t const lhs_type = lhs.type();
                 type_t const rhs_type = rhs.type();
 
                 cfg_ht const cfg = ssa_node->cfg_node();
 
-                int const lhs_begin = begin_byte(lhs_type.name());
-                int const lhs_end = end_byte(lhs_type.name());
+                int lhs_begin = begin_byte(lhs_type.name());
+                int lhs_end = end_byte(lhs_type.name());
 
-                int const rhs_begin = begin_byte(rhs_type.name());
-                int const rhs_end = end_byte(rhs_type.name());
+                int rhs_begin = begin_byte(rhs_type.name());
+                int rhs_end = end_byte(rhs_type.name());
 
                 int const result_begin = begin_byte(t);
                 int const result_end = end_byte(t);
                 int const sum_begin = result_begin * 2 - max_frac_bytes;
 
+                // Table multiplication can multiply two bytes of 'rhs' at once,
+                // so make it the factor with more non-constant bytes.
+                bool const mul16x8 = compiler_options().mul_impl == MUL_TABLE;
+                auto const count_vars = [](bm_t const& bm, int begin, int end)
+                {
+                    return std::count_if(bm.begin() + begin, bm.begin() + end, [](ssa_value_t v) { return !v.is_const(); });
+                };
+                if(mul16x8 && count_vars(lhs_bm, lhs_begin, lhs_end) > count_vars(rhs_bm, rhs_begin, rhs_end))
+                {
+                    std::swap(lhs_bm, rhs_bm);
+                    std::swap(lhs_begin, rhs_begin);
+                    std::swap(lhs_end, rhs_end);
+                }
+
                 std::array<bc::small_vector<ssa_value_t, max_total_bytes>, max_total_bytes + max_frac_bytes> to_sum;
 
                 for(int li = lhs_begin; li < lhs_end; ++li)
@@ -937,6 +960,26 @@ void byteify(ir_t& ir, fn_t const& fn)
                     if(lo_i - int(max_frac_bytes) >= result_end)
                         continue;
 
+                    // Constant bytes use 'SSA_mul8_lo', which later passes can simplify.
+                    if(mul16x8 && ri + 1 < rhs_end && lo_i + 1 - int(max_frac_bytes) < result_end
+                       && !lhs_bm[li].is_const() && !rhs_bm[ri].is_const() && !rhs_bm[ri + 1].is_const())
+                    {
+                        ssa_ht const lo = cfg->emplace_ssa(SSA_mul16x8_lo, TYPE_U, lhs_bm[li], rhs_bm[ri], rhs_bm[ri + 1]);
+                        to_sum[lo_i].push_back(lo);
+
+                        ssa_ht const mid = cfg->emplace_ssa(SSA_mul16x8_mid, TYPE_U, lo);
+                        to_sum[lo_i + 1].push_back(mid);
+
+                        if(lo_i + 2 - int(max_frac_bytes) < result_end)
+                        {
+                            ssa_ht const hi = cfg->emplace_ssa(SSA_mul16x8_hi, TYPE_U, lo);
+                            to_sum[lo_i + 2].push_back(hi);
+                        }
+
+                        ++ri; // Skip the byte just used.
+                        continue;
+                    }
+
                     ssa_ht const lo = cfg->emplace_ssa(SSA_mul8_lo, TYPE_U, lhs_bm[li], rhs_bm[ri]);
                     to_sum[lo_i].push_back(lo);
 
@@ -1198,6 +1241,186 @@ bool insert_signed_mul_subtractions(ir_t& ir)
     return updated;
 }
 
+// Rewrites the remainder pattern 'x - (x / d) * d', which is how fab code computes modulo,
+// to use the remainder 'SSA_div8' already calculates.
+static void use_div8_remainder(ssa_ht div)
+{
+    ssa_value_t const dividend = div->input(0);
+    ssa_value_t const divisor = div->input(1);
+
+    // Skips over casts between whole numbers, which don't change the result modulo 256.
+    auto const skip_cast = [](ssa_value_t v) -> ssa_value_t
+    {
+        if(v.holds_ref() && v->op() == SSA_cast && !frac_bytes(v->type().name()) 
+           && !frac_bytes(v->input(0).type().name()))
+        {
+            return v->input(0);
+        }
+        return v;
+    };
+
+    bc::small_vector<ssa_ht, 4> subs;
+
+    auto const check_sub = [&](ssa_ht product, ssa_ht sub)
+    {
+        if(sub->op() == SSA_sub && skip_cast(sub->input(1)) == product 
+           && skip_cast(sub->input(0)) == dividend && sub->input(2).eq_whole(1)
+           && !frac_bytes(sub->type().name()) && !carry_output(*sub)
+           && std::find(subs.begin(), subs.end(), sub) == subs.end())
+        {
+            subs.push_back(sub);
+        }
+    };
+
+    for(unsigned i = 0; i < div->output_size(); ++i)
+    {
+        ssa_ht const mul = div->output(i);
+        if(mul->op() != SSA_mul || frac_bytes(mul->type().name())
+           || !(mul->input(0) == divisor || mul->input(1) == divisor))
+        {
+            continue;
+        }
+
+        for(unsigned j = 0; j < mul->output_size(); ++j)
+        {
+            ssa_ht const output = mul->output(j);
+            if(output->op() == SSA_cast)
+                for(unsigned k = 0; k < output->output_size(); ++k)
+                    check_sub(mul, output->output(k));
+            else
+                check_sub(mul, output);
+        }
+    }
+
+    if(subs.empty())
+        return;
+
+    // The difference is exactly the remainder, which fits in a byte.
+    ssa_ht const rem = div->cfg_node()->emplace_ssa(SSA_div8_rem, TYPE_U, div);
+    for(ssa_ht sub : subs)
+    {
+        ssa_ht const cast = sub->cfg_node()->emplace_ssa(SSA_cast, sub->type(), rem);
+        sub->replace_with(cast);
+        sub->prune();
+    }
+}
+
+// Lowers 'SSA_div' so that byteify doesn't have to handle it.
+// Division by a constant becomes a multiplication by its reciprocal, 
+// using the method of "Division by Invariant Integers using Multiplication" (Granlund and Montgomery).
+// Other division becomes 'SSA_div8', a call to the run-time routine.
+// Returns true if the IR was modified.
+bool lower_div(ir_t& ir)
+{
+    bool updated = false;
+
+    for(cfg_ht cfg_it = ir.cfg_begin(); cfg_it; ++cfg_it)
+    for(ssa_ht ssa_it = cfg_it->ssa_begin(); ssa_it;)
+    {
+        if(ssa_it->op() != SSA_div)
+        {
+            ++ssa_it;
+            continue;
+        }
+
+        updated = true;
+
+        type_t const type = ssa_it->type();
+        assert(!is_signed(type.name()) && !frac_bytes(type.name()));
+
+        ssa_value_t const dividend = ssa_it->input(0);
+        ssa_value_t const divisor = ssa_it->input(1);
+
+        if(!divisor.is_num())
+        {
+            assert(type == TYPE_U);
+            ssa_it->unsafe_set_op(SSA_div8);
+            use_div8_remainder(ssa_it);
+            ++ssa_it;
+            continue;
+        }
+
+        unsigned const bytes = whole_bytes(type.name());
+        unsigned const bits = bytes * 8;
+        fixed_uint_t d = divisor.whole();
+
+        auto const shr = [&](ssa_value_t value, unsigned amount) -> ssa_value_t
+        {
+            if(!amount)
+                return value;
+            return cfg_it->emplace_ssa(SSA_shr, type, value, ssa_value_t(amount, TYPE_U));
+        };
+
+        // Multiplies 'value' by 'multiplier / 2^shift', truncating the result.
+        auto const mul_frac = [&](ssa_value_t value, fixed_uint_t multiplier, unsigned shift) -> ssa_value_t
+        {
+            assert(shift <= fixed_t::shift);
+            assert(multiplier < (1ull << shift));
+            unsigned const frac = (shift + 7) / 8;
+            ssa_value_t const factor(fixed_t{ multiplier << (fixed_t::shift - shift) }, type_f(frac));
+            ssa_ht const mul = cfg_it->emplace_ssa(SSA_mul, type_u(bytes, frac), value, factor);
+            return cfg_it->emplace_ssa(SSA_cast, type, mul);
+        };
+
+        ssa_value_t result;
+
+        if(d == 0)
+            result = ssa_value_t(unsigned((1ull << bits) - 1), type.name()); // Matches 'RTROM_div8'.
+        else
+        {
+            // Powers of two divide exactly by shifting, so shift them out first.
+            unsigned const pre_shift = builtin::ctz(d);
+            d >>= pre_shift;
+            ssa_value_t const shifted = shr(dividend, pre_shift);
+
+            if(d == 1)
+                result = shifted;
+            else
+            {
+                // Find the smallest multiplier 'm / 2^s' that rounds correctly for every dividend.
+                // (It does when 'm * d - 2^s <= 2^(s - N)', for an N-bit dividend.)
+                unsigned const n = bits - pre_shift;
+                bool found = false;
+
+                for(unsigned s = 1; s <= fixed_t::shift && !found; ++s)
+                {
+                    fixed_uint_t const m = ((1ull << s) + d - 1) / d;
+                    fixed_uint_t const e = m * d - (1ull << s);
+                    if((e << n) <= (1ull << s))
+                    {
+                        result = mul_frac(shifted, m, s);
+                        found = true;
+                    }
+                }
+
+                if(!found)
+                {
+                    // No multiplier is precise enough, so use one that's a bit too big,
+                    // subtracting out the extra bit of it using an add and shifts:
+                    //     t = x * (m - 2^N) / 2^N
+                    //     q = (((x - t) >> 1) + t) >> (l - 1)
+                    unsigned const l = builtin::rclz(d); // ceil(log2(d)), as 'd' is odd.
+                    fixed_uint_t const m = (((1ull << l) - d) << bits) / d + 1;
+                    assert(l >= 2);
+
+                    ssa_value_t const t = mul_frac(shifted, m, bits);
+                    ssa_ht const diff = cfg_it->emplace_ssa(SSA_sub, type, shifted, t, ssa_value_t(1u, TYPE_BOOL));
+                    ssa_ht const sum = cfg_it->emplace_ssa(SSA_add, type, shr(diff, 1), t, ssa_value_t(0u, TYPE_BOOL));
+                    result = shr(sum, l - 1);
+                }
+            }
+        }
+
+        ssa_it->replace_with(result);
+        ssa_it = ssa_it->prune();
+    }
+
+    if(updated)
+        ir.assert_valid();
+
+    return updated;
+}
+
 // Expands shifts into rotates.
 // Returns true if the IR was modified.
 bool shifts_to_rotates(ir_t& ir, bool handle_constant_shifts)
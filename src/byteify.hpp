@@ -8,6 +8,7 @@
 void byteify(class ir_t& ir, fn_t const& fn);
 
 bool insert_signed_mul_subtractions(ir_t& ir);
+bool lower_div(ir_t& ir);
 bool shifts_to_rotates(ir_t& ir, bool handle_constant_shifts);
 
 #endif
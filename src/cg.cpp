@@ -508,7 +508,7 @@ std::size_t code_gen(log_t* log, ir_t& ir, fn_t& fn)
     // LIVENESS SET CREATION //
     ///////////////////////////
 
-    calc_ssa_liveness(ir, ssa_pool::array_size() + reserve);
+    calc_ssa_liveness(ir);
 
     // Note: once the live sets have been built, the IR cannot be modified
     // until all liveness checks are done.
@@ -6,6 +6,7 @@
 #include <vector>
 
 #include "flat/small_set.hpp"
+#include "robin/set.hpp"
 
 #include "asm.hpp"
 #include "asm_proc.hpp"
@@ -19,8 +20,11 @@
 
 struct cfg_liveness_d
 {
-    bitset_uint_t* in;
-    bitset_uint_t* out; // Also used to hold the 'KILL' set temporarily.
+    // Sets of 'ssa_ht::id'.
+    // These are sparse, as most values are only live in a few CFG nodes,
+    // and bitsets would take space proportional to CFG nodes times SSA nodes.
+    rh::robin_set<unsigned> in;
+    rh::robin_set<unsigned> out;
 };
 
 struct cfg_order_d
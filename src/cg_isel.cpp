@@ -25,6 +25,7 @@
 #include "switch.hpp"
 #include "asm_graph.hpp"
 #include "rom.hpp"
+#include "pgo.hpp"
 
 namespace bc = ::boost::container;
 
@@ -65,6 +66,9 @@ namespace isel
         // Scratchpad used for sorting stuff:
         std::vector<unsigned> indices;
 
+        // Scores selections by bytes instead of cycles.
+        bool for_size = false;
+
         // Used for debug logging.
         log_t* log = nullptr;
 
@@ -183,7 +187,7 @@ namespace isel
 
 ///////////////////////////////////////////////////////////////////////////////
 
-    constexpr isel_cost_t cost_fn(op_t op) 
+    constexpr isel_cost_t cost_fn(op_t op, bool for_size = false)
     { 
         isel_cost_t penalty = 0;
 
@@ -202,9 +206,18 @@ namespace isel
             break;
         }
 
+        if(for_size)
+        {
+            // Maybe-stores are usually pruned, so they're kept cheap like their cycle counts:
+            isel_cost_t const size = (op_flags(op) & ASMF_MAYBE_STORE) ? MAYBE_CYCLES : op_size(op);
+            return (size * 256ull) + (op_cycles(op) * 4ull) + penalty;
+        }
         return (op_cycles(op) * 256ull) + (op_size(op) * 4ull) + penalty;
     }
 
+    // Uses the cost model of the function being compiled.
+    isel_cost_t op_cost(op_t op) { return cost_fn(op, state.for_size); }
+
 ///////////////////////////////////////////////////////////////////////////////
 
     // Represents a list of functions.
@@ -256,9 +269,9 @@ namespace isel
 ///////////////////////////////////////////////////////////////////////////////
 
     // These determine how extensive the search is.
-    constexpr unsigned cost_cutoff(int size)
+    unsigned cost_cutoff(int size)
     {
-        constexpr unsigned BASE = cost_fn(LDY_ABSOLUTE) * 2;
+        unsigned const BASE = op_cost(LDY_ABSOLUTE) * 2;
         return BASE;
         //return (BASE >> (size >> 4)) + cost_fn(TAY_IMPLIED);
         //return std::max<int>((BASE * (int(MAX_MAP_SIZE*2) - size)) / int(MAX_MAP_SIZE*2), cost_fn(TAY_IMPLIED) * 3 / 2);
@@ -375,8 +388,8 @@ namespace isel
                          locator_t arg = {}, locator_t alt = {}, isel_cost_t extra_cost = 0)
     {
         assert(Op != BAD_OP);
-        isel_cost_t total_cost = cost_fn(Op);
-        if(cpu.conditional_regs & cpu_t::CONDITIONAL_EXEC)
+        isel_cost_t total_cost = op_cost(Op);
+        if((cpu.conditional_regs & cpu_t::CONDITIONAL_EXEC) && !state.for_size)
             total_cost = (total_cost * 3) / 4; // Conditional ops are arbitrarily cheaper.
         total_cost += sp.cost + extra_cost;
 
@@ -446,7 +459,7 @@ namespace isel
             cpu.req_store |= cg_data(def.handle()).isel.store_mask;
         }
 
-        return cost_fn(STA_ABSOLUTE) * new_stores;
+        return op_cost(STA_ABSOLUTE) * new_stores;
     }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -3024,6 +3037,48 @@ namespace isel
             store<Opt, STY, p_def, p_def>(cpu, prev, cont);
             break;
 
+        case SSA_mul16x8_lo:
+            p_lhs::set(h->input(0));
+            p_rhs::set(h->input(1));
+            p_arg<2>::set(h->input(2));
+            p_arg<3>::set(locator_t::runtime_rom(RTROM_mul16x8));
+
+            chain
+            < load_AX<Opt, p_lhs, p_rhs>
+            , load_Y<typename Opt::restrict_to<~(REGF_A | REGF_X)>, p_arg<2>>
+            , simple_op<Opt, read_reg_op(REGF_A | REGF_X | REGF_Y)>
+            , exact_op<Opt, JSR_ABSOLUTE, null_, p_arg<3>>
+            , simple_op<Opt, write_reg_op(REGF_ISEL)>
+            , store<Opt, STX, p_def, p_def>
+            >(cpu, prev, cont);
+            break;
+
+        case SSA_mul16x8_mid:
+            store<Opt, STY, p_def, p_def>(cpu, prev, cont);
+            break;
+
+        case SSA_mul16x8_hi:
+            store<Opt, STA, p_def, p_def>(cpu, prev, cont);
+            break;
+
+        case SSA_div8:
+            p_lhs::set(h->input(0));
+            p_rhs::set(h->input(1));
+            p_arg<2>::set(locator_t::runtime_rom(RTROM_div8));
+
+            chain
+            < load_AY<Opt, p_lhs, p_rhs>
+            , simple_op<Opt, read_reg_op(REGF_A | REGF_Y)>
+            , exact_op<Opt, JSR_ABSOLUTE, null_, p_arg<2>>
+            , simple_op<Opt, write_reg_op(REGF_ISEL & ~REGF_X)>
+            , store<Opt::template restrict_to<~REGF_X>, STA, p_def, p_def>
+            >(cpu, prev, cont);
+            break;
+
+        case SSA_div8_rem:
+            store<Opt, STY, p_def, p_def>(cpu, prev, cont);
+            break;
+
         case SSA_and:
             commutative(h, [&]()
             {
@@ -3280,7 +3335,7 @@ namespace isel
                     ror_implied:
                         chain
                         < load_AC<Opt, p_lhs, p_rhs>
-                        , simple_op<Opt, ROR_IMPLIED, p_lhs>
+                        , simple_op<Opt, ROR_IMPLIED, p_def>
                         , store<Opt, STA, p_def, p_def>
                         , set_defs<Opt, REGF_C, true, p_carry_output>
                         >(cpu, prev, cont);
@@ -4338,10 +4393,41 @@ std::size_t select_instructions(log_t* log, fn_t& fn, ir_t& ir)
     state.log = log;
     state.fn = fn.handle();
     state.ssa_node = {};
+    state.for_size = fn.optimize_for_size();
 
     build_loops_and_order(ir);
     build_dominators_from_order(ir);
 
+    // Profiles refer to CFG nodes by preorder index, so only use one made from this same IR:
+    pgo_fn_t const* pgo = pgo_lookup(fn.global.name);
+    if(pgo && pgo->nodes != preorder.size())
+        pgo = nullptr;
+
+    // How often code runs, used to scale costs.
+    // Profiled weights are one loop level heavier than 'depth_exp', so both get scaled alike.
+    // Bytes cost the same wherever they are, so sizes aren't scaled.
+    auto const block_weight = [&](cfg_ht cfg) -> isel_cost_t
+    {
+        if(state.for_size)
+            return 1;
+        if(!pgo)
+            return depth_exp(loop_depth(cfg));
+        if(auto weight = pgo->block_weight(algo(cfg).preorder_i))
+            return *weight;
+        return depth_exp(loop_depth(cfg) + 1);
+    };
+
+    auto const edge_weight = [&](cfg_ht from, cfg_ht to) -> isel_cost_t
+    {
+        if(state.for_size)
+            return 1;
+        if(!pgo)
+            return depth_exp(edge_depth(from, to));
+        if(auto weight = pgo->edge_weight(algo(from).preorder_i, algo(to).preorder_i))
+            return *weight;
+        return depth_exp(edge_depth(from, to) + 1);
+    };
+
     _data_vec.clear();
     _data_vec.resize(cfg_pool::array_size());
 
@@ -4383,9 +4469,10 @@ std::size_t select_instructions(log_t* log, fn_t& fn, ir_t& ir)
     static TLS rh::batman_map<cross_transition_t, result_t> rebuilt;
     static TLS std::vector<rh::apair<cross_cpu_t, isel_cost_t>> new_out_states;
 
-    constexpr unsigned BASE_SEL_SIZE = 32;
-    constexpr unsigned BASE_MAP_SIZE = 128;
-    constexpr auto SELS_COST_BOUND = cost_fn(LDA_ABSOLUTE) * 2;
+    opt_settings_t const& opt = opt_settings();
+    unsigned const BASE_SEL_SIZE = opt.sel_size;
+    unsigned const BASE_MAP_SIZE = opt.map_size;
+    auto const SELS_COST_BOUND = op_cost(LDA_ABSOLUTE) * opt.cost_bound;
 
     auto const shrink_sels = [&](cfg_ht cfg)
     {
@@ -4576,7 +4663,7 @@ std::size_t select_instructions(log_t* log, fn_t& fn, ir_t& ir)
                 if(pair.first.defs[i])
                     ++out_reg_count;
 
-            if(cost > d.min_sel_cost + bound + (cost_fn(STA_MAYBE) * out_reg_count))
+            if(cost > d.min_sel_cost + bound + (op_cost(STA_MAYBE) * out_reg_count))
                 continue;
 
             std::vector<asm_inst_t> code_temp;
@@ -4651,7 +4738,7 @@ std::size_t select_instructions(log_t* log, fn_t& fn, ir_t& ir)
                     {
                         if((op_input_regs(inst.op) & (1 << i)) && inst.alt == transition.out_state.defs[i]) [[unlikely]]
                         {
-                            cost -= cost_fn(STA_MAYBE);
+                            cost -= op_cost(STA_MAYBE);
                             break;
                         }
                     }
@@ -4845,7 +4932,7 @@ std::size_t select_instructions(log_t* log, fn_t& fn, ir_t& ir)
         {
             auto& d = data(cfg);
 
-            isel_cost_t const multiplier = depth_exp(loop_depth(cfg));
+            isel_cost_t const multiplier = block_weight(cfg);
             assert(multiplier > 0);
             assert(d.cost_vector.empty());
 
@@ -4854,53 +4941,92 @@ std::size_t select_instructions(log_t* log, fn_t& fn, ir_t& ir)
                 d.cost_vector[i] = d.sels.begin()[i].second.cost * multiplier;
         }
 
-        for(cfg_ht cfg = ir.cfg_begin(); cfg; ++cfg)
+        // Below the default optimization level, pick the cheapest selection of each node,
+        // ignoring the loads between them. This falls back to PBQP if it would
+        // leave the carry needing a load from memory, which can't be generated.
+        auto const select_cheapest = [&]() -> bool
         {
-            auto& d = data(cfg);
+            for(cfg_ht cfg = ir.cfg_begin(); cfg; ++cfg)
+            {
+                auto& d = data(cfg);
+                d.sel = std::min_element(d.cost_vector.begin(), d.cost_vector.end()) - d.cost_vector.begin();
+            }
 
-            unsigned const output_size = cfg->output_size();
-            for(unsigned i = 0; i < output_size; ++i)
+            for(cfg_ht cfg = ir.cfg_begin(); cfg; ++cfg)
             {
-                auto const oe = cfg->output_edge(i);
-                auto& od = data(oe.handle);
+                auto const& d = data(cfg);
+                locator_t carry = d.final_in_state().defs[REG_C];
+                if(carry.lclass() == LOC_SSA || carry.lclass() == LOC_PHI)
+                    carry = asm_arg(carry.ssa_node());
+
+                if(!carry || carry.lclass() == LOC_CONST_BYTE)
+                    continue;
+
+                for(unsigned i = 0; i < cfg->input_size(); ++i)
+                {
+                    cross_cpu_t const loads = cross_loads(d.final_in_state(), data(cfg->input(i)).final_out_state(), cfg, i);
+                    if(loads.defs[REG_C])
+                        goto fail;
+                }
+            }
+
+            return true;
+        fail:
+            for(cfg_ht cfg = ir.cfg_begin(); cfg; ++cfg)
+                data(cfg).sel = -1;
+            return false;
+        };
 
-                isel_cost_t const multiplier = depth_exp(edge_depth(cfg, oe.handle));
+        if(opt.pbqp || !select_cheapest())
+        {
+            for(cfg_ht cfg = ir.cfg_begin(); cfg; ++cfg)
+            {
+                auto& d = data(cfg);
 
-                std::vector<pbqp_cost_t> cost_matrix(d.sels.size() * od.sels.size());
-                for(unsigned y = 0; y < od.sels.size(); ++y)
-                for(unsigned x = 0; x < d.sels.size(); ++x)
+                unsigned const output_size = cfg->output_size();
+                for(unsigned i = 0; i < output_size; ++i)
                 {
-                    cross_cpu_t const& in  = od.sels.begin()[y].first.in_state;
-                    cross_cpu_t const& out = d.sels.begin()[x].first.out_state;
-                    cross_cpu_t const loads = cross_loads(in, out, oe.handle, oe.index);
+                    auto const oe = cfg->output_edge(i);
+                    auto& od = data(oe.handle);
 
-                    pbqp_cost_t cost = 0;
+                    isel_cost_t const multiplier = edge_weight(cfg, oe.handle);
 
-                    for(regs_t reg = 0; reg < NUM_CROSS_REGS; ++reg)
+                    std::vector<pbqp_cost_t> cost_matrix(d.sels.size() * od.sels.size());
+                    for(unsigned y = 0; y < od.sels.size(); ++y)
+                    for(unsigned x = 0; x < d.sels.size(); ++x)
                     {
-                        if(!loads.defs[reg])
-                            continue;
+                        cross_cpu_t const& in  = od.sels.begin()[y].first.in_state;
+                        cross_cpu_t const& out = d.sels.begin()[x].first.out_state;
+                        cross_cpu_t const loads = cross_loads(in, out, oe.handle, oe.index);
+
+                        pbqp_cost_t cost = 0;
 
-                        op_t const op = gen_load(loads, reg, LOC_NONE).op;
-                        unsigned add_to_cost = cost_fn(op);
-                        assert(add_to_cost);
+                        for(regs_t reg = 0; reg < NUM_CROSS_REGS; ++reg)
+                        {
+                            if(!loads.defs[reg])
+                                continue;
 
-                        // Make it arbitrarily worse than a normal load.
-                        // (2 seems to be too small)
-                        cost += add_to_cost * 3;
+                            op_t const op = gen_load(loads, reg, LOC_NONE).op;
+                            unsigned add_to_cost = op_cost(op);
+                            assert(add_to_cost);
+
+                            // Make it arbitrarily worse than a normal load.
+                            // (2 seems to be too small)
+                            cost += add_to_cost * 3;
+                        }
+
+                        cost_matrix[x + y * d.sels.size()] = cost * multiplier;
                     }
 
-                    cost_matrix[x + y * d.sels.size()] = cost * multiplier;
+                    pbqp.add_edge(d, od, std::move(cost_matrix));
                 }
-
-                pbqp.add_edge(d, od, std::move(cost_matrix));
             }
-        }
 
-        std::vector<pbqp_node_t*> pbqp_order;
-        for(cfg_ht cfg : postorder)
-            pbqp_order.push_back(&data(cfg));
-        pbqp.solve(std::move(pbqp_order));
+            std::vector<pbqp_node_t*> pbqp_order;
+            for(cfg_ht cfg : postorder)
+                pbqp_order.push_back(&data(cfg));
+            pbqp.solve(std::move(pbqp_order));
+        }
     }
 
     ///////////////////////////
@@ -4984,8 +5110,9 @@ std::size_t select_instructions(log_t* log, fn_t& fn, ir_t& ir)
                 auto& id = data(input);
 
                 // Replace the labels of incoming jumps with the new label.
+                // (Skip ASM_LABEL, as 'input' can be 'cfg' itself when it loops.)
                 for(asm_inst_t& inst : id.final_code())
-                    if(inst.arg == locator_t::cfg_label(cfg))
+                    if(inst.op != ASM_LABEL && inst.arg == locator_t::cfg_label(cfg))
                         inst.arg = label;
 
                 // Handle switch:
@@ -5086,7 +5213,7 @@ std::size_t select_instructions(log_t* log, fn_t& fn, ir_t& ir)
                 {
                     cfg_ht input = cfg->input(i);
 
-                    unsigned const cost = depth_exp(edge_depth(input, cfg));
+                    unsigned const cost = edge_weight(input, cfg);
                     regs_t input_load = input_loads[i];
 
                     for(unsigned j = 0; j < order.size(); ++j)
@@ -5162,14 +5289,29 @@ std::size_t select_instructions(log_t* log, fn_t& fn, ir_t& ir)
     }
 
     graph.finish_appending();
-    graph.optimize();
+    if(opt.asm_graph)
+        graph.optimize();
     graph.optimize_live_registers();
     graph.remove_maybes(fn);
     graph.optimize_live_registers();
 
     lvars_manager_t lvars = graph.build_lvars(fn);
 
-    asm_proc_t asm_proc(fn.handle(), graph.to_linear(graph.order()), graph.entry_label());
+    asm_proc_t asm_proc(fn.handle(), graph.to_linear(graph.order(pgo)), graph.entry_label());
+
+    {
+        std::vector<unsigned> cfg_preorder;
+        cfg_preorder.reserve(preorder.size());
+        for(cfg_ht cfg : preorder)
+            cfg_preorder.push_back(cfg.id);
+        fn.assign_cfg_preorder(std::move(cfg_preorder));
+
+        std::vector<std::pair<locator_t, unsigned>> loop_bounds;
+        for(auto const& pair : ir.loop_bounds)
+            if(algo(pair.first).is_loop_header)
+                loop_bounds.emplace_back(locator_t::cfg_label(pair.first), pair.second);
+        fn.assign_loop_bounds(std::move(loop_bounds));
+    }
 
     if(std::ostream* os = fn.info_stream())
     {
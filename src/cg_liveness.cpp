@@ -8,12 +8,6 @@
 #include "worklist.hpp"
 #include "assert.hpp"
 
-namespace liveness_impl
-{
-    TLS array_pool_t<bitset_uint_t> bitset_pool;
-    TLS unsigned set_size;
-}
-
 //////////////////
 // cfg liveness //
 //////////////////
@@ -28,17 +22,15 @@ static void _live_visit(ssa_ht def, cfg_ht cfg_node)
     if(def->cfg_node() == cfg_node)
         return;
 
-    if(bitset_test(live(cfg_node).in, def.id))
+    if(!live(cfg_node).in.insert(def.id).second)
         return;
 
-    bitset_set(live(cfg_node).in, def.id);
-
     unsigned const input_size = cfg_node->input_size();
     passert(input_size > 0, cfg_node, input_size);
     for(unsigned i = 0; i < input_size; ++i)
     {
         cfg_ht input = cfg_node->input(i);
-        bitset_set(live(input).out, def.id);
+        live(input).out.insert(def.id);
         _live_visit(def, input);
     }
 }
@@ -60,8 +52,8 @@ void calc_ssa_liveness(ssa_ht node)
             assert(node->op() == SSA_phi_copy);
             assert(node->cfg_node() == ocfg->input(oe.index));
 
-            //bitset_set(live(ocfg).in, node.index);
-            bitset_set(live(node->cfg_node()).out, node.id);
+            //live(ocfg).in.insert(node.id);
+            live(node->cfg_node()).out.insert(node.id);
             //_live_visit(node, node->cfg_node());
         }
         else
@@ -72,33 +64,20 @@ void calc_ssa_liveness(ssa_ht node)
     }
 }
 
-unsigned calc_ssa_liveness(ir_t const& ir)
-{
-    return calc_ssa_liveness(ir, ssa_pool::array_size());
-}
-
-unsigned calc_ssa_liveness(ir_t const& ir, unsigned pool_size)
+void calc_ssa_liveness(ir_t const& ir)
 {
-    using namespace liveness_impl;
     cg_data_resize();
-    bitset_pool.clear();
-    assert(pool_size >= ssa_pool::size());
-    set_size = ::bitset_size<>(pool_size);
 
     for(cfg_ht cfg_it = ir.cfg_begin(); cfg_it; ++cfg_it)
     {
         auto& d = live(cfg_it);
-        d.in  = bitset_pool.alloc(set_size);
-        d.out = bitset_pool.alloc(set_size);
-        assert(d.in);
-        assert(d.out);
+        d.in.clear();
+        d.out.clear();
     }
 
     for(cfg_ht cfg_it = ir.cfg_begin(); cfg_it; ++cfg_it)
     for(ssa_ht ssa_it = cfg_it->ssa_begin(); ssa_it; ++ssa_it)
         calc_ssa_liveness(ssa_it);
-
-    return set_size;
 }
 
 void clear_liveness_for(ir_t const& ir, ssa_ht node)
@@ -106,8 +85,8 @@ void clear_liveness_for(ir_t const& ir, ssa_ht node)
     for(cfg_ht cfg_it = ir.cfg_begin(); cfg_it; ++cfg_it)
     {
         auto& d = live(cfg_it);
-        bitset_clear(d.in, node.id);
-        bitset_clear(d.out, node.id);
+        d.in.remove(node.id);
+        d.out.remove(node.id);
     }
 }
 
@@ -121,10 +100,10 @@ bool live_at_def(ssa_ht range, ssa_ht def)
 
     // If 'range' begins before 'def':
     if((same_cfg && cg_data(range).schedule.index < cg_data(def).schedule.index)
-       || bitset_test(def_live.in, range.id))
+       || def_live.in.count(range.id))
     {
         // Interfere if range is also live-out at def.
-        if(bitset_test(def_live.out, range.id))
+        if(def_live.out.count(range.id))
             return true;
 
         // Test to see if a use occurs after def:
@@ -161,22 +140,17 @@ bool live_range_overlap(ssa_ht a, ssa_ht b)
 
 std::size_t live_range_busyness(ir_t& ir, ssa_ht h)
 {
-    using namespace liveness_impl;
-
     std::size_t total_size = 0;
 
     for(cfg_ht cfg_it = ir.cfg_begin(); cfg_it; ++cfg_it)
     {
         auto& ld = live(cfg_it);
 
-        assert(ld.in);
-        assert(ld.out);
-
-        if(bitset_test(ld.in, h.id))
-            total_size += bitset_popcount(set_size, ld.in);
+        if(ld.in.count(h.id))
+            total_size += ld.in.size();
 
-        if(bitset_test(ld.out, h.id))
-            total_size += bitset_popcount(set_size, ld.out);
+        if(ld.out.count(h.id))
+            total_size += ld.out.size();
     }
 
     return total_size;
@@ -3,24 +3,14 @@
 
 // A self-contained implementation of live variable analysis.
 
-#include "array_pool.hpp"
-#include "bitset.hpp"
+#include <cstddef>
+
 #include "ir_decl.hpp"
-#include "thread"
 
 class fn_t;
 
-namespace liveness_impl
-{
-    extern TLS array_pool_t<bitset_uint_t> bitset_pool;
-    extern TLS unsigned set_size;
-}
-
-inline unsigned live_set_size() { return liveness_impl::set_size; }
-
 void calc_ssa_liveness(ssa_ht node); // only does a single node
-unsigned calc_ssa_liveness(ir_t const& ir);
-unsigned calc_ssa_liveness(ir_t const& ir, unsigned pool_size);
+void calc_ssa_liveness(ir_t const& ir);
 
 void clear_liveness_for(ir_t const& ir, ssa_ht node);
 
@@ -0,0 +1,714 @@
+#include "compile_cache.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string_view>
+#include <system_error>
+
+#include "asm_proc.hpp"
+#include "compiler_error.hpp"
+#include "file.hpp"
+#include "fnv1a.hpp"
+#include "format.hpp"
+#include "globals.hpp"
+#include "group.hpp"
+#include "lvar.hpp"
+#include "options.hpp"
+#include "pgo.hpp"
+#include "rom.hpp"
+
+namespace fs = ::std::filesystem;
+
+namespace
+{
+
+// Increment this when the format changes:
+constexpr std::uint32_t CACHE_VERSION = 3;
+constexpr std::array<char, 4> CACHE_MAGIC = { 'N', 'F', 'C', 'C' };
+constexpr std::size_t HEADER_SIZE = sizeof(CACHE_MAGIC) + sizeof(CACHE_VERSION) + sizeof(std::uint64_t);
+
+// Thrown when a cache entry can't be read back.
+struct cache_miss_t {};
+
+// How a locator's handle gets stored:
+enum loc_handle_t : std::uint8_t
+{
+    LOC_HANDLE_RAW,
+    LOC_HANDLE_FN,
+    LOC_HANDLE_GMEMBER,
+    LOC_HANDLE_CONST,
+    LOC_HANDLE_GLOBAL,
+};
+
+// The bits of 'locator_t' that hold its handle.
+// ('locator_t::set_handle' can't be used, as it also clobbers the neighboring bits.)
+constexpr std::uint64_t LOC_HANDLE_MASK = 0x1FFFFFull << 32ull;
+
+std::uint64_t strip_handle(locator_t loc) { return loc.to_uint() & ~LOC_HANDLE_MASK; }
+
+locator_t with_handle(std::uint64_t bare, std::uint32_t handle)
+{
+    return locator_t::from_uint(bare | ((std::uint64_t(handle) << 32ull) & LOC_HANDLE_MASK));
+}
+
+fs::path entry_path(std::uint64_t key)
+{
+    char name[32];
+    std::snprintf(name, sizeof(name), "%016llx.fnc", static_cast<unsigned long long>(key));
+    return compiler_options().cache_dir / name;
+}
+
+} // end anonymous namespace
+
+class cache_writer_t
+{
+public:
+    std::vector<std::uint8_t> bytes;
+
+    // Becomes false when something is written that can't be restored in a later run.
+    bool storable = true;
+
+    template<typename T>
+    void raw(T const& t)
+    {
+        static_assert(std::is_trivially_copyable_v<T>);
+        std::uint8_t const* ptr = reinterpret_cast<std::uint8_t const*>(&t);
+        bytes.insert(bytes.end(), ptr, ptr + sizeof(T));
+    }
+
+    void str(std::string_view view)
+    {
+        raw(std::uint32_t(view.size()));
+        bytes.insert(bytes.end(), view.begin(), view.end());
+    }
+
+    void gmember(gmember_ht h)
+    {
+        str(h->gvar.global.name);
+        raw(std::uint16_t(h->member()));
+    }
+
+    void loc(locator_t loc);
+
+    template<typename H, typename Fn>
+    void handles(xbitset_t<H> const& bs, Fn const& write)
+    {
+        unsigned count = 0;
+        bs.for_each([&](H) { ++count; });
+        raw(std::uint32_t(count));
+        bs.for_each(write);
+    }
+
+    std::uint64_t hash() const { return fnv1a<std::uint64_t>::hash(reinterpret_cast<char const*>(bytes.data()), bytes.size()); }
+};
+
+class cache_reader_t
+{
+public:
+    cache_reader_t(std::uint8_t const* begin, std::uint8_t const* end)
+    : m_ptr(begin)
+    , m_end(end)
+    {}
+
+    bool done() const { return m_ptr == m_end; }
+
+    template<typename T>
+    T raw()
+    {
+        static_assert(std::is_trivially_copyable_v<T>);
+        T t;
+        take(&t, sizeof(T));
+        return t;
+    }
+
+    std::string_view str()
+    {
+        std::uint32_t const size = raw<std::uint32_t>();
+        if(std::size_t(m_end - m_ptr) < size)
+            throw cache_miss_t();
+        std::string_view const view(reinterpret_cast<char const*>(m_ptr), size);
+        m_ptr += size;
+        return view;
+    }
+
+    std::uint32_t count(std::size_t min_element_size)
+    {
+        std::uint32_t const count = raw<std::uint32_t>();
+        if(std::size_t(m_end - m_ptr) < count * min_element_size)
+            throw cache_miss_t();
+        return count;
+    }
+
+    global_t& global(global_class_t gclass)
+    {
+        global_t* global = global_t::lookup_sourceless(str());
+        if(!global || global->gclass() != gclass)
+            throw cache_miss_t();
+        return *global;
+    }
+
+    fn_ht fn() { return global(GLOBAL_FN).handle<fn_ht>(); }
+
+    gmember_ht gmember()
+    {
+        gvar_t const& gvar = global(GLOBAL_VAR).impl<gvar_t>();
+        unsigned const member = raw<std::uint16_t>();
+        if(member >= gvar.end().id - gvar.begin().id)
+            throw cache_miss_t();
+        return { gvar.begin().id + member };
+    }
+
+    group_t& group()
+    {
+        group_t* group = group_t::lookup_sourceless(str());
+        if(!group)
+            throw cache_miss_t();
+        return *group;
+    }
+
+    locator_t loc();
+
+    template<typename H, typename Fn>
+    void handles(xbitset_t<H>& bs, Fn const& read)
+    {
+        bs = xbitset_t<H>(nullptr);
+        for(unsigned n = count(sizeof(std::uint32_t)); n; --n)
+            bs.set(read().id);
+    }
+
+private:
+    void take(void* dest, std::size_t size)
+    {
+        if(std::size_t(m_end - m_ptr) < size)
+            throw cache_miss_t();
+        std::memcpy(dest, m_ptr, size);
+        m_ptr += size;
+    }
+
+    std::uint8_t const* m_ptr;
+    std::uint8_t const* m_end;
+};
+
+void cache_writer_t::loc(locator_t loc)
+{
+    locator_class_t const lclass = loc.lclass();
+    std::uint32_t const handle = loc.handle();
+
+    std::uint64_t const bare = strip_handle(loc);
+
+    switch(lclass)
+    {
+    // These refer to data that only exists for this run:
+    case LOC_GMEMBER_SET:
+    case LOC_PTR_SET:
+    case LOC_STMT:
+    case LOC_PHI:
+    case LOC_SSA:
+    case LOC_ROM_ARRAY:
+    case LOC_LT_EXPR:
+    case LOC_RESET_GROUP_VARS:
+    case LOC_ASM_GOTO_MODE:
+        storable = false;
+        raw(LOC_HANDLE_RAW);
+        raw(loc.to_uint());
+        break;
+
+    case LOC_GMEMBER:
+        raw(LOC_HANDLE_GMEMBER);
+        raw(bare);
+        gmember({ handle });
+        break;
+
+    case LOC_NAMED_LABEL:
+        raw(LOC_HANDLE_GLOBAL);
+        raw(bare);
+        str(global_ht{ handle }->name);
+        break;
+
+    default:
+        if(has_fn(lclass))
+        {
+            raw(LOC_HANDLE_FN);
+            raw(bare);
+            str(fn_ht{ handle }->global.name);
+        }
+        else if(has_const(lclass))
+        {
+            raw(LOC_HANDLE_CONST);
+            raw(bare);
+            str(const_ht{ handle }->global.name);
+        }
+        else
+        {
+            raw(LOC_HANDLE_RAW);
+            raw(loc.to_uint());
+        }
+        break;
+    }
+}
+
+locator_t cache_reader_t::loc()
+{
+    loc_handle_t const kind = raw<loc_handle_t>();
+    std::uint64_t const bits = raw<std::uint64_t>();
+
+    switch(kind)
+    {
+    case LOC_HANDLE_RAW:
+        return locator_t::from_uint(bits);
+    case LOC_HANDLE_FN:
+        return with_handle(bits, fn().id);
+    case LOC_HANDLE_GMEMBER:
+        return with_handle(bits, gmember().id);
+    case LOC_HANDLE_CONST:
+        return with_handle(bits, global(GLOBAL_CONST).handle<const_ht>().id);
+    case LOC_HANDLE_GLOBAL:
+        {
+            global_t* global = global_t::lookup_sourceless(str());
+            if(!global)
+                throw cache_miss_t();
+            return with_handle(bits, global->handle().id);
+        }
+    default:
+        throw cache_miss_t();
+    }
+}
+
+
+void compile_cache_t::note_resource(std::string const& filename, std::vector<std::uint8_t> const& data)
+{
+    std::uint64_t hash = fnv1a<std::uint64_t>::hash(filename);
+    hash = fnv1a<std::uint64_t>::hash(reinterpret_cast<char const*>(data.data()), data.size(), hash);
+
+    // Combine commutatively, as resources are read by several threads at once.
+    m_resource_hash += hash;
+
+    // Resources read while compiling aren't part of any key,
+    // so nothing compiled this run can be stored.
+    if(compiler_phase() == PHASE_COMPILE)
+        m_resource_in_compile = true;
+}
+
+void compile_cache_t::prepare()
+{
+    assert(compiler_phase() < PHASE_COMPILE);
+
+    options_t const& opts = compiler_options();
+
+    // Debug output gets written as a side effect of compiling, so don't skip that.
+    m_enabled = !opts.cache_dir.empty() && !opts.graphviz && !opts.ir_info;
+
+    if(!m_enabled)
+        return;
+
+    std::error_code ec;
+    fs::create_directories(opts.cache_dir, ec);
+    if(ec)
+    {
+        compiler_warning(fmt("Unable to create cache directory %: %", opts.cache_dir.string(), ec.message()));
+        m_enabled = false;
+        return;
+    }
+
+    cache_writer_t config;
+    config.raw(CACHE_VERSION);
+    config.str(VERSION);
+    config.str(GIT_COMMIT);
+    config.str(__DATE__ " " __TIME__);
+    config.str(opts.raw_mn);
+    config.str(opts.raw_mm);
+    config.raw(opts.raw_mc);
+    config.raw(opts.raw_mp);
+    config.str(opts.raw_system);
+    config.raw(opts.nes_system);
+    config.raw(opts.opt_level);
+    config.raw(opts.mul_impl);
+    config.raw(std::uint32_t(opts.source_names.size()));
+    for(fs::path const& name : opts.source_names)
+        config.str(name.string());
+    config.raw(m_resource_hash.load());
+    m_config_hash = config.hash();
+
+    std::vector<std::uint64_t> file_hashes;
+    for(unsigned i = 0; i < opts.source_names.size(); ++i)
+    {
+        file_contents_t file(i);
+        file_hashes.push_back(fnv1a<std::uint64_t>::hash(file.source(), file.size()));
+    }
+
+    // Each fn depends on every source file reachable through its ideps:
+    m_closure_hashes.assign(fn_ht::pool().size(), 0);
+    m_fingerprints.assign(fn_ht::pool().size(), 0);
+
+    std::vector<bool> seen_globals;
+    std::vector<bool> seen_files;
+    std::vector<global_t const*> stack;
+
+    for(fn_t const& fn : fn_ht::values())
+    {
+        seen_globals.assign(global_ht::pool().size(), false);
+        seen_files.assign(file_hashes.size(), false);
+
+        seen_globals[fn.global.handle().id] = true;
+        stack.push_back(&fn.global);
+
+        while(!stack.empty())
+        {
+            global_t const& global = *stack.back();
+            stack.pop_back();
+
+            seen_files[global.pstring().file_i] = true;
+
+            for(auto const& pair : global.ideps())
+            {
+                unsigned const id = pair.first->handle().id;
+                if(!seen_globals[id])
+                {
+                    seen_globals[id] = true;
+                    stack.push_back(pair.first);
+                }
+            }
+        }
+
+        cache_writer_t closure;
+        for(unsigned i = 0; i < file_hashes.size(); ++i)
+        {
+            if(seen_files[i])
+            {
+                closure.raw(i);
+                closure.raw(file_hashes[i]);
+            }
+        }
+        m_closure_hashes[fn.handle().id] = closure.hash();
+    }
+}
+
+std::uint64_t compile_cache_t::key(fn_t const& fn)
+{
+    cache_writer_t w;
+    w.raw(m_config_hash);
+    w.raw(m_closure_hashes[fn.handle().id]);
+    w.str(fn.global.name);
+    w.raw(fn.fclass);
+
+    // Precheck facts, which also depend on the fn's callers:
+    w.raw(fn.precheck_called());
+    w.raw(fn.precheck_romv());
+    w.raw(fn.m_precheck_fences);
+    w.raw(fn.m_precheck_wait_nmi);
+    w.raw(fn.m_referenced.load());
+
+    std::vector<std::string_view> modes;
+    for(fn_ht mode : fn.precheck_parent_modes())
+        modes.push_back(mode->global.name);
+    std::sort(modes.begin(), modes.end());
+    for(std::string_view mode : modes)
+        w.str(mode);
+
+    if(fn.m_fence_rw)
+        w.handles(fn.m_fence_rw, [&](gmember_ht h){ w.gmember(h); });
+
+    // The fn's profile, for '--profile-use':
+    w.raw(pgo_enabled());
+    if(pgo_fn_t const* pgo = pgo_lookup(fn.global.name))
+    {
+        w.raw(pgo->calls);
+        w.raw(pgo->cycles);
+        w.raw(pgo->nodes);
+        w.raw(pgo->hot());
+
+        std::vector<std::pair<unsigned, std::uint64_t>> labels;
+        for(auto const& pair : pgo->labels)
+            labels.emplace_back(pair.first, pair.second);
+        std::sort(labels.begin(), labels.end());
+        for(auto const& pair : labels)
+        {
+            w.raw(pair.first);
+            w.raw(pair.second);
+        }
+    }
+
+    // The compiled output of each fn this one waited on:
+    std::vector<std::pair<std::string_view, std::uint64_t>> deps;
+    for(auto const& pair : fn.global.ideps())
+    {
+        if(pair.first->gclass() != GLOBAL_FN)
+            continue;
+        if(pair.second.calc != IDEP_VALUE || pair.second.depends_on != IDEP_VALUE)
+            continue;
+        deps.emplace_back(pair.first->name, m_fingerprints[pair.first->handle<fn_ht>().id]);
+    }
+    std::sort(deps.begin(), deps.end());
+    for(auto const& dep : deps)
+    {
+        w.str(dep.first);
+        w.raw(dep.second);
+    }
+
+    return w.hash();
+}
+
+void compile_cache_t::write(cache_writer_t& w, fn_t const& fn)
+{
+    w.handles(fn.m_ir_reads, [&](gmember_ht h){ w.gmember(h); });
+    w.handles(fn.m_ir_writes, [&](gmember_ht h){ w.gmember(h); });
+    w.handles(fn.m_ir_group_vars, [&](group_vars_ht h){ w.str(h->group.name); });
+    w.handles(fn.m_ir_deref_groups, [&](group_ht h){ w.str(h->name); });
+    w.handles(fn.m_ir_calls, [&](fn_ht h){ w.str(h->global.name); });
+    w.raw(fn.m_ir_tests_ready);
+    w.raw(fn.m_ir_io_pure);
+    w.raw(fn.m_ir_fences);
+    w.raw(fn.m_always_inline);
+    w.loc(fn.m_first_bank_switch);
+
+    lvars_manager_t const& lvars = fn.m_lvars;
+    w.raw(lvars.m_seen_args);
+    w.raw(std::uint32_t(lvars.m_map.size()));
+    for(locator_t loc : lvars.m_map)
+        w.loc(loc);
+    w.raw(std::uint32_t(lvars.m_this_lvar_info.size()));
+    for(auto const& info : lvars.m_this_lvar_info)
+    {
+        w.raw(info.size);
+        w.raw(info.zp_only);
+        w.raw(info.zp_valid);
+        w.raw(info.ptr_hi);
+        w.raw(info.ptr_alt);
+    }
+    w.raw(std::uint32_t(lvars.m_lvar_interferences.size()));
+    for(bitset_uint_t word : lvars.m_lvar_interferences)
+        w.raw(word);
+    w.raw(std::uint32_t(lvars.m_fn_interferences.size()));
+    for(auto const& fns : lvars.m_fn_interferences)
+    {
+        w.raw(std::uint32_t(fns.size()));
+        for(fn_ht h : fns)
+            w.str(h->global.name);
+    }
+    w.raw(lvars.m_num_this_lvars);
+    w.raw(lvars.m_bitset_size);
+
+    asm_proc_t const& proc = fn.rom_proc().safe().asm_proc();
+    w.loc(proc.entry_label);
+    w.raw(std::uint32_t(proc.code.size()));
+    for(asm_inst_t const& inst : proc.code)
+    {
+        w.raw(inst.op);
+        w.raw(inst.ssa_op);
+        w.raw(inst.iasm_child);
+        w.loc(inst.arg);
+        w.loc(inst.alt);
+    }
+    w.raw(std::uint32_t(proc.pstrings.size()));
+    for(pstring_t pstring : proc.pstrings)
+        w.raw(pstring);
+
+    w.raw(std::uint32_t(fn.m_cfg_preorder.size()));
+    for(unsigned id : fn.m_cfg_preorder)
+        w.raw(id);
+
+    w.raw(std::uint32_t(fn.m_loop_bounds.size()));
+    for(auto const& pair : fn.m_loop_bounds)
+    {
+        w.loc(pair.first);
+        w.raw(pair.second);
+    }
+}
+
+void compile_cache_t::read(cache_reader_t& r, fn_t& fn)
+{
+    // Read everything before modifying 'fn', in case the entry is bad.
+    xbitset_t<gmember_ht> reads, writes;
+    xbitset_t<group_vars_ht> group_vars;
+    xbitset_t<group_ht> deref_groups;
+    xbitset_t<fn_ht> calls;
+
+    r.handles(reads, [&]{ return r.gmember(); });
+    r.handles(writes, [&]{ return r.gmember(); });
+    r.handles(group_vars, [&]
+    {
+        group_t& group = r.group();
+        if(group.gclass() != GROUP_VARS)
+            throw cache_miss_t();
+        return group.handle<group_vars_ht>();
+    });
+    r.handles(deref_groups, [&]{ return r.group().handle(); });
+    r.handles(calls, [&]{ return r.fn(); });
+    bool const tests_ready = r.raw<bool>();
+    bool const io_pure = r.raw<bool>();
+    bool const fences = r.raw<bool>();
+    bool const always_inline = r.raw<bool>();
+    locator_t const first_bank_switch = r.loc();
+
+    lvars_manager_t lvars;
+    lvars.m_seen_args = r.raw<std::uint64_t>();
+    for(unsigned n = r.count(sizeof(std::uint64_t)); n; --n)
+        if(!lvars.m_map.insert(r.loc()).second)
+            throw cache_miss_t();
+    lvars.m_this_lvar_info.resize(r.count(sizeof(std::uint16_t)));
+    for(auto& info : lvars.m_this_lvar_info)
+    {
+        info.size = r.raw<std::uint16_t>();
+        info.zp_only = r.raw<bool>();
+        info.zp_valid = r.raw<bool>();
+        info.ptr_hi = r.raw<bool>();
+        info.ptr_alt = r.raw<int>();
+    }
+    lvars.m_lvar_interferences.resize(r.count(sizeof(bitset_uint_t)));
+    for(bitset_uint_t& word : lvars.m_lvar_interferences)
+        word = r.raw<bitset_uint_t>();
+    lvars.m_fn_interferences.resize(r.count(sizeof(std::uint32_t)));
+    for(auto& fns : lvars.m_fn_interferences)
+        for(unsigned n = r.count(sizeof(std::uint32_t)); n; --n)
+            fns.insert(r.fn());
+    lvars.m_num_this_lvars = r.raw<unsigned>();
+    lvars.m_bitset_size = r.raw<unsigned>();
+
+    if(lvars.m_num_this_lvars > lvars.m_map.size()
+       || lvars.m_this_lvar_info.size() != lvars.m_num_this_lvars
+       || lvars.m_lvar_interferences.size() != std::size_t(lvars.m_map.size()) * lvars.m_bitset_size
+       || lvars.m_fn_interferences.size() != lvars.m_map.size())
+    {
+        throw cache_miss_t();
+    }
+
+    locator_t const entry_label = r.loc();
+    std::vector<asm_inst_t> code(r.count(sizeof(op_t)));
+    for(asm_inst_t& inst : code)
+    {
+        inst.op = r.raw<op_t>();
+        inst.ssa_op = r.raw<ssa_op_t>();
+        inst.iasm_child = r.raw<int>();
+        inst.arg = r.loc();
+        inst.alt = r.loc();
+#ifndef NDEBUG
+        inst.cost = 0;
+#endif
+        if(inst.op >= NUM_OPS)
+            throw cache_miss_t();
+    }
+    std::vector<pstring_t> pstrings(r.count(sizeof(pstring_t)));
+    for(pstring_t& pstring : pstrings)
+        pstring = r.raw<pstring_t>();
+    std::vector<unsigned> cfg_preorder(r.count(sizeof(unsigned)));
+    for(unsigned& id : cfg_preorder)
+        id = r.raw<unsigned>();
+    std::vector<std::pair<locator_t, unsigned>> loop_bounds(r.count(sizeof(unsigned)));
+    for(auto& pair : loop_bounds)
+    {
+        pair.first = r.loc();
+        pair.second = r.raw<unsigned>();
+    }
+
+    if(!r.done())
+        throw cache_miss_t();
+
+    asm_proc_t proc(fn.handle(), std::move(code), entry_label);
+    proc.pstrings = std::move(pstrings);
+    proc.build_label_offsets();
+
+    // Commit:
+    fn.m_ir_reads = std::move(reads);
+    fn.m_ir_writes = std::move(writes);
+    fn.m_ir_group_vars = std::move(group_vars);
+    fn.m_ir_deref_groups = std::move(deref_groups);
+    fn.m_ir_calls = std::move(calls);
+    fn.m_ir_tests_ready = tests_ready;
+    fn.m_ir_io_pure = io_pure;
+    fn.m_ir_fences = fences;
+    fn.m_always_inline = always_inline;
+    fn.assign_first_bank_switch(first_bank_switch);
+    fn.assign_lvars(std::move(lvars));
+    fn.m_cfg_preorder = std::move(cfg_preorder);
+    fn.m_loop_bounds = std::move(loop_bounds);
+    fn.rom_proc().safe().assign(std::move(proc));
+}
+
+bool compile_cache_t::load(fn_t& fn)
+{
+    if(!m_enabled)
+        return false;
+
+    std::uint64_t const key = compile_cache_t::key(fn);
+
+    std::vector<std::uint8_t> bytes;
+    bool const found = read_binary_file(entry_path(key).string().c_str(), [&](std::size_t size)
+    {
+        bytes.resize(size);
+        return bytes.data();
+    });
+
+    try
+    {
+        if(!found)
+            throw cache_miss_t();
+
+        cache_reader_t header(bytes.data(), bytes.data() + bytes.size());
+        if(header.raw<std::array<char, 4>>() != CACHE_MAGIC
+           || header.raw<std::uint32_t>() != CACHE_VERSION
+           || header.raw<std::uint64_t>() != key)
+        {
+            throw cache_miss_t();
+        }
+
+        std::uint8_t const* const payload = bytes.data() + HEADER_SIZE;
+        cache_reader_t r(payload, bytes.data() + bytes.size());
+        read(r, fn);
+
+        m_fingerprints[fn.handle().id] = fnv1a<std::uint64_t>::hash(
+            reinterpret_cast<char const*>(payload), bytes.size() - HEADER_SIZE);
+    }
+    catch(cache_miss_t const&)
+    {
+        ++m_misses;
+        return false;
+    }
+
+    ++m_hits;
+    return true;
+}
+
+void compile_cache_t::store(fn_t const& fn)
+{
+    if(!m_enabled)
+        return;
+
+    cache_writer_t w;
+    write(w, fn);
+    m_fingerprints[fn.handle().id] = w.hash();
+
+    if(!w.storable || fn.iasm || m_resource_in_compile)
+        return;
+
+    std::uint64_t const key = compile_cache_t::key(fn);
+
+    cache_writer_t header;
+    header.raw(CACHE_MAGIC);
+    header.raw(CACHE_VERSION);
+    header.raw(key);
+    assert(header.bytes.size() == HEADER_SIZE);
+
+    // Write to a temporary file first, so that other processes never see a partial entry.
+    fs::path const path = entry_path(key);
+    fs::path tmp_path = path;
+    tmp_path += fmt(".%.tmp", m_tmp_id++);
+
+    bool written;
+    {
+        std::ofstream of(tmp_path, std::ios::binary);
+        of.write(reinterpret_cast<char const*>(header.bytes.data()), header.bytes.size());
+        of.write(reinterpret_cast<char const*>(w.bytes.data()), w.bytes.size());
+        written = bool(of);
+    }
+
+    // The cache is best-effort; failing to write an entry isn't an error.
+    std::error_code ec;
+    if(written)
+        fs::rename(tmp_path, path, ec);
+    if(!written || ec)
+        fs::remove(tmp_path, ec);
+}
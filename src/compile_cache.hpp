@@ -0,0 +1,68 @@
+#ifndef COMPILE_CACHE_HPP
+#define COMPILE_CACHE_HPP
+
+// Persists the output of 'fn_t::compile' across runs of the compiler,
+// so that unchanged functions can skip the optimizer and code generator.
+//
+// Each function is keyed on:
+//  - The compiler build and its code-generating options.
+//  - The contents of every source file reachable through its 'ideps'.
+//  - The facts precheck computed about it (callers, modes, etc).
+//  - The compiled output of every function it depends on.
+//
+// Locators are stored by global name rather than by handle,
+// as handles are not stable between runs.
+// Procs that refer to run-specific data (ROM arrays, link-time expressions, etc)
+// are never stored.
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "decl.hpp"
+
+class fn_t;
+class cache_writer_t;
+class cache_reader_t;
+
+class compile_cache_t
+{
+public:
+    static bool enabled() { return m_enabled; }
+
+    // Call before 'PHASE_COMPILE' to compute the parts of each key shared by every function.
+    static void prepare();
+
+    // Restores the output of 'fn_t::compile' for 'fn', if cached.
+    static bool load(fn_t& fn);
+
+    // Stores the output of 'fn_t::compile' for 'fn'.
+    static void store(fn_t const& fn);
+
+    // Tracks resources read by the program, as their contents are part of every key.
+    static void note_resource(std::string const& filename, std::vector<std::uint8_t> const& data);
+
+    static unsigned hits() { return m_hits; }
+    static unsigned misses() { return m_misses; }
+
+private:
+    static std::uint64_t key(fn_t const& fn);
+    static void write(cache_writer_t& w, fn_t const& fn);
+    static void read(cache_reader_t& r, fn_t& fn);
+
+    inline static bool m_enabled = false;
+    inline static std::uint64_t m_config_hash = 0;
+    inline static std::atomic<std::uint64_t> m_resource_hash = 0;
+    inline static std::atomic<bool> m_resource_in_compile = false;
+    inline static std::atomic<unsigned> m_hits = 0;
+    inline static std::atomic<unsigned> m_misses = 0;
+    inline static std::atomic<unsigned> m_tmp_id = 0;
+
+    // Indexed by 'fn_ht'. Each fn writes its own entry,
+    // and the build order guarantees ideps are written before they're read.
+    inline static std::vector<std::uint64_t> m_closure_hashes;
+    inline static std::vector<std::uint64_t> m_fingerprints;
+};
+
+#endif
@@ -449,6 +449,10 @@ ABSTRACT(SSA_read_array16_b) = abstract_bottom;
 ABSTRACT(SSA_write_array16_b) = abstract_bottom;
 ABSTRACT(SSA_mul8_lo) = abstract_bottom;
 ABSTRACT(SSA_mul8_hi) = abstract_bottom;
+ABSTRACT(SSA_mul16x8_lo) = abstract_bottom;
+ABSTRACT(SSA_mul16x8_mid) = abstract_bottom;
+ABSTRACT(SSA_mul16x8_hi) = abstract_bottom;
+ABSTRACT(SSA_div8_rem) = abstract_bottom;
 ABSTRACT(SSA_read_mapper_state) = abstract_bottom;
 ABSTRACT(SSA_write_mapper_state) = abstract_bottom;
 
@@ -803,6 +807,37 @@ ABSTRACT(SSA_mul) = ABSTRACT_FN
     assert(result[0].is_normalized(result.cm));
 };
 
+// Division is only defined for unsigned whole numbers.
+// Dividing by zero results in all ones, matching the run-time routine.
+static constexpr auto abstract_div = ABSTRACT_FN
+{
+    assert(argn == 2 && result.vec.size() >= 1);
+    assert(!result.cm.signed_);
+
+    if(handle_top(cv, argn, result))
+        return;
+
+    auto const& L = cv[0][0];
+    auto const& R = cv[1][0];
+
+    fixed_uint_t const all_ones = result.cm.mask >> fixed_t::shift;
+
+    fixed_uint_t const L_min = L.bounds.min >> fixed_t::shift;
+    fixed_uint_t const L_max = L.bounds.max >> fixed_t::shift;
+    fixed_uint_t const R_min = R.bounds.min >> fixed_t::shift;
+    fixed_uint_t const R_max = R.bounds.max >> fixed_t::shift;
+
+    fixed_uint_t const min = R_max ? L_min / R_max : all_ones;
+    fixed_uint_t const max = R_min ? L_max / R_min : all_ones;
+
+    result[0].bounds = { fixed_sint_t(min << fixed_t::shift), fixed_sint_t(max << fixed_t::shift) };
+    result[0].bits = from_bounds(result[0].bounds, result.cm);
+    assert(result[0].is_normalized(result.cm));
+};
+
+ABSTRACT(SSA_div) = abstract_div;
+ABSTRACT(SSA_div8) = abstract_div;
+
 constraints_t abstract_eq(constraints_t lhs, constraints_mask_t lhs_cm, 
                           constraints_t rhs, constraints_mask_t rhs_cm,
                           bool sign_diff)
@@ -1638,6 +1673,7 @@ NARROW(SSA_add) = narrow_add_sub<true>;
 NARROW(SSA_sub) = narrow_add_sub<false>;
 
 NARROW(SSA_mul) = narrow_bottom;
+NARROW(SSA_div) = NARROW_FN {};
 
 template<bool Eq>
 static void narrow_eq(constraints_def_t* cv, unsigned argn, constraints_def_t const& result)
@@ -582,6 +582,13 @@ TEST_CASE("abstract_mul", "[constraints]")
         test_op<int_cm_t, int_cm_t, int_cm_t, bool_cm_t>(SSA_mul, [](fixed_sint_t* c) { return c[0] * c[1]; });
 }
 
+TEST_CASE("abstract_div", "[constraints]")
+{
+    std::srand(std::time(nullptr));
+    for(unsigned i = 0; i < TEST_ITER; ++i)
+        test_op<uint_cm_t, uint_cm_t, uint_cm_t>(SSA_div, [](fixed_sint_t* c) { return c[1] ? c[0] / c[1] : 0xF; });
+}
+
 TEST_CASE("abstract_eq", "[constraints]")
 {
     std::srand(std::time(nullptr));
@@ -646,7 +653,7 @@ TEST_CASE("abstract_sign_extend", "[constraints]")
         test_op<int_cm_t, int_cm_t>(SSA_sign_extend, [](fixed_sint_t* c) { return c[0] & 0b1000 ? 0xFF : 0; });
 }
 
-TEST_CASE("abstract_sign, "[constraints]")
+TEST_CASE("abstract_sign", "[constraints]")
 {
     std::srand(std::time(nullptr));
     for(unsigned i = 0; i < TEST_ITER; ++i)
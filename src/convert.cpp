@@ -5,6 +5,7 @@
 #include "compiler_error.hpp"
 #include "format.hpp"
 
+#include "asset_cache.hpp"
 #include "convert_compress.hpp"
 #include "convert_png.hpp"
 #include "ext_lex_tables.hpp"
@@ -88,7 +89,11 @@ conversion_t convert_file(char const* source, pstring_t script, fs::path preferr
             case ext_lex::TOK_png:
                 if(mods)
                     mods->validate(script, MOD_spr_8x16);
-                vec = png_to_chr(vec.data(), vec.size(), spr16);
+                {
+                    asset_key_t key("png_to_chr");
+                    key.bytes(vec.data(), vec.size()).add(spr16);
+                    vec = asset_cache_t::get(key, [&]{ return png_to_chr(vec.data(), vec.size(), spr16); });
+                }
                 break;
 
             case ext_lex::TOK_txt:
@@ -134,7 +139,7 @@ conversion_t convert_file(char const* source, pstring_t script, fs::path preferr
             std::vector<std::uint8_t> vec = read_file();
             ret = convert_pbz(vec.data(), vec.data() + vec.size());
         }
-        else if(view == "rlz"sv)
+        else if(view == "rlz"sv || view == "lz"sv || view == "rlz_or_lz"sv)
         {
             bool terminate = true;
             if(argn != 0)
@@ -146,7 +151,12 @@ conversion_t convert_file(char const* source, pstring_t script, fs::path preferr
                     compiler_error(args[0].pstring, "Expecting true or false.");
             }
             std::vector<std::uint8_t> vec = read_file();
-            ret = convert_rlz(vec.data(), vec.data() + vec.size(), terminate);
+            if(view == "rlz"sv)
+                ret = convert_rlz(vec.data(), vec.data() + vec.size(), terminate);
+            else if(view == "lz"sv)
+                ret = convert_lz(vec.data(), vec.data() + vec.size(), terminate);
+            else
+                ret = convert_rlz_or_lz(vec.data(), vec.data() + vec.size(), terminate);
         }
         else
             compiler_error(script, fmt("Unknown file type: %", view));
@@ -1,5 +1,16 @@
 #include "convert_compress.hpp"
 
+#include "asset_cache.hpp"
+
+// Compressing is slow for big assets, so results get cached.
+static std::vector<std::uint8_t> cached_compress(std::string_view name, std::uint8_t* begin, std::uint8_t* end, bool terminate,
+                                                 std::vector<std::uint8_t>(*compress)(std::uint8_t*, std::uint8_t*, bool))
+{
+    asset_key_t key(name);
+    key.bytes(begin, end - begin).add(terminate);
+    return asset_cache_t::get(key, [&]{ return compress(begin, end, terminate); });
+}
+
 std::vector<std::uint8_t> compress_pbz(std::uint8_t* begin, std::uint8_t* end)
 {
     using plane_t = std::array<std::uint8_t, 8>;
@@ -44,7 +55,9 @@ std::vector<std::uint8_t> compress_pbz(std::uint8_t* begin, std::uint8_t* end)
 conversion_t convert_pbz(std::uint8_t* begin, std::uint8_t* end)
 {
     std::size_t const size = end - begin;
-    conversion_t c = { .data = compress_pbz(begin, end) };
+    asset_key_t key("pbz");
+    key.bytes(begin, size);
+    conversion_t c = { .data = asset_cache_t::get(key, [&]{ return compress_pbz(begin, end); }) };
     c.named_values.push_back({ "chunks", ssa_value_t(size / 8, TYPE_INT) });
     if(size % 16 == 0)
         c.named_values.push_back({ "tiles", ssa_value_t(size / 16, TYPE_INT) });
@@ -53,66 +66,179 @@ conversion_t convert_pbz(std::uint8_t* begin, std::uint8_t* end)
 
 std::vector<std::uint8_t> compress_rlz(std::uint8_t* begin, std::uint8_t* end, bool terminate)
 {
-    std::vector<std::uint8_t> result;
+    // Finds the smallest encoding by working backwards,
+    // computing the cheapest way to encode every suffix of the input.
+
+    constexpr unsigned MIN_RUN = 3;
+    constexpr unsigned MAX_RUN = 129;
+    constexpr unsigned MAX_UNIQUE = 128;
+
     std::size_t const span = end - begin;
 
-    for(std::size_t i = 0; i < span;)
+    struct choice_t
     {
-        std::uint8_t c = begin[i];
+        std::uint32_t cost;
+        std::uint8_t length;
+        bool run;
+    };
 
-        // Count a run of identical characters.
+    std::vector<choice_t> choices(span + 1);
+    choices[span] = {};
 
-        unsigned run = 1;
-        while(run < 129 && i + run < span && begin[i + run] == c)
-            ++run;
+    unsigned run_length = 0;
+    for(std::size_t i = span; i-- > 0;)
+    {
+        if(i + 1 < span && begin[i] == begin[i + 1])
+            run_length = std::min<unsigned>(run_length + 1, MAX_RUN);
+        else
+            run_length = 1;
+
+        choice_t& best = choices[i];
+        best = { ~0u };
+
+        for(unsigned length = MIN_RUN; length <= run_length; ++length)
+            if(2 + choices[i + length].cost < best.cost)
+                best = { 2 + choices[i + length].cost, std::uint8_t(length), true };
+
+        unsigned const max_unique = std::min<std::size_t>(MAX_UNIQUE, span - i);
+        for(unsigned length = 1; length <= max_unique; ++length)
+            if(1 + length + choices[i + length].cost < best.cost)
+                best = { 1 + length + choices[i + length].cost, std::uint8_t(length), false };
+    }
+
+    std::vector<std::uint8_t> result;
+    result.reserve(choices[0].cost + terminate);
 
-        if(run > 2)
+    for(std::size_t i = 0; i < span;)
+    {
+        choice_t const& choice = choices[i];
+
+        if(choice.run)
+        {
+            result.push_back(choice.length - 2);
+            result.push_back(begin[i]);
+            i += choice.length;
+        }
+        else
         {
-            result.push_back(run - 2);
-            result.push_back(c);
-            i += run;
-            continue;
+            result.push_back(choice.length + 0x80 - 1);
+            result.insert(result.end(), begin + i, begin + i + choice.length);
+            i += choice.length;
         }
+    }
 
-        // Count a run of different characters.
+    if(terminate)
+        result.push_back(0);
+    
+    return result;
+}
+
+conversion_t convert_rlz(std::uint8_t* begin, std::uint8_t* end, bool terminate)
+{
+    conversion_t c = { .data = cached_compress("rlz", begin, end, terminate, &compress_rlz) };
+    return c;
+}
+
+std::vector<std::uint8_t> compress_lz(std::uint8_t* begin, std::uint8_t* end, bool terminate)
+{
+    // Like 'compress_rlz', this finds the smallest encoding by working backwards.
+    // At each position, only the longest match needs to be known,
+    // as every match costs the same, and shorter ones are its prefixes.
+
+    constexpr unsigned MIN_MATCH = 3;
+    constexpr unsigned MAX_MATCH = 130;
+    constexpr unsigned MAX_UNIQUE = 127;
+    constexpr unsigned WINDOW = 256;
+
+    std::size_t const span = end - begin;
 
-        unsigned match = 1;
-        run = 1;
-        while(match < 128 && i + match < span)
+    struct choice_t
+    {
+        std::uint32_t cost;
+        std::uint8_t length;
+        std::uint8_t distance; // Minus one. Only used by matches.
+        bool match;
+    };
+
+    std::vector<choice_t> choices(span + 1);
+    choices[span] = {};
+
+    // 'matches[d]' holds how many bytes match 'd + 1' bytes back, at the current position.
+    std::array<std::uint8_t, WINDOW> matches = {};
+
+    for(std::size_t i = span; i-- > 0;)
+    {
+        unsigned longest = 0;
+        unsigned longest_d = 0;
+
+        for(unsigned d = 0; d < WINDOW; ++d)
         {
-            if(begin[i + match] == c)
-            {
-                ++run;
-                if(run == 3)
-                {
-                    match -= 2;
-                    assert(match > 0);
-                    break;
-                }
-            }
+            if(d < i && begin[i] == begin[i - d - 1])
+                matches[d] = std::min<unsigned>(matches[d] + 1, MAX_MATCH);
             else
+                matches[d] = 0;
+
+            if(matches[d] > longest)
             {
-                run = 1;
-                c = begin[i + match];
+                longest = matches[d];
+                longest_d = d;
             }
-            
-            ++match;
         }
-        
-        result.push_back(match + 0x80 - 1);
-        for(unsigned j = 0; j < match; ++j)
-            result.push_back(begin[i + j]);
-        i += match;
+
+        choice_t& best = choices[i];
+        best = { ~0u };
+
+        for(unsigned length = MIN_MATCH; length <= longest; ++length)
+            if(2 + choices[i + length].cost < best.cost)
+                best = { 2 + choices[i + length].cost, std::uint8_t(length), std::uint8_t(longest_d), true };
+
+        unsigned const max_unique = std::min<std::size_t>(MAX_UNIQUE, span - i);
+        for(unsigned length = 1; length <= max_unique; ++length)
+            if(1 + length + choices[i + length].cost < best.cost)
+                best = { 1 + length + choices[i + length].cost, std::uint8_t(length), 0, false };
+    }
+
+    std::vector<std::uint8_t> result;
+    result.reserve(choices[0].cost + terminate);
+
+    for(std::size_t i = 0; i < span;)
+    {
+        choice_t const& choice = choices[i];
+
+        if(choice.match)
+        {
+            result.push_back(choice.length - MIN_MATCH + 0x80);
+            result.push_back(choice.distance);
+        }
+        else
+        {
+            result.push_back(choice.length);
+            result.insert(result.end(), begin + i, begin + i + choice.length);
+        }
+
+        i += choice.length;
     }
 
     if(terminate)
         result.push_back(0);
-    
+
     return result;
 }
 
-conversion_t convert_rlz(std::uint8_t* begin, std::uint8_t* end, bool terminate)
+conversion_t convert_lz(std::uint8_t* begin, std::uint8_t* end, bool terminate)
+{
+    conversion_t c = { .data = cached_compress("lz", begin, end, terminate, &compress_lz) };
+    return c;
+}
+
+conversion_t convert_rlz_or_lz(std::uint8_t* begin, std::uint8_t* end, bool terminate)
 {
-    conversion_t c = { .data = compress_rlz(begin, end, terminate) };
+    std::vector<std::uint8_t> rlz = cached_compress("rlz", begin, end, terminate, &compress_rlz);
+    std::vector<std::uint8_t> lz = cached_compress("lz", begin, end, terminate, &compress_lz);
+
+    // Ties go to RLZ, as it decodes faster and needs no RAM.
+    bool const is_lz = lz.size() < rlz.size();
+    conversion_t c = { .data = is_lz ? std::move(lz) : std::move(rlz) };
+    c.named_values.push_back({ "lz", ssa_value_t(is_lz, TYPE_BOOL) });
     return c;
 }
@@ -14,4 +14,11 @@ conversion_t convert_pbz(std::uint8_t* begin, std::uint8_t* end);
 std::vector<std::uint8_t> compress_rlz(std::uint8_t* begin, std::uint8_t* end, bool terminate);
 conversion_t convert_rlz(std::uint8_t* begin, std::uint8_t* end, bool terminate);
 
+// LZ77, with a 256-byte window. (See 'lib/decompress_lz.fab'.)
+std::vector<std::uint8_t> compress_lz(std::uint8_t* begin, std::uint8_t* end, bool terminate);
+conversion_t convert_lz(std::uint8_t* begin, std::uint8_t* end, bool terminate);
+
+// Uses whichever of RLZ or LZ is smaller, defining 'lz' to say which.
+conversion_t convert_rlz_or_lz(std::uint8_t* begin, std::uint8_t* end, bool terminate);
+
 #endif
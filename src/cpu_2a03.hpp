@@ -23,8 +23,6 @@ struct cpuStruct {
 	bool jam;
 };
 
-cpuStruct CPU;
-
 
 #define AC 		CPU.A
 #define XR		CPU.X
@@ -54,13 +52,13 @@ cpuStruct CPU;
 
 #define READ_VAL_IMM()  mem_rd(PCW+1)
 #define READ_ADR_ABS()	{ adr.l=mem_rd(PCW+1); adr.h=mem_rd(PCW+2); }
-#define READ_ADR_ABX()	{ READ_ADR_ABS(); adr.hl+=XR; }
-#define READ_ADR_ABY()	{ READ_ADR_ABS(); adr.hl+=YR; }
+#define READ_ADR_ABX()	{ READ_ADR_ABS(); crossed=(adr.l+XR)>0xff; adr.hl+=XR; }
+#define READ_ADR_ABY()	{ READ_ADR_ABS(); crossed=(adr.l+YR)>0xff; adr.hl+=YR; }
 #define READ_ADR_ZPG()	{ adr.l=READ_VAL_IMM(); adr.h=0; }
 #define READ_ADR_ZPX()	{ READ_ADR_ZPG(); adr.hl+=XR; adr.h=0; }
 #define READ_ADR_ZPY()	{ READ_ADR_ZPG(); adr.hl+=YR; adr.h=0; }
 #define READ_ADR_IDX()	{ adr.l=READ_VAL_IMM()+XR; adr.h=0; adr.hl=mem_rd(adr.hl)+(mem_rd(adr.hl+1)<<8); }
-#define READ_ADR_IDY()	{ READ_ADR_ZPG(); off=adr.hl; adr.l=mem_rd(off); adr.h=mem_rd((off+1)&0xff); adr.hl+=YR; }
+#define READ_ADR_IDY()	{ READ_ADR_ZPG(); off=adr.hl; adr.l=mem_rd(off); adr.h=mem_rd((off+1)&0xff); crossed=(adr.l+YR)>0xff; adr.hl+=YR; }
 
 //   
 
@@ -194,13 +192,13 @@ cpuStruct CPU;
 
 #define JSR()		{ PCW+=2; PUSH(PCH); PUSH(PCL); adr.l=mem_rd(PCW-1); adr.h=mem_rd(PCW); PCW=adr.hl; }
 #define RTS()		{ PULL(PCL); PULL(PCH); PCW++; }
-#define RTI()		{ PULL(PR); PULL(PCL); PULL(PCH); PCW++; }
+#define RTI()		{ PULL(PR); PULL(PCL); PULL(PCH); }
 #define JMP_ABS()	{ READ_ADR_ABS(); PCW=adr.hl; }
 #define JMP_IDR()	{ READ_ADR_ABS(); PCL=mem_rd(adr.hl); adr.l++; PCH=mem_rd(adr.hl); }
 
 // ( )
 
-#define BRANCH(cond)	{ if(cond) { off=READ_VAL_IMM(); PCW+=2; if((off&128)) PCW-=((off^0xff)+1); else PCW+=off; } else { PCW+=2; }}
+#define BRANCH(cond)	{ if(cond) { off=READ_VAL_IMM(); PCW+=2; ph=PCH; if((off&128)) PCW-=((off^0xff)+1); else PCW+=off; extra=(ph==PCH)?1:2; } else { PCW+=2; }}
 
 #define BCS()		{ BRANCH((PR&FLG_C)); }
 #define BEQ()		{ BRANCH((PR&FLG_Z)); }
@@ -346,11 +344,117 @@ cpuStruct CPU;
 
 #define LAS_ABY()	{ READ_ADR_ABY(); AC=mem_rd(adr.hl)&SR; SR=AC; XR=AC; PR_SET_SZ(AC); PCW+=3; }
 
+#define SAX_ZPG()	{ READ_ADR_ZPG(); mem_wr(adr.hl,AC&XR); PCW+=2; }
+#define SAX_ZPY()	{ READ_ADR_ZPY(); mem_wr(adr.hl,AC&XR); PCW+=2; }
+#define SAX_ABS()	{ READ_ADR_ABS(); mem_wr(adr.hl,AC&XR); PCW+=3; }
+#define SAX_IDX()	{ READ_ADR_IDX(); mem_wr(adr.hl,AC&XR); PCW+=2; }
+
+#define ISC_OP()	{ ph=mem_rd(adr.hl); ph++; mem_wr(adr.hl,ph); SBC_OP(ph); }
+#define ISC_ZPG()	{ READ_ADR_ZPG(); ISC_OP(); PCW+=2; }
+#define ISC_ZPX()	{ READ_ADR_ZPX(); ISC_OP(); PCW+=2; }
+#define ISC_ABS()	{ READ_ADR_ABS(); ISC_OP(); PCW+=3; }
+#define ISC_ABX()	{ READ_ADR_ABX(); ISC_OP(); PCW+=3; }
+#define ISC_ABY()	{ READ_ADR_ABY(); ISC_OP(); PCW+=3; }
+#define ISC_IDX()	{ READ_ADR_IDX(); ISC_OP(); PCW+=2; }
+#define ISC_IDY()	{ READ_ADR_IDY(); ISC_OP(); PCW+=2; }
+
+#define RLA_OP()	{ ph=mem_rd(adr.hl); ROL_OP(ph); mem_wr(adr.hl,ph); AND_OP(ph); }
+#define RLA_ZPG()	{ READ_ADR_ZPG(); RLA_OP(); PCW+=2; }
+#define RLA_ZPX()	{ READ_ADR_ZPX(); RLA_OP(); PCW+=2; }
+#define RLA_ABS()	{ READ_ADR_ABS(); RLA_OP(); PCW+=3; }
+#define RLA_ABX()	{ READ_ADR_ABX(); RLA_OP(); PCW+=3; }
+#define RLA_ABY()	{ READ_ADR_ABY(); RLA_OP(); PCW+=3; }
+#define RLA_IDX()	{ READ_ADR_IDX(); RLA_OP(); PCW+=2; }
+#define RLA_IDY()	{ READ_ADR_IDY(); RLA_OP(); PCW+=2; }
+
+#define RRA_OP()	{ ph=mem_rd(adr.hl); ROR_OP(ph); mem_wr(adr.hl,ph); ADC_OP(ph); }
+#define RRA_ZPG()	{ READ_ADR_ZPG(); RRA_OP(); PCW+=2; }
+#define RRA_ZPX()	{ READ_ADR_ZPX(); RRA_OP(); PCW+=2; }
+#define RRA_ABS()	{ READ_ADR_ABS(); RRA_OP(); PCW+=3; }
+#define RRA_ABX()	{ READ_ADR_ABX(); RRA_OP(); PCW+=3; }
+#define RRA_ABY()	{ READ_ADR_ABY(); RRA_OP(); PCW+=3; }
+#define RRA_IDX()	{ READ_ADR_IDX(); RRA_OP(); PCW+=2; }
+#define RRA_IDY()	{ READ_ADR_IDY(); RRA_OP(); PCW+=2; }
+
+#define SRE_OP()	{ ph=mem_rd(adr.hl); LSR_OP(ph); mem_wr(adr.hl,ph); EOR_OP(ph); }
+#define SRE_ZPG()	{ READ_ADR_ZPG(); SRE_OP(); PCW+=2; }
+#define SRE_ZPX()	{ READ_ADR_ZPX(); SRE_OP(); PCW+=2; }
+#define SRE_ABS()	{ READ_ADR_ABS(); SRE_OP(); PCW+=3; }
+#define SRE_ABX()	{ READ_ADR_ABX(); SRE_OP(); PCW+=3; }
+#define SRE_ABY()	{ READ_ADR_ABY(); SRE_OP(); PCW+=3; }
+#define SRE_IDX()	{ READ_ADR_IDX(); SRE_OP(); PCW+=2; }
+#define SRE_IDY()	{ READ_ADR_IDY(); SRE_OP(); PCW+=2; }
+
+#define ANC_IMM()	{ AND_OP(READ_VAL_IMM()); if((AC&128)) PR|=FLG_C; else PR&=~FLG_C; PCW+=2; }
+#define ALR_IMM()	{ AC&=READ_VAL_IMM(); LSR_OP(AC); PCW+=2; }
+#define ARR_IMM()	{ AC&=READ_VAL_IMM(); AC=(AC>>1)|((PR&FLG_C)?128:0); PR_SET_SZ(AC); PR&=~(FLG_C|FLG_V); \
+					PR|=((AC&64)?FLG_C:0)|((((AC>>6)^(AC>>5))&1)?FLG_V:0); PCW+=2; }
+#define AXS_IMM()	{ ph=READ_VAL_IMM(); pr=AC&XR; if(pr>=ph) PR|=FLG_C; else PR&=~FLG_C; XR=pr-ph; PR_SET_SZ(XR); PCW+=2; }
+
 
 
 // 
 
-inline void cpu_reset(void)
+// Instance of the CPU, which accesses memory through 'Bus'.
+template<typename Bus>
+class cpu_2a03_t
+{
+public:
+	explicit cpu_2a03_t(Bus& bus) : bus(bus) {}
+
+	cpuStruct CPU = {};
+
+	// Cycles taken by each opcode, not counting page crossings or branches.
+	static constexpr unsigned char cycle_table[256] =
+	{
+		7,6,2,8,3,3,5,5,3,2,2,2,4,4,6,6,
+		2,5,2,8,4,4,6,6,2,4,2,7,4,4,7,7,
+		6,6,2,8,3,3,5,5,4,2,2,2,4,4,6,6,
+		2,5,2,8,4,4,6,6,2,4,2,7,4,4,7,7,
+		6,6,2,8,3,3,5,5,3,2,2,2,3,4,6,6,
+		2,5,2,8,4,4,6,6,2,4,2,7,4,4,7,7,
+		6,6,2,8,3,3,5,5,4,2,2,2,5,4,6,6,
+		2,5,2,8,4,4,6,6,2,4,2,7,4,4,7,7,
+		2,6,2,6,3,3,3,3,2,2,2,2,4,4,4,4,
+		2,6,2,6,4,4,4,4,2,5,2,5,5,5,5,5,
+		2,6,2,6,3,3,3,3,2,2,2,2,4,4,4,4,
+		2,5,2,5,4,4,4,4,2,4,2,4,4,4,4,4,
+		2,6,2,8,3,3,5,5,2,2,2,2,4,4,6,6,
+		2,5,2,8,4,4,6,6,2,4,2,7,4,4,7,7,
+		2,6,2,8,3,3,5,5,2,2,2,2,4,4,6,6,
+		2,5,2,8,4,4,6,6,2,4,2,7,4,4,7,7,
+	};
+
+	// Opcodes which take an extra cycle when indexing crosses a page.
+	static constexpr unsigned char page_penalty_table[256] =
+	{
+		0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,
+		0,1,0,0,0,0,0,0,0,1,0,0,1,1,0,0,
+		0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,
+		0,1,0,0,0,0,0,0,0,1,0,0,1,1,0,0,
+		0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,
+		0,1,0,0,0,0,0,0,0,1,0,0,1,1,0,0,
+		0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,
+		0,1,0,0,0,0,0,0,0,1,0,0,1,1,0,0,
+		0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,
+		0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,
+		0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,
+		0,1,0,1,0,0,0,0,0,1,0,1,1,1,1,1,
+		0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,
+		0,1,0,0,0,0,0,0,0,1,0,0,1,1,0,0,
+		0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,
+		0,1,0,0,0,0,0,0,0,1,0,0,1,1,0,0,
+	};
+
+private:
+	Bus& bus;
+
+	unsigned char mem_rd(unsigned address) { return bus.mem_rd(address); }
+	void mem_wr(unsigned address, unsigned char data) { bus.mem_wr(address, data); }
+
+public:
+
+void reset()
 {
 	AC=0;
 	XR=0;
@@ -363,13 +467,21 @@ inline void cpu_reset(void)
 }
 
 
-inline void cpu_tick(void)
+// Executes one instruction, returning the number of cycles it took.
+unsigned tick()
 {
 	unsigned char ph,pr;
 	short int off,alu;
 	regPair adr;
+	bool crossed=false;
+	unsigned extra=0;
+
+	if(CPU.jam)
+		return 1;
 
-	switch(mem_rd(PCW))
+	unsigned char const op=mem_rd(PCW);
+
+	switch(op)
 	{
 	case 0x69: ADC_IMM();	break;
 	case 0x65: ADC_ZPG();	break;
@@ -620,10 +732,71 @@ inline void cpu_tick(void)
 
 	case 0xbb: LAS_ABY();	break;
 
+	case 0x87: SAX_ZPG();	break;
+	case 0x97: SAX_ZPY();	break;
+	case 0x8f: SAX_ABS();	break;
+	case 0x83: SAX_IDX();	break;
+
+	case 0xe7: ISC_ZPG();	break;
+	case 0xf7: ISC_ZPX();	break;
+	case 0xef: ISC_ABS();	break;
+	case 0xff: ISC_ABX();	break;
+	case 0xfb: ISC_ABY();	break;
+	case 0xe3: ISC_IDX();	break;
+	case 0xf3: ISC_IDY();	break;
+
+	case 0x27: RLA_ZPG();	break;
+	case 0x37: RLA_ZPX();	break;
+	case 0x2f: RLA_ABS();	break;
+	case 0x3f: RLA_ABX();	break;
+	case 0x3b: RLA_ABY();	break;
+	case 0x23: RLA_IDX();	break;
+	case 0x33: RLA_IDY();	break;
+
+	case 0x67: RRA_ZPG();	break;
+	case 0x77: RRA_ZPX();	break;
+	case 0x6f: RRA_ABS();	break;
+	case 0x7f: RRA_ABX();	break;
+	case 0x7b: RRA_ABY();	break;
+	case 0x63: RRA_IDX();	break;
+	case 0x73: RRA_IDY();	break;
+
+	case 0x47: SRE_ZPG();	break;
+	case 0x57: SRE_ZPX();	break;
+	case 0x4f: SRE_ABS();	break;
+	case 0x5f: SRE_ABX();	break;
+	case 0x5b: SRE_ABY();	break;
+	case 0x43: SRE_IDX();	break;
+	case 0x53: SRE_IDY();	break;
+
+	case 0x0b: ANC_IMM();	break;
+	case 0x2b: ANC_IMM();	break;
+	case 0x4b: ALR_IMM();	break;
+	case 0x6b: ARR_IMM();	break;
+	case 0xcb: AXS_IMM();	break;
+
 	default:
+		JAM();
 		break;
 	}
 
-	return;
+	if(CPU.jam)
+		return 1;
+
+	return cycle_table[op] + (crossed ? page_penalty_table[op] : 0) + extra;
+}
+
+// Triggers a non-maskable interrupt, returning the number of cycles it took.
+unsigned nmi()
+{
+	PUSH(PCH);
+	PUSH(PCL);
+	PUSH((PR&~FLG_B)|FLG_R);
+	PR|=FLG_I;
+	PCL=mem_rd(0xfffa);
+	PCH=mem_rd(0xfffb);
+	return 7;
 }
+};
+
 
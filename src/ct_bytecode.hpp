@@ -0,0 +1,101 @@
+#ifndef CT_BYTECODE_HPP
+#define CT_BYTECODE_HPP
+
+// Compile-time functions can be lowered into a compact stack bytecode,
+// which is then executed in place of walking the AST.
+// Only a subset of the language is supported: scalar arithmetic and
+// arrays of scalars held in locals. Anything else uses the AST interpreter.
+// (See 'eval.cpp')
+
+#include <cstdint>
+#include <vector>
+
+#include "decl.hpp"
+#include "fixed.hpp"
+#include "pstring.hpp"
+#include "rval.hpp"
+#include "type.hpp"
+
+#define CT_OP_XENUM \
+    X(CT_PUSH)          /* Push 'imms[arg]'. */\
+    X(CT_LOAD)          /* Push local 'arg'. */\
+    X(CT_STORE)         /* Pop into local 'arg', typed 'type'. */\
+    X(CT_CLEAR)         /* Uninitialize local 'arg'. */\
+    X(CT_DUP)\
+    X(CT_DROP)\
+    X(CT_LOAD_ELEM)     /* Pop an index, push from array local 'arg'. */\
+    X(CT_LOAD_CONST_ELEM) /* Pop an index, push from 'arrays[arg]'. */\
+    X(CT_STORE_ELEM)    /* Pop a value and an index, storing into array local 'arg'. */\
+    X(CT_ADD)\
+    X(CT_SUB)\
+    X(CT_AND)\
+    X(CT_OR)\
+    X(CT_XOR)\
+    X(CT_MUL)\
+    X(CT_DIV)\
+    X(CT_SHL)\
+    X(CT_SHR)\
+    X(CT_EQ)\
+    X(CT_NOT_EQ)\
+    X(CT_LT)\
+    X(CT_LTE)\
+    X(CT_NEG)\
+    X(CT_BITNOT)\
+    X(CT_NOT)\
+    /* Casts use 'arg' as flags: implicit, and applying under the top. */\
+    X(CT_PROMOTE)       /* Cast from 'lhs' to 'type'. */\
+    X(CT_TRUNCATE)\
+    X(CT_BOOLIFY)\
+    X(CT_CONVERT_INT)\
+    X(CT_ROUND_REAL)\
+    X(CT_JUMP)\
+    X(CT_JUMP_IF)\
+    X(CT_JUMP_UNLESS)\
+    X(CT_LOAD_ARRAY)    /* Push array local 'arg' onto the array stack. */\
+    X(CT_PUSH_ARRAY)    /* Push 'arrays[arg]' onto the array stack. */\
+    X(CT_STORE_ARRAY)\
+    X(CT_DROP_ARRAY)\
+    X(CT_NEW_ARRAY)     /* Push an uninitialized array of length 'arg'. */\
+    X(CT_FILL_ARRAY)    /* Pop a value, pushing an array of length 'arg' filled with it. */\
+    X(CT_MAKE_ARRAY)    /* Pop 'arg' values, pushing them as an array. */\
+    X(CT_CALL)          /* Call 'calls[arg]'. */\
+    X(CT_RETURN)\
+    X(CT_RETURN_ARRAY)\
+    X(CT_RETURN_VOID)\
+    X(CT_FAIL)          /* Defer to the AST interpreter, which will report the error. */
+
+enum ct_op_t : std::uint8_t
+{
+#define X(x) x,
+    CT_OP_XENUM
+#undef X
+};
+
+struct ct_inst_t
+{
+    ct_op_t op;
+    type_name_t type; // The result type.
+    type_name_t lhs;  // Operand types, when they matter.
+    type_name_t rhs;
+    std::uint32_t arg;
+};
+
+struct ct_call_t
+{
+    fn_ht fn;
+    pstring_t pstring;
+};
+
+struct ct_bytecode_t
+{
+    std::vector<ct_inst_t> code;
+    std::vector<fixed_uint_t> imms;
+    std::vector<ct_array_t> arrays; // Arrays of global and local consts.
+    std::vector<unsigned> array_lengths; // Pairs with 'arrays'.
+    std::vector<unsigned> local_lengths; // The array length of each local, or 0.
+    std::vector<ct_call_t> calls;
+    unsigned max_stack = 0;
+    unsigned max_array_stack = 0;
+};
+
+#endif
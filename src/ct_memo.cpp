@@ -0,0 +1,71 @@
+#include "ct_memo.hpp"
+
+#include "globals.hpp"
+#include "type.hpp"
+
+bool ct_memo_t::memoizable(fn_t const& fn)
+{
+    switch(fn.fclass)
+    {
+    case FN_CT:
+        return true;
+    case FN_FN:
+        return fn.global.compiled() && fn.ct_pure();
+    default:
+        return false;
+    }
+}
+
+bool ct_memo_t::key(fn_t const& fn, rval_t const* args, unsigned num_args, ct_memo_key_t& key)
+{
+    key.fn = fn.handle();
+    key.args.clear();
+
+    type_t const fn_type = fn.type();
+    assert(num_args == fn_type.num_params());
+
+    for(unsigned i = 0; i < num_args; ++i)
+    {
+        type_t const param = fn_type.type(i);
+        if(args[i].size() != num_members(param))
+            return false;
+
+        for(unsigned m = 0; m < args[i].size(); ++m)
+        {
+            if(ssa_value_t const* v = std::get_if<ssa_value_t>(&args[i][m]))
+                key.args.push_back(*v);
+            else
+            {
+                // Arrays are keyed on their contents, not their address.
+                ssa_value_t const* array = ct_array(args[i][m]);
+                if(!array)
+                    return false;
+                key.args.insert(key.args.end(), array, array + member_type(param, m).array_length());
+            }
+        }
+    }
+
+    return true;
+}
+
+bool ct_memo_t::lookup(ct_memo_key_t const& key, rval_t& result)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if(rval_t const* cached = m_map.mapped(key))
+        {
+            result = *cached;
+            ++m_hits;
+            return true;
+        }
+    }
+
+    ++m_misses;
+    return false;
+}
+
+void ct_memo_t::store(ct_memo_key_t&& key, rval_t const& result)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_map.emplace(std::move(key), [&]{ return result; });
+}
@@ -0,0 +1,65 @@
+#ifndef CT_MEMO_HPP
+#define CT_MEMO_HPP
+
+// Caches the results of pure compile-time calls,
+// so that a call repeated by many globals is only interpreted once.
+// The cache is shared by every compiler thread.
+
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+#include "robin/map.hpp"
+
+#include "decl.hpp"
+#include "ir_edge.hpp"
+#include "rval.hpp"
+
+class fn_t;
+
+struct ct_memo_key_t
+{
+    fn_ht fn;
+    std::vector<ssa_value_t> args; // Every argument, with arrays flattened.
+
+    bool operator==(ct_memo_key_t const&) const = default;
+};
+
+template<>
+struct std::hash<ct_memo_key_t>
+{
+    std::size_t operator()(ct_memo_key_t const& key) const noexcept
+    {
+        std::hash<ssa_value_t> hasher;
+        std::size_t h = key.fn.id;
+        for(ssa_value_t const& v : key.args)
+            h = rh::hash_combine(h, hasher(v));
+        return h;
+    }
+};
+
+class ct_memo_t
+{
+public:
+    // Returns true if calls to 'fn' can be memoized.
+    static bool memoizable(fn_t const& fn);
+
+    // Returns false if the arguments can't be used as a key.
+    static bool key(fn_t const& fn, rval_t const* args, unsigned num_args, ct_memo_key_t& key);
+
+    // Returns true and copies into 'result' if the call was cached.
+    static bool lookup(ct_memo_key_t const& key, rval_t& result);
+
+    static void store(ct_memo_key_t&& key, rval_t const& result);
+
+    static unsigned hits() { return m_hits; }
+    static unsigned misses() { return m_misses; }
+
+private:
+    inline static std::mutex m_mutex; // Protects 'm_map'.
+    inline static rh::robin_map<ct_memo_key_t, rval_t> m_map;
+    inline static std::atomic<unsigned> m_hits = 0;
+    inline static std::atomic<unsigned> m_misses = 0;
+};
+
+#endif
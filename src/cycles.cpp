@@ -0,0 +1,835 @@
+#include "cycles.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <optional>
+#include <queue>
+#include <vector>
+
+#include "asm_proc.hpp"
+#include "compiler_error.hpp"
+#include "format.hpp"
+#include "globals.hpp"
+#include "options.hpp"
+#include "rom.hpp"
+#include "runtime.hpp"
+
+namespace
+{
+    constexpr std::uint64_t UNBOUNDED = cycle_bounds_t::UNBOUNDED;
+
+    // The cycles it takes the CPU to enter an interrupt.
+    constexpr std::uint64_t INTERRUPT_CYCLES = 7;
+
+    std::uint64_t sat_add(std::uint64_t a, std::uint64_t b)
+    {
+        if(a == UNBOUNDED || b == UNBOUNDED || a + b < a)
+            return UNBOUNDED;
+        return a + b;
+    }
+
+    std::uint64_t sat_mul(std::uint64_t a, std::uint64_t b)
+    {
+        if(a == 0 || b == 0)
+            return 0;
+        if(a == UNBOUNDED || b == UNBOUNDED || a > UNBOUNDED / b)
+            return UNBOUNDED;
+        return a * b;
+    }
+
+    cycle_bounds_t operator+(cycle_bounds_t const& a, cycle_bounds_t const& b)
+        { return { sat_add(a.best, b.best), sat_add(a.worst, b.worst) }; }
+
+    cycle_bounds_t& operator+=(cycle_bounds_t& a, cycle_bounds_t const& b)
+        { return a = a + b; }
+
+    // For code whose length can't be determined.
+    constexpr cycle_bounds_t UNKNOWN_BOUNDS = { 0, UNBOUNDED };
+
+    // Cycles of a single, non-branching instruction.
+    // Reads using indexed modes take an extra cycle when they cross a page,
+    // which is only ruled out when the base address is page-aligned.
+    cycle_bounds_t inst_cycles(asm_inst_t const& inst)
+    {
+        cycle_bounds_t ret = { op_cycles(inst.op), op_cycles(inst.op) };
+
+        if(op_output_regs(inst.op) & REGF_M)
+            return ret;
+
+        switch(op_addr_mode(inst.op))
+        {
+        case MODE_ABSOLUTE_X:
+        case MODE_ABSOLUTE_Y:
+            if(!is_const(inst.arg.lclass()) || (inst.arg.data() & 0xFF))
+                ret.worst += 1;
+            break;
+        case MODE_INDIRECT_Y:
+            ret.worst += 1;
+            break;
+        default:
+            break;
+        }
+
+        return ret;
+    }
+
+    bool page_cross(unsigned from, unsigned to) { return (from ^ to) & 0xFF00; }
+
+    struct edge_t
+    {
+        unsigned to;
+        cycle_bounds_t cost; // Includes the instruction the edge leaves.
+    };
+
+    // Where a proc was placed in ROM.
+    struct placement_t
+    {
+        romv_t romv;
+        int bank;
+        std::uint16_t addr;
+    };
+
+    class cycle_analyzer_t
+    {
+    public:
+        cycle_analyzer_t();
+
+        cycle_bounds_t fn_bounds(fn_ht fn);
+        cycle_bounds_t runtime_bounds(runtime_rom_name_t name);
+        cycle_bounds_t proc_bounds(rom_proc_ht rom_proc);
+        cycle_bounds_t callee_bounds(locator_t loc);
+
+        bool placed(rom_proc_ht rom_proc) const { return rom_proc && !m_placements[rom_proc.id].empty(); }
+    private:
+        cycle_bounds_t analyze(asm_proc_t const& asm_proc, placement_t const& placement);
+
+        // All indexed by rom_proc id:
+        std::vector<std::vector<placement_t>> m_placements;
+        std::vector<std::optional<cycle_bounds_t>> m_bounds;
+        std::vector<bool> m_in_progress;
+    };
+
+    // The control flow of a linked proc, one node per instruction.
+    class proc_graph_t
+    {
+    public:
+        proc_graph_t(cycle_analyzer_t& analyzer, asm_proc_t const& asm_proc, placement_t const& placement);
+
+        // Bounds of executing from instruction 'start' until returning.
+        cycle_bounds_t bounds_from(unsigned start);
+    private:
+        unsigned exit() const { return m_succ.size() - 1; }
+        unsigned index_at(unsigned addr) const;
+        std::vector<unsigned> reachable(unsigned start) const;
+        void resolve_calls(std::vector<unsigned> const& nodes);
+        std::uint64_t best_from(unsigned start) const;
+        std::uint64_t worst_from(unsigned start, std::vector<unsigned> const& nodes);
+
+        fn_ht m_fn;
+        std::vector<unsigned> m_addr;
+        std::vector<std::vector<edge_t>> m_succ; // The last node is the exit.
+        std::vector<int> m_sub_call; // Internal JSR targets, folded into costs lazily.
+        std::vector<unsigned> m_loop_bound; // Indexed by instruction, or 0.
+        std::vector<std::optional<cycle_bounds_t>> m_memo;
+        std::vector<bool> m_in_progress;
+    };
+}
+
+cycle_analyzer_t::cycle_analyzer_t()
+{
+    m_placements.resize(rom_proc_ht::pool().size());
+    m_bounds.resize(rom_proc_ht::pool().size());
+    m_in_progress.resize(rom_proc_ht::pool().size());
+
+    auto const add_alloc = [&](auto const& alloc)
+    {
+        if(!alloc.span)
+            return;
+
+        alloc.data.visit([](rom_array_ht){}, [&](rom_proc_ht rom_proc)
+        {
+            m_placements[rom_proc.id].push_back({ alloc.romv, alloc.only_bank(), alloc.span.addr });
+        });
+    };
+
+    for(rom_static_t const& s : rom_static_ht::values())
+        add_alloc(s);
+    for(rom_once_t const& once : rom_once_ht::values())
+        add_alloc(once);
+    for(rom_many_t const& many : rom_many_ht::values())
+        add_alloc(many);
+}
+
+cycle_bounds_t cycle_analyzer_t::fn_bounds(fn_ht fn)
+{
+    return proc_bounds(fn->rom_proc());
+}
+
+cycle_bounds_t cycle_analyzer_t::runtime_bounds(runtime_rom_name_t name)
+{
+    cycle_bounds_t ret = UNKNOWN_BOUNDS;
+    runtime_data(name).visit([](rom_array_ht){}, [&](rom_proc_ht rom_proc)
+    {
+        ret = proc_bounds(rom_proc);
+    });
+    return ret;
+}
+
+cycle_bounds_t cycle_analyzer_t::proc_bounds(rom_proc_ht rom_proc)
+{
+    if(!placed(rom_proc))
+        return UNKNOWN_BOUNDS;
+
+    if(m_bounds[rom_proc.id])
+        return *m_bounds[rom_proc.id];
+
+    // Recursion can't be bounded:
+    if(m_in_progress[rom_proc.id])
+        return UNKNOWN_BOUNDS;
+    m_in_progress[rom_proc.id] = true;
+
+    cycle_bounds_t ret = { UNBOUNDED, 0 };
+    for(placement_t const& placement : m_placements[rom_proc.id])
+    {
+        cycle_bounds_t const bounds = analyze(rom_proc->asm_proc(), placement);
+        ret.best = std::min(ret.best, bounds.best);
+        ret.worst = std::max(ret.worst, bounds.worst);
+    }
+
+    m_in_progress[rom_proc.id] = false;
+    m_bounds[rom_proc.id] = ret;
+    return ret;
+}
+
+cycle_bounds_t cycle_analyzer_t::callee_bounds(locator_t loc)
+{
+    switch(loc.lclass())
+    {
+    case LOC_FN:
+        if(loc.data() == 0 && loc.offset() == 0)
+            return fn_bounds(loc.fn());
+        break;
+    case LOC_RUNTIME_ROM:
+        if(loc.offset() == 0)
+            return runtime_bounds(loc.runtime_rom());
+        break;
+    default:
+        break;
+    }
+
+    return UNKNOWN_BOUNDS;
+}
+
+cycle_bounds_t cycle_analyzer_t::analyze(asm_proc_t const& asm_proc, placement_t const& placement)
+{
+    proc_graph_t graph(*this, asm_proc, placement);
+
+    unsigned entry = 0;
+    if(asm_proc.entry_label)
+        if(auto const* info = asm_proc.lookup_label(asm_proc.entry_label))
+            entry = info->index;
+
+    return graph.bounds_from(entry);
+}
+
+proc_graph_t::proc_graph_t(cycle_analyzer_t& analyzer, asm_proc_t const& asm_proc, placement_t const& placement)
+: m_fn(asm_proc.fn)
+{
+    // Linking modifies code in place, so indexes match 'asm_proc'.
+    // The unlinked version is used to identify labels and callees.
+    asm_proc_t linked = asm_proc;
+    linked.link(placement.romv, placement.bank);
+    assert(linked.code.size() == asm_proc.code.size());
+
+    unsigned const n = asm_proc.code.size();
+
+    m_addr.resize(n + 1);
+    unsigned addr = placement.addr;
+    for(unsigned i = 0; i < n; ++i)
+    {
+        m_addr[i] = addr;
+        addr += op_size(linked.code[i].op);
+    }
+    m_addr[n] = addr;
+
+    m_succ.resize(n + 1);
+    m_sub_call.resize(n + 1, -1);
+    m_loop_bound.resize(n + 1, 0);
+    m_memo.resize(n + 1);
+    m_in_progress.resize(n + 1);
+
+    if(m_fn)
+        for(auto const& pair : m_fn->loop_bounds())
+            if(auto const* info = asm_proc.lookup_label(pair.first))
+                m_loop_bound[info->index] = std::max(pair.second, 1u);
+
+    // Inline assembly can jump anywhere.
+    bool const iasm = m_fn && m_fn->iasm;
+
+    auto const label_index = [&](locator_t loc) -> int
+    {
+        if(!is_label(loc.lclass()))
+            return -1;
+        if(auto const* info = asm_proc.lookup_label(loc))
+            return info->index;
+        return -1;
+    };
+
+    for(unsigned i = 0; i < n; ++i)
+    {
+        asm_inst_t const& inst = linked.code[i];
+        locator_t const arg = asm_proc.code[i].arg;
+        std::vector<edge_t>& succ = m_succ[i];
+
+        unsigned const size = op_size(inst.op);
+        unsigned const next = i + 1;
+
+        if(size == 0)
+        {
+            succ.push_back({ next, {} });
+            continue;
+        }
+
+        if(inst.op == ASM_DATA)
+        {
+            // Executing data is likely a compiler bug; give up.
+            succ.push_back({ exit(), UNKNOWN_BOUNDS });
+            continue;
+        }
+
+        cycle_bounds_t cost = {};
+        for_each_expanded_inst(inst, [&](asm_inst_t const& expanded)
+        {
+            if(op_addr_mode(expanded.op) != MODE_RELATIVE && op_addr_mode(expanded.op) != MODE_LONG)
+                cost += inst_cycles(expanded);
+        });
+
+        auto const to_addr = [&](unsigned target_addr, cycle_bounds_t cost)
+        {
+            unsigned const target = index_at(target_addr);
+            if(target == exit())
+                cost = UNKNOWN_BOUNDS;
+            succ.push_back({ target, cost });
+        };
+
+        auto const to_label = [&](locator_t loc, cycle_bounds_t cost)
+        {
+            int const target = label_index(loc);
+            if(target < 0)
+                succ.push_back({ exit(), UNKNOWN_BOUNDS });
+            else
+                succ.push_back({ unsigned(target), cost });
+        };
+
+        switch(op_addr_mode(inst.op))
+        {
+        case MODE_RELATIVE:
+            {
+                // Not taken: 2 cycles. Taken: 3, plus 1 if the branch crosses a page.
+                cycle_bounds_t const not_taken = cost + cycle_bounds_t{ 2, 2 };
+                succ.push_back({ next, not_taken });
+
+                int const target = label_index(arg);
+                if(target < 0)
+                    succ.push_back({ exit(), UNKNOWN_BOUNDS });
+                else
+                {
+                    unsigned const taken = 3 + page_cross(m_addr[next], m_addr[target]);
+                    succ.push_back({ unsigned(target), cost + cycle_bounds_t{ taken, taken } });
+                }
+            }
+            continue;
+
+        case MODE_LONG:
+            {
+                // An inverted branch over a JMP:
+                unsigned const over = 3 + page_cross(m_addr[i] + 2, m_addr[i] + 5);
+                succ.push_back({ next, cost + cycle_bounds_t{ over, over } });
+                to_label(arg, cost + cycle_bounds_t{ 2 + 3, 2 + 3 });
+            }
+            continue;
+
+        default:
+            break;
+        }
+
+        switch(inst.op)
+        {
+        case RTS_IMPLIED:
+        case RTI_IMPLIED:
+            succ.push_back({ exit(), cost });
+            break;
+
+        case JMP_ABSOLUTE:
+            if(label_index(arg) >= 0)
+                to_label(arg, cost);
+            else // A tail call:
+                succ.push_back({ exit(), cost + analyzer.callee_bounds(arg) });
+            break;
+
+        case JMP_INDIRECT:
+            // Runtime code jumps indirectly to functions accounted for elsewhere.
+            succ.push_back({ exit(), (m_fn || iasm) ? UNKNOWN_BOUNDS : cost });
+            break;
+
+        case JSR_ABSOLUTE:
+            if(label_index(arg) >= 0)
+                m_sub_call[i] = label_index(arg);
+            else
+                cost += analyzer.callee_bounds(arg);
+            succ.push_back({ next, cost });
+            break;
+
+        case BANKED_Y_JSR:
+            cost += analyzer.runtime_bounds(RTROM_jsr_y_trampoline);
+            cost += analyzer.callee_bounds(arg);
+            succ.push_back({ next, cost });
+            break;
+
+        case BANKED_Y_JMP:
+            cost += analyzer.runtime_bounds(RTROM_jmp_y_trampoline);
+            cost += analyzer.callee_bounds(arg);
+            succ.push_back({ exit(), cost });
+            break;
+
+        case ASM_X_SWITCH:
+        case ASM_Y_SWITCH:
+            {
+                // The table holds the targets minus one, for RTS.
+                int const table = label_index(arg);
+                if(table < 0)
+                {
+                    succ.push_back({ exit(), UNKNOWN_BOUNDS });
+                    break;
+                }
+
+                for(unsigned j = table + 1; j < n && asm_proc.code[j].op != ASM_LABEL; ++j)
+                    if(asm_proc.code[j].op == ASM_DATA && !is_const(asm_proc.code[j].arg.lclass()))
+                        to_label(asm_proc.code[j].arg, cost);
+            }
+            break;
+
+        case SKB_IMPLIED:
+            to_addr(m_addr[i] + 2, cost);
+            break;
+
+        case IGN_IMPLIED:
+            to_addr(m_addr[i] + 3, cost);
+            break;
+
+        default:
+            // Falling off the end of the code exits.
+            succ.push_back({ next, cost });
+            break;
+        }
+    }
+}
+
+unsigned proc_graph_t::index_at(unsigned addr) const
+{
+    auto it = std::lower_bound(m_addr.begin(), m_addr.end() - 1, addr);
+    if(it == m_addr.end() - 1 || *it != addr)
+        return exit();
+    return it - m_addr.begin();
+}
+
+std::vector<unsigned> proc_graph_t::reachable(unsigned start) const
+{
+    std::vector<bool> seen(m_succ.size());
+    std::vector<unsigned> ret = { start };
+    seen[start] = true;
+
+    for(unsigned i = 0; i < ret.size(); ++i)
+    {
+        for(edge_t const& edge : m_succ[ret[i]])
+        {
+            if(!seen[edge.to])
+            {
+                seen[edge.to] = true;
+                ret.push_back(edge.to);
+            }
+        }
+    }
+
+    return ret;
+}
+
+void proc_graph_t::resolve_calls(std::vector<unsigned> const& nodes)
+{
+    for(unsigned node : nodes)
+    {
+        if(m_sub_call[node] < 0)
+            continue;
+
+        unsigned const sub = m_sub_call[node];
+        m_sub_call[node] = -1;
+
+        cycle_bounds_t const bounds = bounds_from(sub);
+        for(edge_t& edge : m_succ[node])
+            edge.cost += bounds;
+    }
+}
+
+cycle_bounds_t proc_graph_t::bounds_from(unsigned start)
+{
+    if(m_memo[start])
+        return *m_memo[start];
+
+    if(m_in_progress[start])
+        return UNKNOWN_BOUNDS;
+    m_in_progress[start] = true;
+
+    std::vector<unsigned> const nodes = reachable(start);
+    resolve_calls(nodes);
+
+    cycle_bounds_t const ret = { best_from(start), worst_from(start, nodes) };
+
+    m_in_progress[start] = false;
+    m_memo[start] = ret;
+    return ret;
+}
+
+// Dijkstra's algorithm.
+std::uint64_t proc_graph_t::best_from(unsigned start) const
+{
+    std::vector<std::uint64_t> dist(m_succ.size(), UNBOUNDED);
+    using pair_t = std::pair<std::uint64_t, unsigned>;
+    std::priority_queue<pair_t, std::vector<pair_t>, std::greater<pair_t>> queue;
+
+    dist[start] = 0;
+    queue.push({ 0, start });
+
+    while(!queue.empty())
+    {
+        auto const [d, node] = queue.top();
+        queue.pop();
+
+        if(d != dist[node])
+            continue;
+
+        if(node == exit())
+            return d;
+
+        for(edge_t const& edge : m_succ[node])
+        {
+            std::uint64_t const to_d = sat_add(d, edge.cost.best);
+            if(to_d < dist[edge.to])
+            {
+                dist[edge.to] = to_d;
+                queue.push({ to_d, edge.to });
+            }
+        }
+    }
+
+    return UNBOUNDED; // Never returns.
+}
+
+// Finds the longest path by collapsing natural loops into single nodes, innermost first.
+// Each loop needs a bound, which comes from the 'o_loop' header label inside it.
+std::uint64_t proc_graph_t::worst_from(unsigned start, std::vector<unsigned> const& nodes)
+{
+    unsigned const size = m_succ.size();
+
+    // Reverse postorder:
+    std::vector<unsigned> rpo;
+    std::vector<int> rpo_i(size, -1);
+    {
+        std::vector<bool> seen(size);
+        std::vector<std::pair<unsigned, unsigned>> stack = {{ start, 0 }};
+        seen[start] = true;
+
+        while(!stack.empty())
+        {
+            auto& [node, edge_i] = stack.back();
+            if(edge_i < m_succ[node].size())
+            {
+                unsigned const to = m_succ[node][edge_i++].to;
+                if(!seen[to])
+                {
+                    seen[to] = true;
+                    stack.push_back({ to, 0 });
+                }
+            }
+            else
+            {
+                rpo.push_back(node);
+                stack.pop_back();
+            }
+        }
+
+        std::reverse(rpo.begin(), rpo.end());
+        for(unsigned i = 0; i < rpo.size(); ++i)
+            rpo_i[rpo[i]] = i;
+    }
+
+    std::vector<std::vector<unsigned>> preds(size);
+    for(unsigned node : nodes)
+        for(edge_t const& edge : m_succ[node])
+            preds[edge.to].push_back(node);
+
+    // Dominators, using the Cooper-Harvey-Kennedy algorithm:
+    std::vector<int> idom(size, -1);
+    idom[start] = start;
+    for(bool changed = true; changed;)
+    {
+        changed = false;
+        for(unsigned node : rpo)
+        {
+            if(node == start)
+                continue;
+
+            int new_idom = -1;
+            for(unsigned pred : preds[node])
+            {
+                if(idom[pred] < 0)
+                    continue;
+                if(new_idom < 0)
+                {
+                    new_idom = pred;
+                    continue;
+                }
+
+                int a = pred, b = new_idom;
+                while(a != b)
+                {
+                    while(rpo_i[a] > rpo_i[b])
+                        a = idom[a];
+                    while(rpo_i[b] > rpo_i[a])
+                        b = idom[b];
+                }
+                new_idom = a;
+            }
+
+            if(new_idom != idom[node])
+            {
+                idom[node] = new_idom;
+                changed = true;
+            }
+        }
+    }
+
+    auto const dominates = [&](unsigned a, unsigned b)
+    {
+        while(b != a && b != start)
+            b = idom[b];
+        return b == a;
+    };
+
+    // Natural loops, keyed by header:
+    std::vector<std::vector<unsigned>> latches(size);
+    for(unsigned node : nodes)
+    {
+        for(edge_t const& edge : m_succ[node])
+        {
+            if(rpo_i[edge.to] > rpo_i[node])
+                continue;
+            if(!dominates(edge.to, node))
+                return UNBOUNDED; // Irreducible.
+            latches[edge.to].push_back(node);
+        }
+    }
+
+    struct loop_t
+    {
+        unsigned header;
+        std::vector<unsigned> body;
+    };
+
+    std::vector<loop_t> loops;
+    std::vector<unsigned> in_body(size, ~0u);
+    for(unsigned header : nodes)
+    {
+        if(latches[header].empty())
+            continue;
+
+        loop_t& loop = loops.emplace_back();
+        loop.header = header;
+        loop.body = { header };
+        in_body[header] = header;
+
+        std::vector<unsigned> stack = latches[header];
+        while(!stack.empty())
+        {
+            unsigned const node = stack.back();
+            stack.pop_back();
+            if(in_body[node] == header)
+                continue;
+            in_body[node] = header;
+            loop.body.push_back(node);
+            for(unsigned pred : preds[node])
+                stack.push_back(pred);
+        }
+    }
+
+    std::sort(loops.begin(), loops.end(), [](loop_t const& a, loop_t const& b)
+        { return a.body.size() < b.body.size(); });
+
+    // Collapsed loops are represented by their header:
+    std::vector<unsigned> rep(size);
+    for(unsigned i = 0; i < size; ++i)
+        rep[i] = i;
+    auto const find = [&](unsigned node) -> unsigned
+    {
+        while(rep[node] != node)
+            node = rep[node] = rep[rep[node]];
+        return node;
+    };
+
+    std::vector<std::vector<edge_t>> edges(size);
+    for(unsigned node : nodes)
+        edges[node] = m_succ[node];
+
+    std::vector<unsigned> loop_bound = m_loop_bound;
+    std::vector<unsigned> in_set(size, ~0u);
+    std::vector<unsigned> indegree(size);
+    std::vector<std::uint64_t> dist(size);
+
+    // Longest paths from 'root' across the DAG formed by 'set'.
+    // Edges back to 'root' are passed to 'on_latch', and edges leaving 'set' to 'on_exit'.
+    auto const longest = [&](unsigned root, std::vector<unsigned> const& set, unsigned id,
+                             auto const& on_latch, auto const& on_exit) -> bool
+    {
+        for(unsigned node : set)
+        {
+            in_set[node] = id;
+            indegree[node] = 0;
+            dist[node] = 0;
+        }
+
+        for(unsigned node : set)
+        for(edge_t const& edge : edges[node])
+        {
+            unsigned const to = find(edge.to);
+            if(to != root && in_set[to] == id)
+                ++indegree[to];
+        }
+
+        std::vector<unsigned> ready = { root };
+        unsigned processed = 0;
+        while(!ready.empty())
+        {
+            unsigned const node = ready.back();
+            ready.pop_back();
+            ++processed;
+
+            for(edge_t const& edge : edges[node])
+            {
+                unsigned const to = find(edge.to);
+                std::uint64_t const d = sat_add(dist[node], edge.cost.worst);
+
+                if(to == root)
+                    on_latch(d);
+                else if(in_set[to] == id)
+                {
+                    dist[to] = std::max(dist[to], d);
+                    if(--indegree[to] == 0)
+                        ready.push_back(to);
+                }
+                else
+                    on_exit(edge.to, d);
+            }
+        }
+
+        return processed == set.size();
+    };
+
+    unsigned id = 0;
+    std::vector<unsigned> set;
+    for(loop_t const& loop : loops)
+    {
+        // The bound comes from the one loop header label inside:
+        unsigned bound = 0;
+        unsigned found = 0;
+        for(unsigned node : loop.body)
+        {
+            if(loop_bound[node])
+            {
+                bound = loop_bound[node];
+                loop_bound[node] = 0;
+                ++found;
+            }
+        }
+
+        if(found != 1)
+            return UNBOUNDED;
+
+        set.clear();
+        for(unsigned node : loop.body)
+            if(find(node) == node)
+                set.push_back(node);
+
+        std::uint64_t iter = 0;
+        std::vector<edge_t> exits;
+        bool const ok = longest(loop.header, set, id++,
+            [&](std::uint64_t d) { iter = std::max(iter, d); },
+            [&](unsigned to, std::uint64_t d) { exits.push_back({ to, { 0, d } }); });
+
+        if(!ok)
+            return UNBOUNDED;
+
+        std::uint64_t const loop_cost = sat_mul(bound, iter);
+        for(edge_t& edge : exits)
+            edge.cost.worst = sat_add(loop_cost, edge.cost.worst);
+
+        for(unsigned node : set)
+        {
+            rep[node] = loop.header;
+            if(node != loop.header)
+                edges[node].clear();
+        }
+        edges[loop.header] = std::move(exits);
+    }
+
+    // With every loop collapsed, what remains is a DAG:
+    set.clear();
+    for(unsigned node : nodes)
+        if(find(node) == node)
+            set.push_back(node);
+
+    bool const ok = longest(find(start), set, id++, [](std::uint64_t){}, [](unsigned, std::uint64_t){});
+    if(!ok || in_set[exit()] != id - 1)
+        return UNBOUNDED;
+
+    return dist[exit()];
+}
+
+void check_cycles(std::ostream* info)
+{
+    cycle_analyzer_t analyzer;
+
+    if(unsigned const budget = compiler_options().vblank_budget)
+    {
+        for(fn_t* nmi : global_t::nmis())
+        {
+            cycle_bounds_t const bounds = cycle_bounds_t{ INTERRUPT_CYCLES, INTERRUPT_CYCLES }
+                + analyzer.runtime_bounds(RTROM_nmi)
+                + analyzer.fn_bounds(nmi->handle());
+
+            if(bounds.worst == UNBOUNDED)
+                compiler_warning(nmi->global.pstring(), fmt(
+                    "Unable to bound the cycles of nmi. It may exceed the vblank budget of % cycles.", budget));
+            else if(bounds.worst > budget)
+                compiler_warning(nmi->global.pstring(), fmt(
+                    "nmi can take up to % cycles, exceeding the vblank budget of % cycles.", bounds.worst, budget));
+        }
+    }
+
+    if(!info)
+        return;
+
+    auto const to_str = [](std::uint64_t cycles) -> std::string
+    {
+        return cycles == UNBOUNDED ? "-" : std::to_string(cycles);
+    };
+
+    *info << "Cycles (best, worst) per call, including callees. '-' is unbounded.\n\n";
+
+    for(fn_t const& fn : fn_ht::values())
+    {
+        if(!analyzer.placed(fn.rom_proc()))
+            continue;
+
+        cycle_bounds_t const bounds = analyzer.fn_bounds(fn.handle());
+        *info << fn.global.name << ": " << to_str(bounds.best) << ", " << to_str(bounds.worst) << '\n';
+    }
+}
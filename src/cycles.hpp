@@ -0,0 +1,27 @@
+#ifndef CYCLES_HPP
+#define CYCLES_HPP
+
+// Static analysis of how many cycles each function can take,
+// using the final, linked code.
+//
+// The bounds of a function include the functions it calls,
+// branch and page-crossing penalties, and loops bounded by 'o_loop'.
+// Loops without a known bound make the worst case unbounded.
+
+#include <cstdint>
+#include <ostream>
+
+struct cycle_bounds_t
+{
+    static constexpr std::uint64_t UNBOUNDED = ~std::uint64_t(0);
+
+    std::uint64_t best = 0;
+    std::uint64_t worst = 0;
+};
+
+// Call after 'write_rom'.
+// Warns when an 'nmi' can exceed 'compiler_options().vblank_budget',
+// and writes a report of every function to 'info', if not null.
+void check_cycles(std::ostream* info);
+
+#endif
@@ -0,0 +1,389 @@
+#include "emulate.hpp"
+
+#include <algorithm>
+#include <array>
+#include <iomanip>
+#include <map>
+#include <string>
+
+#include "format.hpp"
+#include "globals.hpp"
+#include "group.hpp"
+#include "mapper.hpp"
+#include "options.hpp"
+#include "pgo.hpp"
+#include "rom.hpp"
+#include "runtime.hpp"
+
+// Included last, as it defines many short macros.
+#include "cpu_2a03.hpp"
+
+namespace
+{
+    // The parts of the NES that the CPU can see.
+    struct nes_bus_t
+    {
+        nes_bus_t(std::uint8_t const* prg, unsigned num_banks)
+        : prg(prg)
+        , num_banks(num_banks)
+        {}
+
+        std::uint8_t const* prg;
+        unsigned num_banks;
+        unsigned bank = 0;
+
+        std::array<std::uint8_t, 0x800> ram = {};
+        std::array<std::uint8_t, 0x2000> prg_ram = {};
+
+        std::uint8_t ppu_ctrl = 0;
+        bool vblank = false;
+        unsigned stall = 0; // Cycles the CPU is halted for, by OAM DMA.
+
+        unsigned prg_offset(unsigned address) const
+            { return (bank % num_banks) * 0x8000 + (address & 0x7FFF); }
+
+        unsigned char mem_rd(unsigned address)
+        {
+            if(address < 0x2000)
+                return ram[address & 0x7FF];
+
+            if(address < 0x4000)
+            {
+                // PPUSTATUS. Only the vblank flag is modeled.
+                if((address & 7) == 2)
+                {
+                    unsigned char const status = vblank ? 0x80 : 0x00;
+                    vblank = false;
+                    return status;
+                }
+                return 0;
+            }
+
+            if(address >= 0x8000)
+                return prg[prg_offset(address)];
+
+            if(address >= 0x6000)
+                return prg_ram[address - 0x6000];
+
+            return 0;
+        }
+
+        void mem_wr(unsigned address, unsigned char data)
+        {
+            if(address < 0x2000)
+                ram[address & 0x7FF] = data;
+            else if(address < 0x4000)
+            {
+                if((address & 7) == 0)
+                    ppu_ctrl = data;
+            }
+            else if(address == 0x4014)
+                stall += 513;
+            else if(address >= 0x6000 && address < 0x8000)
+                prg_ram[address - 0x6000] = data;
+
+            // Bankswitching:
+            mapper_type_t const mt = mapper().type;
+            if(address >= 0x8000)
+            {
+                if(has_bus_conflicts(mt))
+                    data &= prg[prg_offset(address)];
+
+                switch(mt)
+                {
+                case MAPPER_ANROM: bank = data & 0b111; break;
+                case MAPPER_BNROM: bank = data; break;
+                case MAPPER_GNROM: bank = (data >> 4) & 0b11; break;
+                default: break;
+                }
+            }
+            else if(mt == MAPPER_GTROM && ((address & 0xF000) == 0x5000 || (address & 0xF000) == 0x7000))
+                bank = data & 0b1111;
+        }
+    };
+
+    // Maps each byte of PRG ROM to the function occupying it,
+    // using the placements made by 'alloc_rom'.
+    class rom_owners_t
+    {
+    public:
+        static constexpr unsigned OTHER = 0;
+        static constexpr unsigned RAM = 1;
+
+        explicit rom_owners_t(unsigned num_banks)
+        : m_owners(num_banks * 0x8000, OTHER)
+        {
+            for(unsigned i = 0; i < NUM_RTROM; ++i)
+            {
+                runtime_rom_name_t const name = runtime_rom_name_t(i);
+                unsigned const id = intern(fmt("(runtime %)", to_string(name)));
+
+                for(unsigned romv = 0; romv < NUM_ROMV; ++romv)
+                    for(unsigned bank = 0; bank < num_banks; ++bank)
+                        own(rtrom_spans()[name][romv], bank, id);
+            }
+
+            auto const own_alloc = [&](auto const& alloc)
+            {
+                alloc.data.visit([](rom_array_ht){}, [&](rom_proc_ht rom_proc)
+                {
+                    unsigned const id = intern(proc_name(rom_proc));
+                    alloc.for_each_bank([&](unsigned bank){ own(alloc.span, bank, id); });
+                });
+            };
+
+            for(rom_once_t const& once : rom_once_ht::values())
+                own_alloc(once);
+            for(rom_many_t const& many : rom_many_ht::values())
+                own_alloc(many);
+        }
+
+        unsigned owner(unsigned address, nes_bus_t const& bus) const
+        {
+            if(address < 0x2000)
+                return RAM;
+            if(address < 0x8000)
+                return OTHER;
+            return m_owners[bus.prg_offset(address)];
+        }
+
+        std::vector<std::string> const& names() const { return m_names; }
+
+        unsigned id(std::string const& name) const
+        {
+            auto it = m_ids.find(name);
+            return it == m_ids.end() ? OTHER : it->second;
+        }
+
+    private:
+        unsigned intern(std::string const& name)
+        {
+            auto result = m_ids.emplace(name, m_names.size());
+            if(result.second)
+                m_names.push_back(name);
+            return result.first->second;
+        }
+
+        void own(span_t span, unsigned bank, unsigned id)
+        {
+            if(!span || span.addr < 0x8000)
+                return;
+            std::size_t const begin = bank * 0x8000 + span.addr - 0x8000;
+            std::size_t const end = std::min<std::size_t>(begin + span.size, m_owners.size());
+            for(std::size_t i = begin; i < end; ++i)
+                m_owners[i] = id;
+        }
+
+        static std::string proc_name(rom_proc_ht rom_proc)
+        {
+            if(fn_ht fn = rom_proc->asm_proc().fn)
+                return fn->global.name;
+
+            if(rom_proc == reset_proc)
+                return "(reset)";
+
+            for(group_vars_t const& gv : group_vars_ht::values())
+                if(gv.init_proc() == rom_proc)
+                    return fmt("(init %)", gv.group.name);
+
+            return "(anonymous)";
+        }
+
+        std::vector<std::uint16_t> m_owners;
+        std::vector<std::string> m_names = { "(other)", "(ram)" };
+        std::map<std::string, unsigned> m_ids = {{ "(other)", OTHER }, { "(ram)", RAM }};
+    };
+
+    // PPU timing, in fifths of a PPU dot to keep PAL's 3.2 dots per cycle integral.
+    struct frame_timing_t
+    {
+        unsigned units_per_cycle;
+        unsigned frame_units;
+        unsigned vblank_start_units;
+        unsigned vblank_units;
+    };
+
+    frame_timing_t frame_timing(nes_system_t system)
+    {
+        constexpr unsigned line = 341 * 5;
+        switch(system)
+        {
+        case NES_SYSTEM_PAL:   return { 16, 312 * line, 241 * line, 70 * line };
+        case NES_SYSTEM_DENDY: return { 15, 312 * line, 291 * line, 20 * line };
+        default:               return { 15, 262 * line, 241 * line, 20 * line };
+        }
+    }
+
+    // Converts how often each byte of PRG ROM was executed into a profile for '--profile-use'.
+    pgo_writer_t build_profile(std::vector<std::uint32_t> const& hits, unsigned frames,
+                               rom_owners_t const& owners, std::vector<std::uint64_t> const& cycles)
+    {
+        pgo_writer_t profile;
+        profile.frames = frames;
+
+        // Scratch pad proc, as procs have to be linked to get accurate offsets.
+        asm_proc_t asm_proc;
+        rh::batman_map<unsigned, unsigned> preorder_i;
+
+        auto const add_alloc = [&](auto const& alloc)
+        {
+            alloc.data.visit([](rom_array_ht){}, [&](rom_proc_ht rom_proc)
+            {
+                fn_ht const fn = rom_proc->asm_proc().fn;
+                if(!fn || alloc.span.addr < 0x8000)
+                    return;
+
+                pgo_fn_t& pgo_fn = profile.fns[fn->global.name];
+                pgo_fn.cycles = cycles[owners.id(fn->global.name)];
+                pgo_fn.nodes = fn->cfg_preorder().size();
+
+                preorder_i.clear();
+                for(unsigned i = 0; i < fn->cfg_preorder().size(); ++i)
+                    preorder_i.insert({ fn->cfg_preorder()[i], i });
+
+                asm_proc = rom_proc->asm_proc();
+                asm_proc.link(alloc.romv, alloc.only_bank());
+
+                alloc.for_each_bank([&](unsigned bank)
+                {
+                    std::size_t const start = bank * 0x8000 + alloc.span.addr - 0x8000;
+
+                    unsigned offset = 0;
+                    for(asm_inst_t const& inst : asm_proc.code)
+                    {
+                        if(inst.op == ASM_LABEL && start + offset < hits.size())
+                        {
+                            std::uint32_t const count = hits[start + offset];
+
+                            if(inst.arg == asm_proc.entry_label)
+                                pgo_fn.calls += count;
+
+                            if(inst.arg.lclass() == LOC_CFG_LABEL && inst.arg.data() == 0)
+                                if(unsigned const* i = preorder_i.mapped(inst.arg.handle()))
+                                    pgo_fn.labels[*i] += count;
+                        }
+
+                        offset += op_size(inst.op);
+                    }
+                });
+            });
+        };
+
+        for(rom_once_t const& once : rom_once_ht::values())
+            add_alloc(once);
+        for(rom_many_t const& many : rom_many_ht::values())
+            add_alloc(many);
+
+        return profile;
+    }
+}
+
+void run_frames(std::vector<std::uint8_t> const& rom, unsigned frames, std::ostream& o)
+{
+    unsigned const num_banks = mapper().num_32k_banks;
+    assert(rom.size() >= mapper().ines_header_size() + num_banks * 0x8000);
+
+    rom_owners_t const owners(num_banks);
+    std::size_t const num_owners = owners.names().size();
+
+    nes_bus_t bus(rom.data() + mapper().ines_header_size(), num_banks);
+    cpu_2a03_t<nes_bus_t> cpu(bus);
+    cpu.reset();
+
+    frame_timing_t const timing = frame_timing(compiler_options().nes_system);
+    std::uint64_t now = 0;
+    std::uint64_t vblank_start = timing.vblank_start_units;
+    std::uint64_t vblank_end = 0;
+
+    std::vector<std::uint64_t> total_cycles(num_owners, 0);
+    std::vector<std::uint64_t> frame_cycles(num_owners, 0);
+    std::vector<std::uint64_t> max_frame_cycles(num_owners, 0);
+    std::uint64_t cycles = 0;
+    unsigned nmis = 0;
+
+    // How often each byte of PRG ROM began an instruction, for '--profile-generate'.
+    std::vector<std::uint32_t> hits;
+    if(!compiler_options().profile_generate.empty())
+        hits.resize(num_banks * 0x8000, 0);
+
+    unsigned frame = 0;
+    while(frame < frames && !cpu.CPU.jam)
+    {
+        unsigned const owner = owners.owner(cpu.CPU.PC.hl, bus);
+        if(!hits.empty() && cpu.CPU.PC.hl >= 0x8000)
+            hits[bus.prg_offset(cpu.CPU.PC.hl)] += 1;
+        unsigned const taken = cpu.tick() + bus.stall;
+        bus.stall = 0;
+
+        frame_cycles[owner] += taken;
+        cycles += taken;
+        now += taken * timing.units_per_cycle;
+
+        if(bus.vblank && now >= vblank_end)
+            bus.vblank = false;
+
+        if(now >= vblank_start)
+        {
+            ++frame;
+            for(unsigned i = 0; i < num_owners; ++i)
+            {
+                total_cycles[i] += frame_cycles[i];
+                max_frame_cycles[i] = std::max(max_frame_cycles[i], frame_cycles[i]);
+                frame_cycles[i] = 0;
+            }
+
+            bus.vblank = true;
+            vblank_end = vblank_start + timing.vblank_units;
+            vblank_start += timing.frame_units;
+
+            if(bus.ppu_ctrl & 0x80)
+            {
+                unsigned const taken = cpu.nmi();
+                frame_cycles[owners.owner(cpu.CPU.PC.hl, bus)] += taken;
+                cycles += taken;
+                now += taken * timing.units_per_cycle;
+                ++nmis;
+            }
+        }
+    }
+
+    for(unsigned i = 0; i < num_owners; ++i)
+    {
+        total_cycles[i] += frame_cycles[i];
+        max_frame_cycles[i] = std::max(max_frame_cycles[i], frame_cycles[i]);
+    }
+
+    if(!hits.empty())
+        build_profile(hits, frame, owners, total_cycles).write(compiler_options().profile_generate);
+
+    o << "RUN: " << frame << " frames, " << cycles << " cycles, " << nmis << " NMIs\n";
+    if(cpu.CPU.jam)
+        o << fmt("CPU jammed at $%.\n", to_hex_string(cpu.CPU.PC.hl));
+    o << '\n';
+
+    std::vector<unsigned> order;
+    for(unsigned i = 0; i < num_owners; ++i)
+        if(total_cycles[i])
+            order.push_back(i);
+    std::sort(order.begin(), order.end(), [&](unsigned a, unsigned b)
+    {
+        if(total_cycles[a] != total_cycles[b])
+            return total_cycles[a] > total_cycles[b];
+        return owners.names()[a] < owners.names()[b];
+    });
+
+    o << std::setw(12) << "cycles"
+      << std::setw(12) << "per frame"
+      << std::setw(12) << "max frame"
+      << std::setw(8) << "%"
+      << "  function\n";
+
+    for(unsigned i : order)
+    {
+        o << std::setw(12) << total_cycles[i]
+          << std::setw(12) << (frame ? total_cycles[i] / frame : 0)
+          << std::setw(12) << max_frame_cycles[i]
+          << std::setw(8) << std::fixed << std::setprecision(2) << (100.0 * total_cycles[i] / cycles)
+          << "  " << owners.names()[i] << '\n';
+    }
+}
@@ -0,0 +1,18 @@
+#ifndef EMULATE_HPP
+#define EMULATE_HPP
+
+// Runs a linked ROM on an emulated 2A03 for '--run-frames',
+// measuring how many cycles each function actually takes.
+//
+// Only the CPU and the mapper's PRG banking are emulated.
+// The PPU is reduced to its vblank flag and NMI.
+
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+// Runs 'rom' (as created by 'write_rom') for 'frames' frames,
+// then prints the cycles spent in each function to 'o'.
+void run_frames(std::vector<std::uint8_t> const& rom, unsigned frames, std::ostream& o);
+
+#endif
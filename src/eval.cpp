@@ -27,6 +27,7 @@
 #include "rom_decl.hpp"
 #include "runtime.hpp"
 #include "thread.hpp"
+#include "ct_memo.hpp"
 
 namespace sc = std::chrono;
 namespace bc = boost::container;
@@ -84,6 +85,10 @@ private:
     using clock = sc::steady_clock;
     sc::time_point<clock> start_time;
 
+    // Reading the clock is slow, so the interpreter only does it every so often.
+    static constexpr unsigned TIME_CHECK_INTERVAL = 256;
+    unsigned time_check_countdown = TIME_CHECK_INTERVAL;
+
     struct logical_data_t
     {
         cfg_ht branch_node;
@@ -204,9 +209,17 @@ public:
 
     void check_time();
 
+    // Interprets a call to 'call', memoizing pure calls.
+    rval_t interpret_call(pstring_t call_pstring, fn_t& call, rval_t const* args, unsigned num_args);
+
     template<do_t D>
     void interpret_stmts();
 
+    // Compile-time bytecode (see 'ct_bytecode.hpp'):
+    class ct_lowering_t;
+    std::unique_ptr<ct_bytecode_t> lower_ct_bytecode();
+    bool run_ct_bytecode(ct_bytecode_t const& bc);
+
     void compile_block();
 
     template<do_t D>
@@ -485,6 +498,12 @@ eval_t::eval_t(do_wrapper_t<D>, pstring_t pstring, fn_t& fn_ref,
         }
     }
 
+    // Prefer running bytecode, falling back to the AST when that fails.
+    if(D == INTERPRET)
+        if(ct_bytecode_t const* bc = fn->ct_bytecode([this]{ return lower_ct_bytecode(); }))
+            if(run_ct_bytecode(*bc))
+                return;
+
     interpret_stmts<D>();
 }
 
@@ -783,233 +802,1489 @@ void eval_t::check_time()
             throw out_of_time_t(
                 fmt_error(this->pstring, "Ran out of time executing expression.")
                 + fmt_note("Computation is likely divergent.\n")
-                + fmt_note(fmt("Use compiler flag --timelimit 0 to ignore this error.\n", compiler_options().time_limit)));
+                + fmt_note(fmt("Use compiler flag --time-limit 0 to ignore this error.\n", compiler_options().time_limit)));
+        }
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+template<eval_t::do_t D>
+expr_value_t eval_t::do_var_init_expr(var_ht var_i, ast_node_t const& expr)
+{
+    expr_value_t v = do_expr<D>(expr);
+
+    if(can_size_unsized_array(v.type, var_type(var_i)))
+        var_type(var_i).set_array_length(v.type.array_length(), v.pstring);
+
+    return throwing_cast<D>(std::move(v), var_type(var_i), true);
+}
+
+template<eval_t::do_t D>
+void eval_t::interpret_stmts()
+{
+    static_assert(D != COMPILE);
+
+    auto const do_condition = [&](bool check_value) -> bool
+    { 
+        expr_value_t v = throwing_cast<D>(do_expr<D>(*stmt->expr), TYPE_BOOL, true);
+        if(!is_interpret(D))
+            return check_value;
+        return v.fixed().value;
+    };
+
+    while(true)
+    {
+        if(--time_check_countdown == 0)
+        {
+            time_check_countdown = TIME_CHECK_INTERVAL;
+            check_time();
+        }
+
+        switch(stmt->name)
+        {
+        default: // Handles var inits
+            if(is_var_init(stmt->name))
+            {
+                if(D == INTERPRET_CE)
+                    compiler_error(stmt->pstring, "Expression cannot be evaluated at compile-time.");
+
+                unsigned const local_i = ::get_local_i(stmt->name);
+                var_ht const var_i = to_var_i(local_i);
+
+                // Prepare the type.
+                if(var_type(var_i).name() == TYPE_VOID)
+                    var_type(var_i) = dethunkify(fn->def().local_vars[local_i].decl.src_type, true, this);
+
+                if(stmt->expr)
+                {
+                    expr_value_t v = do_var_init_expr<D>(var_i, *stmt->expr);
+
+                    if(is_interpret(D))
+                        interpret_locals[local_i] = std::move(v.rval());
+                }
+                else if(is_interpret(D))
+                {
+                    type_t const type = var_type(var_i);
+                    unsigned const num = num_members(type);
+                    assert(num > 0);
+
+                    rval_t rval;
+                    rval.reserve(num);
+
+                    for(unsigned i = 0; i < num; ++i)
+                    {
+                        type_t const mt = member_type(type, i);
+                        if(mt.name() == TYPE_TEA)
+                            rval.emplace_back(make_ct_array(mt.array_length()));
+                        else
+                            rval.emplace_back();
+                    }
+
+                    interpret_locals[local_i] = std::move(rval);
+                }
+
+                ++stmt;
+            }
+            else
+                compiler_error(stmt->pstring, fmt("Statement % cannot appear in constant evaluation.", to_string(stmt->name)));
+            break;
+
+        case STMT_GOTO_MODE:
+            if(!is_check(D))
+                compiler_error(stmt->pstring, "Statement cannot appear in constant evaluation.");
+            // fall-through
+        case STMT_EXPR:
+        case STMT_FOR_EFFECT:
+            if(stmt->expr)
+                do_expr<D>(*stmt->expr);
+            ++stmt;
+            break;
+
+        case STMT_DO_WHILE:
+        case STMT_DO_FOR:
+        case STMT_END_IF:
+        case STMT_LABEL:
+        case STMT_END_SWITCH:
+        case STMT_CASE:
+        case STMT_DEFAULT:
+            ++stmt;
+            break;
+
+        case STMT_ELSE:
+        case STMT_END_WHILE:
+        case STMT_END_FOR:
+        case STMT_BREAK:
+        case STMT_CONTINUE:
+        case STMT_GOTO:
+            if(is_interpret(D))
+                stmt = &fn->def()[stmt->link];
+            else
+                ++stmt;
+            break;
+
+        case STMT_IF:
+            if(do_condition(true))
+                ++stmt;
+            else
+            {
+                stmt = &fn->def()[stmt->link];
+                if(stmt->name == STMT_ELSE)
+                    ++stmt;
+            }
+            break;
+
+        case STMT_WHILE:
+        case STMT_FOR:
+            if(do_condition(true))
+                ++stmt;
+            else
+                stmt = &fn->def()[stmt->link];
+            break;
+
+        case STMT_END_DO_WHILE:
+        case STMT_END_DO_FOR:
+            if(do_condition(false))
+                stmt = &fn->def()[stmt->link];
+            else
+                ++stmt;
+            break;
+
+        case STMT_SWITCH:
+            {
+                expr_value_t switch_expr = do_expr<D>(*stmt->expr);
+                switch_expr = throwing_cast<D>(std::move(switch_expr), is_signed(switch_expr.type.name()) ? TYPE_S : TYPE_U, true);
+
+                if(!is_interpret(D))
+                    ++stmt;
+                else while(true)
+                {
+                    assert(stmt->link);
+                    stmt = &fn->def()[stmt->link];
+
+                    if(stmt->name == STMT_CASE)
+                    {
+                        expr_value_t case_expr = throwing_cast<D>(do_expr<D>(*stmt->expr), switch_expr.type, true);
+
+                        if(switch_expr.fixed() == case_expr.fixed())
+                        {
+                            ++stmt;
+                            break;
+                        }
+                    }
+                    else if(stmt->name == STMT_DEFAULT)
+                    {
+                        ++stmt;
+                        break;
+                    }
+                    else
+                        assert(false);
+                }
+            }
+
+            break;
+
+        case STMT_RETURN:
+            {
+                type_t const return_type = fn->type().return_type();
+                if(stmt->expr)
+                {
+                    expr_value_t v = throwing_cast<D>(do_expr<D>(*stmt->expr), return_type, true);
+                    if(is_interpret(D))
+                        final_result.value = std::move(v.rval());
+                    final_result.type = std::move(v.type);
+                }
+                else if(return_type.name() != TYPE_VOID)
+                {
+                    compiler_error(stmt->pstring, fmt(
+                        "Expecting return expression of type %.", return_type));
+                }
+            }
+            if(!is_check(D))
+                return;
+            ++stmt;
+            break;
+
+        case STMT_END_FN:
+            if(!is_check(D) && !fn->iasm)
+            {
+                type_t return_type = fn->type().return_type();
+                if(return_type.name() != TYPE_VOID)
+                {
+                    compiler_error(stmt->pstring, fmt(
+                        "Interpreter reached end of function without returning %.", return_type));
+                }
+            }
+            return;
+
+        case STMT_NMI:
+            if(!is_check(D))
+                compiler_error(stmt->pstring, "Cannot wait for nmi at compile-time.");
+            if(precheck_tracked)
+                precheck_tracked->wait_nmis.push_back(stmt_pstring_mods());
+            ++stmt;
+            break;
+
+        case STMT_FENCE:
+            if(precheck_tracked)
+                precheck_tracked->fences.push_back(stmt_pstring_mods());
+            ++stmt;
+            break;
         }
     }
+    assert(false);
+}
+
+rval_t eval_t::interpret_call(pstring_t call_pstring, fn_t& call, rval_t const* args, unsigned num_args)
+{
+    ct_memo_key_t key;
+    bool const memoize = ct_memo_t::memoizable(call) && ct_memo_t::key(call, args, num_args, key);
+
+    rval_t result;
+    if(memoize && ct_memo_t::lookup(key, result))
+        return result;
+
+    try
+    {
+        // NOTE: call as INTERPRET, not D.
+        eval_t sub(do_wrapper_t<INTERPRET>{}, call_pstring, call, nullptr, args, num_args,
+                   call.def().local_consts.data());
+        result = std::move(sub.final_result.value);
+    }
+    catch(out_of_time_t& e)
+    {
+        e.msg += fmt_note(this->pstring, "Backtrace:");
+        throw;
+    }
+
+    if(memoize)
+        ct_memo_t::store(std::move(key), result);
+
+    return result;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Compile-time bytecode //////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+
+namespace
+{
+    // Thrown when a fn uses something the bytecode doesn't implement.
+    struct ct_unsupported_t {};
+
+    bool is_ct_scalar(type_t type) 
+    { 
+        return is_arithmetic(type.name()); 
+    }
+
+    bool is_ct_array(type_t type) 
+    { 
+        return type.name() == TYPE_TEA && type.array_length() > 0 && is_ct_scalar(type.elem_type()); 
+    }
+
+    // Cast ops can apply to the value under the top of the stack.
+    constexpr std::uint32_t CT_CAST_IMPLICIT = 1 << 0;
+    constexpr std::uint32_t CT_CAST_UNDER = 1 << 1;
 }
 
-///////////////////////////////////////////////////////////////////////////////
+class eval_t::ct_lowering_t
+{
+public:
+    explicit ct_lowering_t(eval_t& eval)
+    : eval(eval)
+    , def(eval.fn->def())
+    {}
+
+    std::unique_ptr<ct_bytecode_t> lower();
+
+private:
+    eval_t& eval;
+    fn_def_t const& def;
+    ct_bytecode_t bc;
+    int depth = 0;
+    int array_depth = 0;
+
+    // Jumps to statements, to be patched once every statement is lowered.
+    std::vector<std::pair<unsigned, stmt_ht>> stmt_jumps;
+
+    [[noreturn]] static void unsupported() { throw ct_unsupported_t{}; }
+
+    unsigned emit(ct_inst_t inst, int delta = 0, int array_delta = 0)
+    {
+        depth += delta;
+        array_depth += array_delta;
+        bc.max_stack = std::max<int>(bc.max_stack, depth);
+        bc.max_array_stack = std::max<int>(bc.max_array_stack, array_depth);
+        bc.code.push_back(inst);
+        return bc.code.size() - 1;
+    }
+
+    void emit_push(fixed_uint_t imm)
+    {
+        bc.imms.push_back(imm);
+        emit({ .op = CT_PUSH, .arg = unsigned(bc.imms.size() - 1) }, 1);
+    }
+
+    void emit_stmt_jump(ct_op_t op, stmt_ht to)
+    {
+        stmt_jumps.emplace_back(emit({ .op = op }, op == CT_JUMP ? 0 : -1), to);
+    }
+
+    void emit_drop(type_t type)
+    {
+        if(is_ct_scalar(type))
+            emit({ .op = CT_DROP }, -1);
+        else if(is_ct_array(type))
+            emit({ .op = CT_DROP_ARRAY }, 0, -1);
+        else if(type.name() != TYPE_VOID)
+            unsupported();
+    }
+
+    type_t local_type(unsigned local_i) const 
+    { 
+        return eval.var_type(eval.to_var_i(local_i)); 
+    }
+
+    type_t dethunkify(pstring_t pstring, type_t const* type)
+    {
+        return ::dethunkify({ pstring, *type }, true, &eval);
+    }
+
+    void req_quantity(type_t type) const 
+    {
+        if(!is_quantity(type.name()))
+            unsupported();
+    }
+
+    void req_quantity(type_t lhs, type_t rhs) const 
+    { 
+        req_quantity(lhs);
+        req_quantity(rhs); 
+    }
+
+    void cast(type_t from, type_t to, bool implicit, bool under = false);
+    rval_t const* const_rval(ast_node_t const& ast, type_t& type) const;
+    unsigned add_const_array(rval_t const& rval, type_t type);
+    type_t push_const(rval_t const& rval, type_t type);
+    type_t lower_expr(ast_node_t const& ast);
+    type_t lower_infix(ast_node_t const& ast, bool flipped = false);
+    type_t lower_arith(type_t lhs, type_t rhs, ct_op_t op);
+    type_t lower_mul(type_t lhs, type_t rhs);
+    type_t lower_shift(type_t lhs, type_t rhs, ct_op_t op);
+    type_t lower_compare(ast_node_t const& ast, ct_op_t op, bool flipped);
+    void lower_effect(ast_node_t const& ast);
+    void lower_stmt(stmt_t const& stmt);
+};
+
+std::unique_ptr<ct_bytecode_t> eval_t::lower_ct_bytecode()
+{
+    assert(fn);
+    ct_lowering_t lowering(*this);
+    return lowering.lower();
+}
+
+std::unique_ptr<ct_bytecode_t> eval_t::ct_lowering_t::lower()
+{
+    if(eval.fn->iasm)
+        return nullptr;
+
+    try
+    {
+        type_t const return_type = eval.fn->type().return_type();
+        if(return_type.name() != TYPE_VOID && !is_ct_scalar(return_type) && !is_ct_array(return_type))
+            unsupported();
+
+        unsigned const num_locals = def.local_vars.size();
+        bc.local_lengths.resize(num_locals);
+        for(unsigned i = 0; i < num_locals; ++i)
+        {
+            type_t const type = local_type(i);
+            if(is_ct_array(type))
+                bc.local_lengths[i] = type.array_length();
+            else if(!is_ct_scalar(type))
+                unsupported();
+        }
+
+        std::vector<unsigned> stmt_pcs(def.stmts.size());
+        for(unsigned i = 0; i < def.stmts.size(); ++i)
+        {
+            stmt_pcs[i] = bc.code.size();
+            lower_stmt(def.stmts[i]);
+            assert(depth == 0 && array_depth == 0);
+        }
+
+        for(auto const& pair : stmt_jumps)
+            bc.code[pair.first].arg = stmt_pcs[pair.second.id];
+    }
+    catch(...)
+    {
+        // Errors are left for the AST interpreter to report.
+        return nullptr;
+    }
+
+    return std::make_unique<ct_bytecode_t>(std::move(bc));
+}
+
+void eval_t::ct_lowering_t::lower_stmt(stmt_t const& stmt)
+{
+    type_t const return_type = eval.fn->type().return_type();
+
+    switch(stmt.name)
+    {
+    default:
+        if(!is_var_init(stmt.name))
+            unsupported();
+        {
+            unsigned const local_i = ::get_local_i(stmt.name);
+            type_t const type = local_type(local_i);
+
+            if(stmt.expr)
+            {
+                cast(lower_expr(*stmt.expr), type, true);
+                if(is_ct_array(type))
+                    emit({ .op = CT_STORE_ARRAY, .arg = local_i }, 0, -1);
+                else
+                    emit({ .op = CT_STORE, .type = type.name(), .arg = local_i }, -1);
+            }
+            else if(is_ct_array(type))
+            {
+                emit({ .op = CT_NEW_ARRAY, .arg = type.array_length() }, 0, 1);
+                emit({ .op = CT_STORE_ARRAY, .arg = local_i }, 0, -1);
+            }
+            else
+                emit({ .op = CT_CLEAR, .arg = local_i });
+        }
+        break;
+
+    case STMT_EXPR:
+    case STMT_FOR_EFFECT:
+        if(stmt.expr)
+            lower_effect(*stmt.expr);
+        break;
+
+    case STMT_DO_WHILE:
+    case STMT_DO_FOR:
+    case STMT_END_IF:
+    case STMT_FENCE:
+        break;
+
+    case STMT_ELSE:
+    case STMT_END_WHILE:
+    case STMT_END_FOR:
+    case STMT_BREAK:
+    case STMT_CONTINUE:
+        emit_stmt_jump(CT_JUMP, stmt.link);
+        break;
+
+    case STMT_IF:
+        cast(lower_expr(*stmt.expr), TYPE_BOOL, true);
+        if(def[stmt.link].name == STMT_ELSE)
+            emit_stmt_jump(CT_JUMP_UNLESS, { stmt.link.id + 1 });
+        else
+            emit_stmt_jump(CT_JUMP_UNLESS, stmt.link);
+        break;
+
+    case STMT_WHILE:
+    case STMT_FOR:
+        cast(lower_expr(*stmt.expr), TYPE_BOOL, true);
+        emit_stmt_jump(CT_JUMP_UNLESS, stmt.link);
+        break;
+
+    case STMT_END_DO_WHILE:
+    case STMT_END_DO_FOR:
+        cast(lower_expr(*stmt.expr), TYPE_BOOL, true);
+        emit_stmt_jump(CT_JUMP_IF, stmt.link);
+        break;
+
+    case STMT_RETURN:
+        if(stmt.expr)
+        {
+            cast(lower_expr(*stmt.expr), return_type, true);
+            if(is_ct_array(return_type))
+                emit({ .op = CT_RETURN_ARRAY }, 0, -1);
+            else
+                emit({ .op = CT_RETURN, .type = return_type.name() }, -1);
+        }
+        else if(return_type.name() != TYPE_VOID)
+            emit({ .op = CT_FAIL });
+        else
+            emit({ .op = CT_RETURN_VOID });
+        break;
+
+    case STMT_END_FN:
+        if(return_type.name() != TYPE_VOID)
+            emit({ .op = CT_FAIL });
+        else
+            emit({ .op = CT_RETURN_VOID });
+        break;
+
+    case STMT_NMI:
+    case STMT_GOTO_MODE:
+        emit({ .op = CT_FAIL });
+        break;
+    }
+}
+
+void eval_t::ct_lowering_t::cast(type_t from, type_t to, bool implicit, bool under)
+{
+    std::uint32_t const flags = (implicit ? CT_CAST_IMPLICIT : 0) | (under ? CT_CAST_UNDER : 0);
+
+    switch(can_cast(from, to, implicit))
+    {
+    case CAST_NOP:
+        return;
+    case CAST_PROMOTE:
+        emit({ .op = CT_PROMOTE, .type = to.name(), .lhs = from.name(), .arg = flags });
+        return;
+    case CAST_TRUNCATE:
+        emit({ .op = CT_TRUNCATE, .type = to.name(), .arg = flags });
+        return;
+    case CAST_BOOLIFY:
+        emit({ .op = CT_BOOLIFY, .type = TYPE_BOOL, .arg = flags });
+        return;
+    case CAST_CONVERT_INT:
+        emit({ .op = CT_CONVERT_INT, .type = to.name(), .arg = flags });
+        return;
+    case CAST_ROUND_REAL:
+        emit({ .op = CT_ROUND_REAL, .type = to.name(), .arg = flags });
+        return;
+    default:
+        unsupported();
+    }
+}
+
+// Returns the value of a local or global const, or null for other idents.
+rval_t const* eval_t::ct_lowering_t::const_rval(ast_node_t const& ast, type_t& type) const
+{
+    if(ast.token.type == TOK_ident && ast.token.signed_() < 0) // If we have a local const
+    {
+        if(!eval.local_consts)
+            unsupported();
+        local_const_t const& c = eval.local_consts[~ast.token.value];
+        type = c.type();
+        return &c.value;
+    }
+
+    if(ast.token.type == TOK_global_ident)
+    {
+        global_t const* global = ast.token.ptr<global_t>();
+        if(global->gclass() != GLOBAL_CONST || !global->resolved())
+            unsupported();
+
+        const_t const& c = global->impl<const_t>();
+        if(c.is_paa())
+            unsupported();
+
+        type = c.type();
+        return &c.rval();
+    }
+
+    return nullptr;
+}
+
+unsigned eval_t::ct_lowering_t::add_const_array(rval_t const& rval, type_t type)
+{
+    ct_array_t const* array = rval.size() == 1 ? std::get_if<ct_array_t>(&rval[0]) : nullptr;
+    if(!array || !*array)
+        unsupported();
+    bc.arrays.push_back(*array);
+    bc.array_lengths.push_back(type.array_length());
+    return bc.arrays.size() - 1;
+}
+
+type_t eval_t::ct_lowering_t::push_const(rval_t const& rval, type_t type)
+{
+    if(is_ct_scalar(type))
+    {
+        ssa_value_t const* v = rval.size() == 1 ? std::get_if<ssa_value_t>(&rval[0]) : nullptr;
+        if(!v || !v->is_num())
+            unsupported();
+        emit_push(v->fixed().value);
+    }
+    else if(is_ct_array(type))
+        emit({ .op = CT_PUSH_ARRAY, .arg = add_const_array(rval, type) }, 0, 1);
+    else
+        unsupported();
+
+    return type;
+}
+
+type_t eval_t::ct_lowering_t::lower_infix(ast_node_t const& ast, bool flipped)
+{
+    type_t const lhs = lower_expr(ast.children[flipped]);
+    type_t const rhs = lower_expr(ast.children[!flipped]);
+
+    switch(ast.token.type)
+    {
+    case TOK_asterisk: 
+        return lower_mul(lhs, rhs);
+    case TOK_fslash: 
+        return lower_arith(lhs, rhs, CT_DIV);
+    case TOK_plus: 
+        return lower_arith(lhs, rhs, CT_ADD);
+    case TOK_minus: 
+        return lower_arith(lhs, rhs, CT_SUB);
+    case TOK_bitwise_and: 
+        return lower_arith(lhs, rhs, CT_AND);
+    case TOK_bitwise_or: 
+        return lower_arith(lhs, rhs, CT_OR);
+    case TOK_bitwise_xor: 
+        return lower_arith(lhs, rhs, CT_XOR);
+    case TOK_lshift: 
+        return lower_shift(lhs, rhs, CT_SHL);
+    case TOK_rshift: 
+        return lower_shift(lhs, rhs, CT_SHR);
+    default: 
+        unsupported();
+    }
+}
+
+// Mirrors 'do_arith'.
+type_t eval_t::ct_lowering_t::lower_arith(type_t lhs, type_t rhs, ct_op_t op)
+{
+    req_quantity(lhs, rhs);
+
+    type_t result = lhs;
+
+    if(lhs != rhs)
+    {
+        if(is_ct(lhs) && can_cast(lhs, rhs, true))
+        {
+            cast(lhs, rhs, true, true);
+            result = rhs;
+        }
+        else if(is_ct(rhs) && can_cast(rhs, lhs, true))
+            cast(rhs, lhs, true);
+        else
+            unsupported();
+    }
+
+    emit({ .op = op, .type = result.name(), .lhs = result.name(), .rhs = result.name() }, -1);
+    return result;
+}
+
+// Mirrors 'do_mul'.
+type_t eval_t::ct_lowering_t::lower_mul(type_t lhs, type_t rhs)
+{
+    req_quantity(lhs, rhs);
+
+    type_t result;
+
+    if(is_ct(lhs) && is_ct(rhs))
+    {
+        if(can_cast(lhs, rhs, true))
+        {
+            cast(lhs, rhs, true, true);
+            result = lhs = rhs;
+        }
+        else
+        {
+            cast(rhs, lhs, true);
+            result = rhs = lhs;
+        }
+    }
+    else
+    {
+        unsigned const result_whole = std::min<unsigned>(whole_bytes(lhs.name()) + whole_bytes(rhs.name()), max_rt_whole_bytes);
+        unsigned const result_frac  = std::min<unsigned>(frac_bytes(lhs.name()) + frac_bytes(rhs.name()), max_rt_frac_bytes);
+        bool const result_sign = is_signed(lhs.name()) || is_signed(rhs.name());
+
+        result = type_s_or_u(result_whole, result_frac, result_sign);
+        if(!is_arithmetic(result.name()))
+            unsupported();
+
+        if(is_ct(lhs))
+        {
+            cast(lhs, result, true, true);
+            lhs = result;
+        }
+        if(is_ct(rhs))
+        {
+            cast(rhs, result, true);
+            rhs = result;
+        }
+    }
+
+    emit({ .op = CT_MUL, .type = result.name(), .lhs = lhs.name(), .rhs = rhs.name() }, -1);
+    return result;
+}
+
+// Mirrors 'do_shift'.
+type_t eval_t::ct_lowering_t::lower_shift(type_t lhs, type_t rhs, ct_op_t op)
+{
+    req_quantity(lhs, rhs);
+
+    if(rhs.name() == TYPE_INT)
+        cast(rhs, TYPE_U, true);
+    else if(rhs.name() != TYPE_U)
+        unsupported();
+
+    emit({ .op = op, .type = lhs.name(), .lhs = lhs.name(), .rhs = TYPE_U }, -1);
+    return lhs;
+}
+
+// Mirrors 'do_compare'.
+type_t eval_t::ct_lowering_t::lower_compare(ast_node_t const& ast, ct_op_t op, bool flipped)
+{
+    type_t lhs = lower_expr(ast.children[flipped]);
+    type_t rhs = lower_expr(ast.children[!flipped]);
+
+    req_quantity(lhs, rhs);
+
+    if(lhs != rhs)
+    {
+        if(is_ct(lhs) && can_cast(lhs, rhs, true))
+        {
+            cast(lhs, rhs, true, true);
+            lhs = rhs;
+        }
+        else if(is_ct(rhs) && can_cast(rhs, lhs, true))
+        {
+            cast(rhs, lhs, true);
+            rhs = lhs;
+        }
+    }
+
+    emit({ .op = op, .type = TYPE_BOOL, .lhs = lhs.name(), .rhs = rhs.name() }, -1);
+    return TYPE_BOOL;
+}
+
+type_t eval_t::ct_lowering_t::lower_expr(ast_node_t const& ast)
+{
+    switch(ast.token.type)
+    {
+    default:
+        unsupported();
+
+    case TOK_true:
+    case TOK_false:
+        emit_push(fixed_t::whole(ast.token.type == TOK_true).value);
+        return TYPE_BOOL;
+
+    case TOK_int:
+        emit_push(mask_numeric(fixed_t{ ast.token.value }, TYPE_INT).value);
+        return TYPE_INT;
+
+    case TOK_real:
+        emit_push(mask_numeric(fixed_t{ ast.token.value }, TYPE_REAL).value);
+        return TYPE_REAL;
+
+    case TOK_ident:
+    case TOK_global_ident:
+        {
+            type_t type;
+            if(rval_t const* rval = const_rval(ast, type))
+                return push_const(*rval, type);
+
+            if(ast.token.type != TOK_ident)
+                unsupported();
+
+            unsigned const local_i = ast.token.value;
+            type = local_type(local_i);
+
+            if(is_ct_array(type))
+                emit({ .op = CT_LOAD_ARRAY, .arg = local_i }, 0, 1);
+            else
+                emit({ .op = CT_LOAD, .arg = local_i }, 1);
+
+            return type;
+        }
+
+    case TOK_apply:
+        {
+            ast_node_t const& fn_ast = ast.children[0];
+            if(fn_ast.token.type != TOK_global_ident)
+                unsupported();
+
+            global_t const* global = fn_ast.token.ptr<global_t>();
+            if(global->gclass() != GLOBAL_FN)
+                unsupported();
+
+            fn_t const& call = global->impl<fn_t>();
+            if(call.fclass != FN_CT && call.fclass != FN_FN)
+                unsupported();
+
+            type_t const fn_type = call.type();
+            unsigned const num_args = ast.token.value - 1;
+            if(num_args != fn_type.num_params())
+                unsupported();
+
+            int delta = 0;
+            int array_delta = 0;
+
+            for(unsigned i = 0; i < num_args; ++i)
+            {
+                type_t const param = fn_type.type(i);
+                cast(lower_expr(ast.children[i + 1]), param, true);
+
+                if(is_ct_array(param))
+                    --array_delta;
+                else if(is_ct_scalar(param))
+                    --delta;
+                else
+                    unsupported();
+            }
+
+            type_t const return_type = fn_type.return_type();
+            if(is_ct_array(return_type))
+                ++array_delta;
+            else if(is_ct_scalar(return_type))
+                ++delta;
+            else if(return_type.name() != TYPE_VOID)
+                unsupported();
+
+            bc.calls.push_back({ global->handle<fn_ht>(), concat(fn_ast.token.pstring, ast.token.pstring) });
+            emit({ .op = CT_CALL, .arg = unsigned(bc.calls.size() - 1) }, delta, array_delta);
+
+            return return_type;
+        }
+
+    case TOK_cast:
+    case TOK_implicit_cast:
+        {
+            bool const implicit = ast.token.type == TOK_implicit_cast;
+            unsigned const num_args = ast.token.value - 1;
+
+            assert(ast.children[0].token.type == TOK_cast_type);
+            type_t type = dethunkify(ast.children[0].token.pstring, ast.children[0].token.ptr<type_t const>());
+
+            if(is_ct_scalar(type))
+            {
+                if(num_args == 0)
+                    emit_push(0);
+                else if(num_args == 1)
+                    cast(lower_expr(ast.children[1]), type, implicit);
+                else
+                    unsupported();
+                return type;
+            }
+
+            if(type.name() != TYPE_TEA || !is_ct_scalar(type.elem_type()))
+                unsupported();
+
+            type_t const elem = type.elem_type();
+
+            if(num_args == 0)
+            {
+                // Default initialize with zeroes.
+                if(type.size() == 0)
+                    unsupported();
+                emit_push(0);
+                emit({ .op = CT_FILL_ARRAY, .type = elem.name(), .arg = type.size() }, -1, 1);
+            }
+            else if(num_args == 1 && (type.size() != 0 || ast.children[1].token.type != TOK_cast))
+            {
+                type_t const arg = lower_expr(ast.children[1]);
+
+                if(arg.name() == TYPE_TEA)
+                {
+                    if(type.size() == 0)
+                        type.unsafe_set_size(arg.size());
+                    cast(arg, type, implicit);
+                }
+                else if(type.size() != 0)
+                {
+                    cast(arg, elem, implicit);
+                    emit({ .op = CT_FILL_ARRAY, .type = elem.name(), .arg = type.size() }, -1, 1);
+                }
+                else
+                {
+                    type.unsafe_set_size(1);
+                    cast(arg, elem, implicit);
+                    emit({ .op = CT_MAKE_ARRAY, .type = elem.name(), .arg = 1 }, -1, 1);
+                }
+            }
+            else
+            {
+                if(type.size() == 0)
+                    type.unsafe_set_size(num_args);
+                else if(type.size() != num_args)
+                    unsupported();
+
+                for(unsigned i = 0; i < num_args; ++i)
+                    cast(lower_expr(ast.children[i + 1]), elem, implicit);
+
+                emit({ .op = CT_MAKE_ARRAY, .type = elem.name(), .arg = num_args }, -int(num_args), 1);
+            }
+
+            if(!is_ct_array(type))
+                unsupported();
+
+            return type;
+        }
+
+    case TOK_index8:
+    case TOK_index16:
+        {
+            ast_node_t const& array_ast = ast.children[0];
+            type_t const index_type = ast.token.type == TOK_index8 ? TYPE_U : TYPE_U20;
+
+            type_t type;
+            if(rval_t const* rval = const_rval(array_ast, type))
+            {
+                if(!is_ct_array(type))
+                    unsupported();
+                unsigned const i = add_const_array(*rval, type);
+                cast(lower_expr(ast.children[1]), index_type, true);
+                emit({ .op = CT_LOAD_CONST_ELEM, .type = type.elem_type().name(), .arg = i });
+                return type.elem_type();
+            }
+
+            if(array_ast.token.type != TOK_ident)
+                unsupported();
+
+            unsigned const local_i = array_ast.token.value;
+            type = local_type(local_i);
+            if(!is_ct_array(type))
+                unsupported();
+
+            cast(lower_expr(ast.children[1]), index_type, true);
+            emit({ .op = CT_LOAD_ELEM, .type = type.elem_type().name(), .arg = local_i });
+            return type.elem_type();
+        }
+
+    case TOK_sizeof:
+    case TOK_len:
+        {
+            type_t const type = dethunkify(ast.token.pstring, ast.token.ptr<type_t const>());
+            unsigned const size = ast.token.type == TOK_sizeof ? type.size_of() : type.array_length();
+            if(size == 0)
+                unsupported();
+            emit_push(fixed_t::whole(size).value & numeric_bitmask(TYPE_INT));
+            return TYPE_INT;
+        }
+
+    case TOK_sizeof_expr:
+    case TOK_len_expr:
+        {
+            // Only the type is needed, so discard the code generated.
+            unsigned const code_size = bc.code.size();
+            int const old_depth = depth;
+            int const old_array_depth = array_depth;
+
+            type_t const type = lower_expr(ast.children[0]);
+
+            bc.code.resize(code_size);
+            depth = old_depth;
+            array_depth = old_array_depth;
+
+            unsigned const size = ast.token.type == TOK_sizeof_expr ? type.size_of() : type.array_length();
+            if(size == 0)
+                unsupported();
+            emit_push(fixed_t::whole(size).value & numeric_bitmask(TYPE_INT));
+            return TYPE_INT;
+        }
+
+    case TOK_logical_and:
+    case TOK_logical_or:
+        {
+            bool const is_or = ast.token.type == TOK_logical_or;
+
+            cast(lower_expr(ast.children[0]), TYPE_BOOL, true);
+            emit({ .op = CT_DUP }, 1);
+            unsigned const jump = emit({ .op = is_or ? CT_JUMP_IF : CT_JUMP_UNLESS }, -1);
+            emit({ .op = CT_DROP }, -1);
+            cast(lower_expr(ast.children[1]), TYPE_BOOL, true);
+            bc.code[jump].arg = bc.code.size();
+
+            return TYPE_BOOL;
+        }
+
+    case TOK_eq:
+        return lower_compare(ast, CT_EQ, false);
+    case TOK_not_eq:
+        return lower_compare(ast, CT_NOT_EQ, false);
+    case TOK_lt:
+    case TOK_gt:
+        return lower_compare(ast, CT_LT, ast.token.type == TOK_gt);
+    case TOK_lte:
+    case TOK_gte:
+        return lower_compare(ast, CT_LTE, ast.token.type == TOK_gte);
+
+    case TOK_asterisk:
+    case TOK_fslash:
+    case TOK_plus:
+    case TOK_minus:
+    case TOK_bitwise_and:
+    case TOK_bitwise_or:
+    case TOK_bitwise_xor:
+    case TOK_lshift:
+    case TOK_rshift:
+        return lower_infix(ast);
+
+    case TOK_unary_negate:
+        cast(lower_expr(ast.children[0]), TYPE_BOOL, true);
+        emit({ .op = CT_NOT, .type = TYPE_BOOL });
+        return TYPE_BOOL;
+
+    case TOK_unary_plus:
+        {
+            type_t const type = lower_expr(ast.children[0]);
+            req_quantity(type);
+            return type;
+        }
+
+    case TOK_unary_minus:
+    case TOK_unary_xor:
+        {
+            type_t const type = lower_expr(ast.children[0]);
+            req_quantity(type);
+            emit({ .op = ast.token.type == TOK_unary_minus ? CT_NEG : CT_BITNOT, .type = type.name() });
+            return type;
+        }
+    }
+}
+
+// Lowers an expression whose value is discarded, including assignments.
+void eval_t::ct_lowering_t::lower_effect(ast_node_t const& ast)
+{
+    switch(ast.token.type)
+    {
+    default:
+        emit_drop(lower_expr(ast));
+        return;
+
+    case TOK_assign:
+    case TOK_plus_assign:
+    case TOK_minus_assign:
+    case TOK_times_assign:
+    case TOK_div_assign:
+    case TOK_bitwise_and_assign:
+    case TOK_bitwise_or_assign:
+    case TOK_bitwise_xor_assign:
+    case TOK_lshift_assign:
+    case TOK_rshift_assign:
+        break;
+    }
+
+    ast_node_t const& lhs_ast = ast.children[0];
+    bool const indexed = lhs_ast.token.type == TOK_index8 || lhs_ast.token.type == TOK_index16;
+    ast_node_t const& var_ast = indexed ? lhs_ast.children[0] : lhs_ast;
+
+    if(var_ast.token.type != TOK_ident || var_ast.token.signed_() < 0)
+        unsupported();
+
+    unsigned const local_i = var_ast.token.value;
+    type_t type = local_type(local_i);
+
+    if(indexed)
+    {
+        if(!is_ct_array(type))
+            unsupported();
+        cast(lower_expr(lhs_ast.children[1]), lhs_ast.token.type == TOK_index8 ? TYPE_U : TYPE_U20, true);
+        type = type.elem_type();
+    }
+
+    if(ast.token.type == TOK_assign)
+    {
+        cast(lower_expr(ast.children[1]), type, true);
+
+        if(is_ct_array(type))
+            emit({ .op = CT_STORE_ARRAY, .arg = local_i }, 0, -1);
+        else if(indexed)
+            emit({ .op = CT_STORE_ELEM, .type = type.name(), .arg = local_i }, -2);
+        else
+            emit({ .op = CT_STORE, .type = type.name(), .arg = local_i }, -1);
+        return;
+    }
+
+    if(!is_ct_scalar(type))
+        unsupported();
+
+    // Load the old value:
+    if(indexed)
+    {
+        emit({ .op = CT_DUP }, 1);
+        emit({ .op = CT_LOAD_ELEM, .type = type.name(), .arg = local_i });
+    }
+    else
+        emit({ .op = CT_LOAD, .arg = local_i }, 1);
+
+    type_t const rhs = lower_expr(ast.children[1]);
+
+    switch(ast.token.type)
+    {
+    default:
+        assert(false);
+        unsupported();
+    case TOK_plus_assign:
+        cast(rhs, type, true);
+        lower_arith(type, type, CT_ADD);
+        break;
+    case TOK_minus_assign:
+        cast(rhs, type, true);
+        lower_arith(type, type, CT_SUB);
+        break;
+    case TOK_div_assign:
+        cast(rhs, type, true);
+        lower_arith(type, type, CT_DIV);
+        break;
+    case TOK_bitwise_and_assign:
+        cast(rhs, type, true);
+        lower_arith(type, type, CT_AND);
+        break;
+    case TOK_bitwise_or_assign:
+        cast(rhs, type, true);
+        lower_arith(type, type, CT_OR);
+        break;
+    case TOK_bitwise_xor_assign:
+        cast(rhs, type, true);
+        lower_arith(type, type, CT_XOR);
+        break;
+    case TOK_times_assign:
+        cast(lower_mul(type, rhs), type, false);
+        break;
+    case TOK_lshift_assign:
+        lower_shift(type, rhs, CT_SHL);
+        break;
+    case TOK_rshift_assign:
+        lower_shift(type, rhs, CT_SHR);
+        break;
+    }
+
+    if(indexed)
+        emit({ .op = CT_STORE_ELEM, .type = type.name(), .arg = local_i }, -2);
+    else
+        emit({ .op = CT_STORE, .type = type.name(), .arg = local_i }, -1);
+}
+
+// Returns false when the AST interpreter should be used instead.
+// This happens on errors, leaving the AST interpreter to report them.
+bool eval_t::run_ct_bytecode(ct_bytecode_t const& bc)
+{
+    using S = fixed_sint_t;
+    using U = fixed_uint_t;
+
+    // Reading the clock is slow, so it's only done every so many instructions.
+    constexpr unsigned CT_TIME_CHECK_INTERVAL = 1 << 16;
+
+    unsigned const num_locals = fn->def().local_vars.size();
+    unsigned const num_params = fn->def().num_params;
 
-template<eval_t::do_t D>
-expr_value_t eval_t::do_var_init_expr(var_ht var_i, ast_node_t const& expr)
-{
-    expr_value_t v = do_expr<D>(expr);
+    bc::small_vector<ssa_value_t, 16> scalars(num_locals);
+    bc::small_vector<ct_array_t, 4> arrays(num_locals);
 
-    if(can_size_unsized_array(v.type, var_type(var_i)))
-        var_type(var_i).set_array_length(v.type.array_length(), v.pstring);
+    for(unsigned i = 0; i < num_params; ++i)
+    {
+        rval_t const& arg = interpret_locals[i];
+        if(arg.size() != 1)
+            return false;
 
-    return throwing_cast<D>(std::move(v), var_type(var_i), true);
-}
+        if(bc.local_lengths[i])
+        {
+            ct_array_t const* array = std::get_if<ct_array_t>(&arg[0]);
+            if(!array || !*array)
+                return false;
+            arrays[i] = *array;
+        }
+        else if(ssa_value_t const* ssa = std::get_if<ssa_value_t>(&arg[0]))
+            scalars[i] = *ssa;
+        else
+            return false;
+    }
 
-template<eval_t::do_t D>
-void eval_t::interpret_stmts()
-{
-    static_assert(D != COMPILE);
+    bc::small_vector<U, 16> stack(bc.max_stack + 1);
+    U* sp = stack.data();
+    std::vector<ct_array_t> array_stack;
+    array_stack.reserve(bc.max_array_stack);
 
-    auto const do_condition = [&](bool check_value) -> bool
-    { 
-        expr_value_t v = throwing_cast<D>(do_expr<D>(*stmt->expr), TYPE_BOOL, true);
-        if(!is_interpret(D))
-            return check_value;
-        return v.fixed().value;
+    auto const pop_array = [&]() -> ct_array_t
+    {
+        ct_array_t array = std::move(array_stack.back());
+        array_stack.pop_back();
+        return array;
     };
 
+    ct_inst_t const* const code = bc.code.data();
+    unsigned pc = 0;
+    unsigned countdown = CT_TIME_CHECK_INTERVAL;
+
     while(true)
     {
-        check_time();
+        if(--countdown == 0)
+        {
+            countdown = CT_TIME_CHECK_INTERVAL;
+            check_time();
+        }
 
-        switch(stmt->name)
+        ct_inst_t const& inst = code[pc++];
+
+        // Casts can apply to the value under the top.
+        auto const cast_value = [&]() -> U& { return sp[(inst.arg & CT_CAST_UNDER) ? -2 : -1]; };
+
+        switch(inst.op)
         {
-        default: // Handles var inits
-            if(is_var_init(stmt->name))
+        case CT_PUSH:
+            *sp++ = bc.imms[inst.arg];
+            break;
+
+        case CT_LOAD:
             {
-                if(D == INTERPRET_CE)
-                    compiler_error(stmt->pstring, "Expression cannot be evaluated at compile-time.");
+                ssa_value_t const v = scalars[inst.arg];
+                if(!v.is_num())
+                    return false;
+                *sp++ = v.fixed().value;
+            }
+            break;
 
-                unsigned const local_i = ::get_local_i(stmt->name);
-                var_ht const var_i = to_var_i(local_i);
+        case CT_STORE:
+            scalars[inst.arg] = ssa_value_t(fixed_t{ *--sp }, inst.type);
+            break;
 
-                // Prepare the type.
-                if(var_type(var_i).name() == TYPE_VOID)
-                    var_type(var_i) = dethunkify(fn->def().local_vars[local_i].decl.src_type, true, this);
+        case CT_CLEAR:
+            scalars[inst.arg] = ssa_value_t();
+            break;
 
-                if(stmt->expr)
-                {
-                    expr_value_t v = do_var_init_expr<D>(var_i, *stmt->expr);
+        case CT_DUP:
+            *sp = sp[-1];
+            ++sp;
+            break;
 
-                    if(is_interpret(D))
-                        interpret_locals[local_i] = std::move(v.rval());
-                }
-                else if(is_interpret(D))
-                {
-                    type_t const type = var_type(var_i);
-                    unsigned const num = num_members(type);
-                    assert(num > 0);
+        case CT_DROP:
+            --sp;
+            break;
 
-                    rval_t rval;
-                    rval.reserve(num);
+        case CT_LOAD_ELEM:
+        case CT_LOAD_CONST_ELEM:
+            {
+                bool const is_const = inst.op == CT_LOAD_CONST_ELEM;
+                ct_array_t const& array = is_const ? bc.arrays[inst.arg] : arrays[inst.arg];
+                unsigned const length = is_const ? bc.array_lengths[inst.arg] : bc.local_lengths[inst.arg];
+                U const index = fixed_t{ sp[-1] }.whole();
+
+                if(index >= length || !array)
+                    return false;
+
+                ssa_value_t const v = array[index];
+                if(!v.is_num())
+                    return false;
+                sp[-1] = v.fixed().value;
+            }
+            break;
 
-                    for(unsigned i = 0; i < num; ++i)
-                    {
-                        type_t const mt = member_type(type, i);
-                        if(mt.name() == TYPE_TEA)
-                            rval.emplace_back(make_ct_array(mt.array_length()));
-                        else
-                            rval.emplace_back();
-                    }
+        case CT_STORE_ELEM:
+            {
+                ct_array_t& array = arrays[inst.arg];
+                unsigned const length = bc.local_lengths[inst.arg];
+                U const index = fixed_t{ sp[-2] }.whole();
 
-                    interpret_locals[local_i] = std::move(rval);
+                if(index >= length || !array)
+                    return false;
+
+                // If the array has multiple owners, copy it, creating a new one.
+                if(array.use_count() > 1)
+                {
+                    ct_array_t new_array = make_ct_array(length);
+                    std::copy(array.get(), array.get() + length, new_array.get());
+                    array = std::move(new_array);
                 }
 
-                ++stmt;
+                array[index] = ssa_value_t(fixed_t{ sp[-1] }, inst.type);
+                sp -= 2;
             }
-            else
-                compiler_error(stmt->pstring, fmt("Statement % cannot appear in constant evaluation.", to_string(stmt->name)));
             break;
 
-        case STMT_GOTO_MODE:
-            if(!is_check(D))
-                compiler_error(stmt->pstring, "Statement cannot appear in constant evaluation.");
-            // fall-through
-        case STMT_EXPR:
-        case STMT_FOR_EFFECT:
-            if(stmt->expr)
-                do_expr<D>(*stmt->expr);
-            ++stmt;
+#define BINARY(op, expr) \
+        case op: \
+            { \
+                S const lhs = to_signed(sp[-2], inst.lhs); \
+                S const rhs = to_signed(sp[-1], inst.rhs); \
+                --sp; \
+                sp[-1] = U(expr) & numeric_bitmask(inst.type); \
+            } \
             break;
 
-        case STMT_DO_WHILE:
-        case STMT_DO_FOR:
-        case STMT_END_IF:
-        case STMT_LABEL:
-        case STMT_END_SWITCH:
-        case STMT_CASE:
-        case STMT_DEFAULT:
-            ++stmt;
+        BINARY(CT_ADD, U(lhs) + U(rhs))
+        BINARY(CT_SUB, U(lhs) - U(rhs))
+        BINARY(CT_AND, lhs & rhs)
+        BINARY(CT_OR,  lhs | rhs)
+        BINARY(CT_XOR, lhs ^ rhs)
+        BINARY(CT_MUL, fixed_mul(lhs, rhs))
+        BINARY(CT_SHL, lhs << std::uint8_t(fixed_t{ U(rhs) }.whole()))
+        BINARY(CT_SHR, lhs >> std::uint8_t(fixed_t{ U(rhs) }.whole()))
+        BINARY(CT_EQ,     fixed_t::whole(lhs == rhs).value)
+        BINARY(CT_NOT_EQ, fixed_t::whole(lhs != rhs).value)
+        BINARY(CT_LT,     fixed_t::whole(lhs < rhs).value)
+        BINARY(CT_LTE,    fixed_t::whole(lhs <= rhs).value)
+#undef BINARY
+
+        case CT_DIV:
+            {
+                S const lhs = to_signed(sp[-2], inst.lhs);
+                S const rhs = to_signed(sp[-1], inst.rhs);
+                if(!rhs)
+                    return false;
+                --sp;
+                sp[-1] = U(fixed_div(lhs, rhs)) & numeric_bitmask(inst.type);
+            }
             break;
 
-        case STMT_ELSE:
-        case STMT_END_WHILE:
-        case STMT_END_FOR:
-        case STMT_BREAK:
-        case STMT_CONTINUE:
-        case STMT_GOTO:
-            if(is_interpret(D))
-                stmt = &fn->def()[stmt->link];
-            else
-                ++stmt;
+        case CT_NEG:
+            sp[-1] = (-sp[-1]) & numeric_bitmask(inst.type);
             break;
 
-        case STMT_IF:
-            if(do_condition(true))
-                ++stmt;
-            else
-            {
-                stmt = &fn->def()[stmt->link];
-                if(stmt->name == STMT_ELSE)
-                    ++stmt;
-            }
+        case CT_BITNOT:
+            sp[-1] = (~sp[-1]) & numeric_bitmask(inst.type);
             break;
 
-        case STMT_WHILE:
-        case STMT_FOR:
-            if(do_condition(true))
-                ++stmt;
-            else
-                stmt = &fn->def()[stmt->link];
+        case CT_NOT:
+            sp[-1] = fixed_t::whole(!sp[-1]).value;
             break;
 
-        case STMT_END_DO_WHILE:
-        case STMT_END_DO_FOR:
-            if(do_condition(false))
-                stmt = &fn->def()[stmt->link];
-            else
-                ++stmt;
+        case CT_PROMOTE:
+            cast_value() = U(to_signed(cast_value(), inst.lhs)) & numeric_bitmask(inst.type);
             break;
 
-        case STMT_SWITCH:
+        case CT_TRUNCATE:
+            cast_value() &= numeric_bitmask(inst.type);
+            break;
+
+        case CT_BOOLIFY:
+            cast_value() = boolify(fixed_t{ cast_value() }).value;
+            break;
+
+        case CT_CONVERT_INT:
             {
-                expr_value_t switch_expr = do_expr<D>(*stmt->expr);
-                switch_expr = throwing_cast<D>(std::move(switch_expr), is_signed(switch_expr.type.name()) ? TYPE_S : TYPE_U, true);
+                U const masked = cast_value() & numeric_bitmask(inst.type);
+                if((inst.arg & CT_CAST_IMPLICIT) && to_signed(masked, inst.type) != to_signed(cast_value(), TYPE_INT))
+                    return false;
+                cast_value() = masked;
+            }
+            break;
 
-                if(!is_interpret(D))
-                    ++stmt;
-                else while(true)
+        case CT_ROUND_REAL:
+            {
+                // Mirrors 'force_round_real'.
+                S const original = to_signed(cast_value(), TYPE_REAL);
+                U u = cast_value();
+                U const mask = numeric_bitmask(inst.type);
+                if(U z = builtin::ctz(mask))
+                    u += (1ull << (z - 1)) & u;
+                u &= mask;
+
+                if(inst.arg & CT_CAST_IMPLICIT)
                 {
-                    assert(stmt->link);
-                    stmt = &fn->def()[stmt->link];
+                    U const supermask = ::supermask(mask);
+                    if(static_cast<S>(original & supermask) != to_signed(original & mask, inst.type))
+                        return false;
+                }
 
-                    if(stmt->name == STMT_CASE)
-                    {
-                        expr_value_t case_expr = throwing_cast<D>(do_expr<D>(*stmt->expr), switch_expr.type, true);
+                cast_value() = u;
+            }
+            break;
 
-                        if(switch_expr.fixed() == case_expr.fixed())
-                        {
-                            ++stmt;
-                            break;
-                        }
-                    }
-                    else if(stmt->name == STMT_DEFAULT)
-                    {
-                        ++stmt;
-                        break;
-                    }
-                    else
-                        assert(false);
-                }
+        case CT_JUMP:
+            pc = inst.arg;
+            break;
+
+        case CT_JUMP_IF:
+            if(*--sp)
+                pc = inst.arg;
+            break;
+
+        case CT_JUMP_UNLESS:
+            if(!*--sp)
+                pc = inst.arg;
+            break;
+
+        case CT_LOAD_ARRAY:
+            if(!arrays[inst.arg])
+                return false;
+            array_stack.push_back(arrays[inst.arg]);
+            break;
+
+        case CT_PUSH_ARRAY:
+            array_stack.push_back(bc.arrays[inst.arg]);
+            break;
+
+        case CT_STORE_ARRAY:
+            arrays[inst.arg] = pop_array();
+            break;
+
+        case CT_DROP_ARRAY:
+            array_stack.pop_back();
+            break;
+
+        case CT_NEW_ARRAY:
+            array_stack.push_back(make_ct_array(inst.arg));
+            break;
+
+        case CT_FILL_ARRAY:
+            {
+                ct_array_t array = make_ct_array(inst.arg);
+                std::fill_n(array.get(), inst.arg, ssa_value_t(fixed_t{ *--sp }, inst.type));
+                array_stack.push_back(std::move(array));
             }
+            break;
 
+        case CT_MAKE_ARRAY:
+            {
+                ct_array_t array = make_ct_array(inst.arg);
+                sp -= inst.arg;
+                for(unsigned i = 0; i < inst.arg; ++i)
+                    array[i] = ssa_value_t(fixed_t{ sp[i] }, inst.type);
+                array_stack.push_back(std::move(array));
+            }
             break;
 
-        case STMT_RETURN:
+        case CT_CALL:
             {
-                type_t const return_type = fn->type().return_type();
-                if(stmt->expr)
+                ct_call_t const& call = bc.calls[inst.arg];
+                type_t const fn_type = call.fn->type();
+                unsigned const num_args = fn_type.num_params();
+
+                bc::small_vector<rval_t, 8> args(num_args);
+                for(int i = int(num_args) - 1; i >= 0; --i)
                 {
-                    expr_value_t v = throwing_cast<D>(do_expr<D>(*stmt->expr), return_type, true);
-                    if(is_interpret(D))
-                        final_result.value = std::move(v.rval());
-                    final_result.type = std::move(v.type);
+                    type_t const param = fn_type.type(i);
+                    if(is_ct_array(param))
+                        args[i] = rval_t{ pop_array() };
+                    else
+                        args[i] = rval_t{ ssa_value_t(fixed_t{ *--sp }, param.name()) };
                 }
-                else if(return_type.name() != TYPE_VOID)
+
+                rval_t result = interpret_call(call.pstring, *call.fn, args.data(), args.size());
+
+                type_t const return_type = fn_type.return_type();
+                if(return_type.name() == TYPE_VOID)
+                    break;
+                if(result.size() != 1)
+                    return false;
+
+                if(is_ct_array(return_type))
                 {
-                    compiler_error(stmt->pstring, fmt(
-                        "Expecting return expression of type %.", return_type));
+                    ct_array_t* array = std::get_if<ct_array_t>(&result[0]);
+                    if(!array || !*array)
+                        return false;
+                    array_stack.push_back(std::move(*array));
                 }
-            }
-            if(!is_check(D))
-                return;
-            ++stmt;
-            break;
-
-        case STMT_END_FN:
-            if(!is_check(D) && !fn->iasm)
-            {
-                type_t return_type = fn->type().return_type();
-                if(return_type.name() != TYPE_VOID)
+                else
                 {
-                    compiler_error(stmt->pstring, fmt(
-                        "Interpreter reached end of function without returning %.", return_type));
+                    ssa_value_t const* v = std::get_if<ssa_value_t>(&result[0]);
+                    if(!v || !v->is_num())
+                        return false;
+                    *sp++ = v->fixed().value;
                 }
             }
-            return;
-
-        case STMT_NMI:
-            if(!is_check(D))
-                compiler_error(stmt->pstring, "Cannot wait for nmi at compile-time.");
-            if(precheck_tracked)
-                precheck_tracked->wait_nmis.push_back(stmt_pstring_mods());
-            ++stmt;
             break;
 
-        case STMT_FENCE:
-            if(precheck_tracked)
-                precheck_tracked->fences.push_back(stmt_pstring_mods());
-            ++stmt;
-            break;
+        case CT_RETURN:
+            final_result.value = rval_t{ ssa_value_t(fixed_t{ *--sp }, inst.type) };
+            final_result.type = fn->type().return_type();
+            return true;
+
+        case CT_RETURN_ARRAY:
+            final_result.value = rval_t{ pop_array() };
+            final_result.type = fn->type().return_type();
+            return true;
+
+        case CT_RETURN_VOID:
+            return true;
+
+        case CT_FAIL:
+            return false;
         }
     }
-    assert(false);
 }
 
 static ssa_value_t _interpret_shift_atom(ssa_value_t v, int shift, pstring_t pstring)
@@ -2216,6 +3491,33 @@ expr_value_t eval_t::do_expr(ast_node_t const& ast)
                                 lhs.val = rval_t{ std::move(array.first) };
                             }
                             break;
+                        case fnv1a<std::uint64_t>::hash("flat"sv): 
+                            {
+                                if(!mod_test(charmap.mods(), MOD_flat))
+                                    goto bad_global_accessor;
+                                auto array = sl_manager.get_flat(&charmap.global);
+                                lhs.type = type_t::tea(TYPE_U, array.second);
+                                lhs.val = rval_t{ std::move(array.first) };
+                            }
+                            break;
+                        case fnv1a<std::uint64_t>::hash("flat_offsets"sv): 
+                            {
+                                if(!mod_test(charmap.mods(), MOD_flat))
+                                    goto bad_global_accessor;
+                                auto array = sl_manager.get_flat_offsets(&charmap.global);
+                                lhs.type = type_t::tea(TYPE_U20, array.second);
+                                lhs.val = rval_t{ std::move(array.first) };
+                            }
+                            break;
+                        case fnv1a<std::uint64_t>::hash("flat_lengths"sv): 
+                            {
+                                if(!mod_test(charmap.mods(), MOD_flat))
+                                    goto bad_global_accessor;
+                                auto array = sl_manager.get_flat_lengths(&charmap.global);
+                                lhs.type = type_t::tea(TYPE_U, array.second);
+                                lhs.val = rval_t{ std::move(array.first) };
+                            }
+                            break;
                         default:
                             goto bad_global_accessor;
                         }
@@ -2634,18 +3936,7 @@ expr_value_t eval_t::do_expr(ast_node_t const& ast)
                     rval_args[i] = args[i].rval();
                 }
 
-                try
-                {
-                    // NOTE: call as INTERPRET, not D.
-                    eval_t sub(do_wrapper_t<INTERPRET>{}, call_pstring, *call, nullptr, rval_args.data(), rval_args.size(),
-                               call->def().local_consts.data());
-                    result.val = std::move(sub.final_result.value);
-                }
-                catch(out_of_time_t& e)
-                {
-                    e.msg += fmt_note(this->pstring, "Backtrace:");
-                    throw;
-                }
+                result.val = interpret_call(call_pstring, *call, rval_args.data(), rval_args.size());
             }
             else if(is_compile(D))
             {
@@ -3777,7 +5068,7 @@ expr_value_t eval_t::do_expr(ast_node_t const& ast)
                     compiler_error(at, "Division by zero.");
                 return fixed_div(lhs, rhs); 
             }
-            static ssa_op_t op() { return SSA_null; }
+            static ssa_op_t op() { return SSA_div; }
         };
         return infix(&eval_t::do_arith<div_p>);
 
@@ -3981,7 +5272,7 @@ expr_value_t eval_t::do_expr(ast_node_t const& ast)
             else if(is_compile(D))
             {
                 // Must be two lines; reference invalidation lurks.
-                ssa_ht const ssa = builder.cfg->emplace_ssa(SSA_sub, v.type, ssa_value_t(0u, v.type.name()), v.ssa());
+                ssa_ht const ssa = builder.cfg->emplace_ssa(SSA_sub, v.type, ssa_value_t(0u, v.type.name()), v.ssa(), ssa_value_t(1u, TYPE_BOOL));
                 v.ssa() = ssa;
             }
 
@@ -4710,8 +6001,13 @@ expr_value_t eval_t::do_arith(expr_value_t lhs, expr_value_t rhs, token_t const&
     }
     else if(is_compile(Policy::D))
     {
-        if(!Policy::op())
-            compiler_error(result.pstring, "Cannot perform division at run-time.");
+        if(Policy::op() == SSA_div)
+        {
+            if(is_signed(result.type.name()) || frac_bytes(result.type.name()))
+                compiler_error(result.pstring, fmt("Cannot perform division of type % at run-time. (Only unsigned whole numbers can be divided.)", result.type));
+            if(!rhs.is_ct() && result.type.name() != TYPE_U)
+                compiler_error(result.pstring, fmt("Cannot divide type % by a variable at run-time. (Only U can be. Other unsigned types can be divided by constants.)", result.type));
+        }
 
         return compile_binary_operator(lhs, rhs, Policy::op(), result.type, ssa_argn(Policy::op()) > 2);
     }
@@ -5227,7 +6523,7 @@ expr_value_t eval_t::do_logical(ast_node_t const& ast)
         if(rhs.is_lt())
             goto lt;
 
-        return lhs;
+        return rhs;
     }
     else if(is_compile(D))
     {
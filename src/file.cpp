@@ -17,6 +17,8 @@
 #include "guard.hpp"
 #include "format.hpp"
 #include "compiler_error.hpp"
+#include "compile_cache.hpp"
+#include "watch.hpp"
 
 bool resource_path(fs::path preferred_dir, fs::path name, fs::path& result)
 {
@@ -84,6 +86,9 @@ std::vector<std::uint8_t> read_binary_file(std::string filename, pstring_t at)
         compiler_error(at, fmt("Unable to read: %", filename));
     }
 
+    compile_cache_t::note_resource(filename, vec);
+    watch_file(filename);
+
     return vec;
 }
 
@@ -109,6 +114,7 @@ void file_contents_t::reset(unsigned file_i)
         }
 
         m_source[m_size-1] = m_source[m_size-2] = '\0';
+        watch_file(m_path);
         return;
     }
 
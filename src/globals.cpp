@@ -6,6 +6,9 @@
 #include "alloca.hpp"
 #include "bitset.hpp"
 #include "compiler_error.hpp"
+#include "compile_cache.hpp"
+#include "pgo.hpp"
+#include "profile.hpp"
 #include "fnv1a.hpp"
 #include "o.hpp"
 #include "options.hpp"
@@ -287,21 +290,42 @@ void global_t::parse_cleanup()
         nmis()[i]->pimpl<nmi_impl_t>().index = i;
 }
 
+// Index into 'ready_queues' of the current worker thread.
+static TLS unsigned ready_worker_i = 0;
+
 template<typename Fn>
 void global_t::do_all(Fn const& fn)
 {
+    unsigned const num_threads = compiler_options().num_threads;
+
+    // Distribute the initially ready globals among the workers:
+    if(num_ready_queues != num_threads)
     {
-        std::lock_guard lock(ready_mutex);
-        globals_left = global_ht::pool().size();
+        ready_queues.reset(new ready_queue_t[num_threads]);
+        num_ready_queues = num_threads;
     }
-    ready_cv.notify_all();
+
+    std::sort(ready.begin(), ready.end(), [](global_t* a, global_t* b)
+              { return priority_less(b, a); });
+
+    for(unsigned i = 0; i < ready.size(); ++i)
+        ready_queues[i % num_threads].queue.push_back(ready[i]);
+
+    for(unsigned i = 0; i < num_threads; ++i)
+        std::make_heap(ready_queues[i].queue.begin(), ready_queues[i].queue.end(), priority_less);
+
+    ready_count = ready.size();
+    globals_left = global_ht::pool().size();
+    ready.clear();
+
+    std::atomic<unsigned> next_worker_i = 0;
 
     // Spawn threads to compile in parallel:
-    parallelize(compiler_options().num_threads,
-    [&fn](std::atomic<bool>& exception_thrown)
+    parallelize(num_threads,
+    [&fn, &next_worker_i](std::atomic<bool>& exception_thrown)
     {
-        ssa_pool::init();
-        cfg_pool::init();
+        ready_worker_i = next_worker_i++;
+        assert(ready_worker_i < num_ready_queues);
 
         while(!exception_thrown)
         {
@@ -310,7 +334,11 @@ void global_t::do_all(Fn const& fn)
             if(!global)
                 return;
 
-            do global = fn(*global);
+            do
+            {
+                profile_scope_t prof(global->name, "global");
+                global = fn(*global);
+            }
             while(global);
         }
     },
@@ -322,6 +350,10 @@ void global_t::do_all(Fn const& fn)
         }
         ready_cv.notify_all();
     });
+
+    // Clear out anything left behind by an error:
+    for(unsigned i = 0; i < num_ready_queues; ++i)
+        ready_queues[i].queue.clear();
 }
 
 // This function isn't thread-safe.
@@ -541,12 +573,67 @@ void global_t::build_order()
         }
 
         global.m_ideps_left.store(ideps_left);
+        global.m_priority = 0;
 
         if(ideps_left == 0)
             ready.push_back(&global);
     }
 
     assert(ready.size());
+
+    // Prioritize the critical path:
+    for(global_t& global : global_ht::values())
+        calc_priority(global);
+}
+
+// Roughly estimates how long the global will take to process.
+// This is deterministic, so that the schedule is too.
+unsigned global_t::estimate_cost() const
+{
+    unsigned cost = 1;
+
+    switch(gclass())
+    {
+    case GLOBAL_FN:
+        for(stmt_t const& stmt : impl<fn_t>().def().stmts)
+        {
+            cost += 1;
+            if((is_var_init(stmt.name) || has_expression(stmt.name)) && stmt.expr)
+                cost += stmt.expr->size();
+        }
+        break;
+
+    case GLOBAL_CONST:
+    case GLOBAL_VAR:
+        if(ast_node_t const* expr = datum()->init_expr)
+            cost += expr->size();
+        break;
+
+    default:
+        break;
+    }
+
+    return cost;
+}
+
+// Not thread safe!
+unsigned global_t::calc_priority(global_t& global)
+{
+    if(global.m_priority) // Already calculated.
+        return global.m_priority;
+
+    unsigned max_iuse = 0;
+    for(global_t* iuse : global.m_iuses)
+        max_iuse = std::max(max_iuse, calc_priority(*iuse));
+
+    return global.m_priority = global.estimate_cost() + max_iuse;
+}
+
+bool global_t::priority_less(global_t const* a, global_t const* b)
+{
+    if(a->m_priority != b->m_priority)
+        return a->m_priority < b->m_priority;
+    return a->m_this_id > b->m_this_id; // Break ties deterministically.
 }
 
 global_t* global_t::resolve(log_t* log)
@@ -594,48 +681,109 @@ global_t* global_t::completed()
         if(--iuse->m_ideps_left == 0)
             *(newly_ready_end++) = iuse;
 
-    std::size_t const newly_ready_size = newly_ready_end - newly_ready;
+    if(--globals_left <= 0)
+    {
+        // Wake everyone up so they can exit.
+        {
+            std::lock_guard lock(ready_mutex);
+        }
+        ready_cv.notify_all();
+        return nullptr;
+    }
 
-    if(newly_ready_size > 0)
-        --newly_ready_end; // We'll return the last global, not insert it.
+    // Continue onto the most critical global this worker has:
+    return push_pop_ready_globals(newly_ready, newly_ready_end);
+}
 
-    unsigned new_globals_left;
+global_t* global_t::push_pop_ready_globals(global_t* const* begin, global_t* const* end)
+{
+    std::size_t const size = end - begin;
+    global_t* ret = nullptr;
 
     {
-        std::lock_guard lock(ready_mutex);
-        if(globals_left)
+        ready_queue_t& rq = ready_queues[ready_worker_i];
+        std::lock_guard lock(rq.mutex);
+
+        for(global_t* const* it = begin; it != end; ++it)
+        {
+            rq.queue.push_back(*it);
+            std::push_heap(rq.queue.begin(), rq.queue.end(), priority_less);
+        }
+
+        if(!rq.queue.empty())
         {
-            ready.insert(ready.end(), newly_ready, newly_ready_end);
-            --globals_left;
+            std::pop_heap(rq.queue.begin(), rq.queue.end(), priority_less);
+            ret = rq.queue.back();
+            rq.queue.pop_back();
         }
-        new_globals_left = globals_left;
     }
 
-    if(new_globals_left == 0 || newly_ready_size > 2)
-        ready_cv.notify_all();
-    else if(newly_ready_size == 2)
-        ready_cv.notify_one();
+    if(!ret)
+    {
+        assert(size == 0);
+        return nullptr;
+    }
+
+    ready_count += int(size) - 1;
+
+    // Only touch the mutex when someone is actually asleep.
+    // Sleepers increment 'sleeping_workers' before checking 'ready_count',
+    // so one side or the other will see the change.
+    if(size > 1)
+    {
+        if(unsigned const sleeping = sleeping_workers.load())
+        {
+            {
+                std::lock_guard lock(ready_mutex);
+            }
+
+            if(size > 2 && sleeping > 1)
+                ready_cv.notify_all();
+            else
+                ready_cv.notify_one();
+        }
+    }
+
+    return ret;
+}
 
-    if(newly_ready_size > 0)
+global_t* global_t::pop_ready_global(unsigned worker_i)
+{
+    // Try our own queue first, then steal from the others:
+    for(unsigned i = 0; i < num_ready_queues; ++i)
     {
-        assert(*newly_ready_end);
-        return *newly_ready_end;
+        ready_queue_t& rq = ready_queues[(worker_i + i) % num_ready_queues];
+        std::lock_guard lock(rq.mutex);
+        if(!rq.queue.empty())
+        {
+            std::pop_heap(rq.queue.begin(), rq.queue.end(), priority_less);
+            global_t* ret = rq.queue.back();
+            rq.queue.pop_back();
+            --ready_count;
+            return ret;
+        }
     }
-    else
-        return nullptr;
+
+    return nullptr;
 }
 
 global_t* global_t::await_ready_global()
 {
-    std::unique_lock<std::mutex> lock(ready_mutex);
-    ready_cv.wait(lock, []{ return !ready.empty() || globals_left == 0; });
+    while(true)
+    {
+        if(globals_left <= 0)
+            return nullptr;
 
-    if(globals_left == 0)
-        return nullptr;
-    
-    global_t* ret = ready.back();
-    ready.pop_back();
-    return ret;
+        if(ready_count > 0)
+            if(global_t* ret = pop_ready_global(ready_worker_i))
+                return ret;
+
+        // Nothing to do; sleep until there is.
+        std::unique_lock<std::mutex> lock(ready_mutex);
+        ++sleeping_workers;
+        ready_cv.wait(lock, []{ return ready_count > 0 || globals_left <= 0; });
+        --sleeping_workers;
+    }
 }
 
 void global_t::compile_all()
@@ -715,6 +863,13 @@ xbitset_t<fn_ht> const& fn_t::nmi_used_in_modes() const
     return pimpl<nmi_impl_t>().used_in_modes;
 }
 
+bool fn_t::optimize_for_size() const
+{
+    if(compiler_options().opt_level == OPT_LEVEL_S)
+        return !mod_test(mods(), MOD_size, false);
+    return mod_test(mods(), MOD_size);
+}
+
 bool fn_t::ct_pure() const
 {
     switch(fclass)
@@ -1065,6 +1220,8 @@ void fn_t::compile_iasm()
 
     proc.build_label_offsets();
     rom_proc().safe().assign(std::move(proc));
+
+    compile_cache_t::store(*this);
 }
 
 void fn_t::compile()
@@ -1088,11 +1245,21 @@ void fn_t::compile()
     if(iasm)
         return compile_iasm();
 
+    // Reuse the output of a previous run, if possible:
+    {
+        profile_scope_t prof("compile_cache_t::load", "stage", global.name);
+        if(compile_cache_t::load(*this))
+            return;
+    }
+
     // Compile the FN.
     ssa_pool::clear();
     cfg_pool::clear();
     ir_t ir;
-    build_ir(ir, *this);
+    {
+        profile_scope_t prof("build_ir", "stage", global.name);
+        build_ir(ir, *this);
+    }
 
     auto const save_graph = [&](ir_t& ir, char const* suffix)
     {
@@ -1112,14 +1279,20 @@ void fn_t::compile()
 
     auto const optimize_suite = [&](bool post_byteified)
     {
-#define RUN_O(o, ...) do { if(o(__VA_ARGS__)) { \
+#define RUN_O(o, ...) do { profile_scope_t prof(#o, "pass", global.name, iter); \
+    if(o(__VA_ARGS__)) { \
     changed = true; \
+    prof.set_changed(true); \
     /*assert((std::printf("DID_O %s %s\n", global.name.c_str(), #o), true));*/ } \
+    else prof.set_changed(false); \
     ir.assert_valid(); \
     } while(false)
 
+        profile_scope_t prof(post_byteified ? "optimize_suite (byteified)" : "optimize_suite", "suite", global.name);
+
+        opt_settings_t const& opt = opt_settings();
         unsigned iter = 0;
-        constexpr unsigned MAX_ITER = 100;
+        unsigned const MAX_ITER = opt.max_iter;
         bool changed;
 
         // Do this first, to reduce the size of the IR:
@@ -1131,8 +1304,11 @@ void fn_t::compile()
 
             save_graph(ir, fmt("pre_fork_%_%", post_byteified, iter).c_str());
 
-            RUN_O(o_defork, log, ir);
-            RUN_O(o_fork, log, ir);
+            if(opt.all_passes)
+            {
+                RUN_O(o_defork, log, ir);
+                RUN_O(o_fork, log, ir);
+            }
 
             RUN_O(o_phis, log, ir);
 
@@ -1141,23 +1317,29 @@ void fn_t::compile()
             RUN_O(o_remove_unused_arguments, log, ir, *this, post_byteified);
 
             save_graph(ir, fmt("pre_id_%_%", post_byteified, iter).c_str());
-            RUN_O(o_identities, log, ir);
+            RUN_O(o_identities, log, ir, optimize_for_size());
             save_graph(ir, fmt("post_id_%_%", post_byteified, iter).c_str());
 
-            // 'o_loop' populates 'ai_prep', which feeds into 'o_abstract_interpret'.
-            // Thus, they must occur sequentially.
-            reset_ai_prep();
-            save_graph(ir, fmt("pre_loop_%_%", post_byteified, iter).c_str());
-            RUN_O(o_loop, log, ir, post_byteified);
-            save_graph(ir, fmt("pre_ai_%_%", post_byteified, iter).c_str());
-            RUN_O(o_abstract_interpret, log, ir, post_byteified);
-            save_graph(ir, fmt("post_ai_%_%", post_byteified, iter).c_str());
+            if(opt.all_passes)
+            {
+                // 'o_loop' populates 'ai_prep', which feeds into 'o_abstract_interpret'.
+                // Thus, they must occur sequentially.
+                reset_ai_prep();
+                save_graph(ir, fmt("pre_loop_%_%", post_byteified, iter).c_str());
+                RUN_O(o_loop, log, ir, post_byteified, optimize_for_size());
+                save_graph(ir, fmt("pre_ai_%_%", post_byteified, iter).c_str());
+                RUN_O(o_abstract_interpret, log, ir, post_byteified);
+                save_graph(ir, fmt("post_ai_%_%", post_byteified, iter).c_str());
+            }
 
             RUN_O(o_remove_unused_ssa, log, ir);
 
-            save_graph(ir, fmt("pre_motion_%_%", post_byteified, iter).c_str());
-            RUN_O(o_motion, log, ir);
-            save_graph(ir, fmt("post_motion_%_%", post_byteified, iter).c_str());
+            if(opt.all_passes)
+            {
+                save_graph(ir, fmt("pre_motion_%_%", post_byteified, iter).c_str());
+                RUN_O(o_motion, log, ir);
+                save_graph(ir, fmt("post_motion_%_%", post_byteified, iter).c_str());
+            }
 
             if(post_byteified)
             {
@@ -1170,9 +1352,18 @@ void fn_t::compile()
             ++iter;
 
             if(iter >= MAX_ITER)
+            {
+                if(profile::enabled)
+                {
+                    std::int64_t const now = profile::now();
+                    profile::record({ .name = "MAX_ITER", .cat = "limit", .fn = global.name, .begin = now, .end = now, .iter = int(iter) });
+                }
                 break;
+            }
         }
         while(changed);
+
+        prof.set_iter(iter);
     };
 
     save_graph(ir, "1_initial");
@@ -1186,24 +1377,40 @@ void fn_t::compile()
     assert(ir_reads());
 
     // Convert switches:
-    if(switch_partial_to_full(ir))
+    if(switch_partial_to_full(ir, optimize_for_size()))
         optimize_suite(false);
     save_graph(ir, "3_switch");
 
-    byteify(ir, *this);
+    // Lower division, then optimize the multiplications that creates:
+    if(lower_div(ir))
+        optimize_suite(false);
+
+    {
+        profile_scope_t prof("byteify", "stage", global.name);
+        byteify(ir, *this);
+    }
     save_graph(ir, "4_byteify");
     ir.assert_valid();
 
     optimize_suite(true);
     save_graph(ir, "5_o2");
 
-    std::size_t const proc_size = code_gen(log, ir, *this);
+    std::size_t proc_size;
+    {
+        profile_scope_t prof("code_gen", "stage", global.name);
+        proc_size = code_gen(log, ir, *this);
+    }
     save_graph(ir, "6_cg");
 
     // Calculate inline-ability
     assert(m_always_inline == false);
     if(fclass == FN_FN && !mod_test(mods(), MOD_inline, false))
     {
+        // Profiles make hot functions more eager to inline, and cold ones less:
+        bool const for_size = optimize_for_size();
+        pgo_fn_t const* pgo = pgo_lookup(global.name);
+        unsigned const size_scale = (pgo && pgo->hot() && !for_size) ? 2 : 1;
+
         if(referenced())
         {
             m_always_inline = false;
@@ -1217,7 +1424,9 @@ void fn_t::compile()
             if(proc_size < INLINE_SIZE_ONCE)
                 m_always_inline = true;
         }
-        else if(proc_size < INLINE_SIZE_LIMIT)
+        else if(pgo && pgo->cold())
+            m_always_inline = false;
+        else if(proc_size < INLINE_SIZE_LIMIT * size_scale)
         {
             bool const no_banks = ir_deref_groups().for_each_test([&](group_ht group) -> bool
             {
@@ -1239,11 +1448,17 @@ void fn_t::compile()
 
                 constexpr unsigned CALL_PENALTY = 3;
 
-                if(proc_size < INLINE_SIZE_GOAL + (call_cost * CALL_PENALTY))
+                // When optimizing for size, only inline bodies no bigger than a JSR and RTS:
+                constexpr unsigned CALL_SIZE = 4;
+                unsigned const goal = for_size ? CALL_SIZE : INLINE_SIZE_GOAL * size_scale;
+
+                if(proc_size < goal + (call_cost * CALL_PENALTY))
                     m_always_inline = true;
             }
         }
     }
+
+    compile_cache_t::store(*this);
 }
 
 void fn_t::precheck_finish_mode() const
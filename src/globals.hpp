@@ -1,7 +1,10 @@
 #ifndef GLOBALS_HPP
 #define GLOBALS_HPP
 
+#include <atomic>
 #include <cassert>
+#include <memory>
+#include <mutex>
 #include <ostream>
 #include <sstream>
 
@@ -30,6 +33,7 @@
 #include "mods.hpp"
 #include "debug_print.hpp"
 #include "byte_block.hpp"
+#include "ct_bytecode.hpp"
 
 struct rom_array_t;
 struct precheck_tracked_t;
@@ -77,6 +81,11 @@ private:
     fc::vector_set<global_t*> m_iuses;
     std::atomic<int> m_ideps_left = 0;
 
+    // Estimated cost of the longest chain of 'm_iuses' starting at this global.
+    // Globals with higher priorities get scheduled first.
+    // This is set by 'build_order'.
+    unsigned m_priority = 0;
+
     // These are for debugging:
     std::atomic<bool> m_resolved = false;
     std::atomic<bool> m_prechecked = false;
@@ -161,6 +170,11 @@ public:
     static global_t* detect_cycle(global_t& global, idep_class_t pass, idep_class_t calc);
     inline static std::vector<std::string> detect_cycle_error_msgs;
 
+    // Implementation details used in 'build_order'.
+    // Sets 'm_priority' along the critical path of 'm_iuses'.
+    unsigned estimate_cost() const;
+    static unsigned calc_priority(global_t& global);
+
     // This allocates 'gmember_t's.
     static void count_members(); 
 
@@ -217,9 +231,16 @@ private:
         }
     }
 
-    // Returns and pops the next ready global from the ready list.
+    // Returns and pops the next ready global, stealing from other workers if needed.
     static global_t* await_ready_global();
 
+    // Helpers for 'await_ready_global':
+    static global_t* pop_ready_global(unsigned worker_i);
+    static global_t* push_pop_ready_globals(global_t* const* begin, global_t* const* end);
+
+    // Orders the 'ready_queues' heaps by 'm_priority':
+    static bool priority_less(global_t const* a, global_t const* b);
+
 private:
     // Globals get allocated in these:
     inline static rh::robin_auto_table<global_t*> global_pool_map;
@@ -232,11 +253,31 @@ private:
     inline static std::mutex nmi_vec_mutex;
     inline static std::vector<fn_t*> nmi_vec;
 
-    // These represent a queue of globals ready to be compiled.
+    // Holds the globals that are ready to be compiled, as a max-heap of 'm_priority'.
+    // Each worker thread owns one, and idle workers steal from the others.
+    struct ready_queue_t
+    {
+        std::mutex mutex;
+        std::vector<global_t*> queue;
+    };
+
+    // Globals with no dependencies, built by 'build_order'.
+    // These get distributed among the 'ready_queues' by 'do_all'.
+    inline static std::vector<global_t*> ready;
+
+    inline static std::unique_ptr<ready_queue_t[]> ready_queues;
+    inline static unsigned num_ready_queues = 0;
+
+    // Total number of globals held across all the 'ready_queues':
+    inline static std::atomic<int> ready_count = 0;
+
+    // Counts down as globals complete. Zero or less means the phase is over.
+    inline static std::atomic<int> globals_left = 0;
+
+    // Used to put idle workers to sleep:
     inline static std::condition_variable ready_cv;
     inline static std::mutex ready_mutex;
-    inline static std::vector<global_t*> ready;
-    inline static unsigned globals_left;
+    inline static std::atomic<unsigned> sleeping_workers = 0;
 };
 
 class struct_t
@@ -348,6 +389,7 @@ struct precheck_tracked_t
 class fn_t : public modded_t
 {
 friend class global_t;
+friend class compile_cache_t;
 public:
     static constexpr global_class_t global_class = GLOBAL_FN;
     using handle_t = fn_ht;
@@ -390,6 +432,9 @@ public:
     bool ir_fences() const { assert(m_ir_writes); return m_ir_fences; }
     bool ct_pure() const;
 
+    // True when compiling for bytes over cycles, via '-Os' or the 'size' mod.
+    bool optimize_for_size() const;
+
     auto const& fence_rw() const { assert(m_fence_rw); return m_fence_rw; }
 
     bool always_inline() const { assert(global.compiled()); return m_always_inline; }
@@ -399,6 +444,12 @@ public:
 
     rom_proc_ht rom_proc() const { return m_rom_proc; }
 
+    auto const& cfg_preorder() const { assert(global.compiled()); return m_cfg_preorder; }
+    void assign_cfg_preorder(std::vector<unsigned>&& vec) { assert(compiler_phase() == PHASE_COMPILE); m_cfg_preorder = std::move(vec); }
+
+    auto const& loop_bounds() const { assert(global.compiled()); return m_loop_bounds; }
+    void assign_loop_bounds(std::vector<std::pair<locator_t, unsigned>>&& vec) { assert(compiler_phase() == PHASE_COMPILE); m_loop_bounds = std::move(vec); }
+
     void assign_lvars(lvars_manager_t&& lvars);
     lvars_manager_t const& lvars() const { assert(compiler_phase() >= PHASE_COMPILE); return m_lvars; }
     
@@ -435,6 +486,15 @@ public:
 
     std::stringstream const* info_stream() const { return m_info_stream.get(); }
     std::stringstream* info_stream() { return m_info_stream.get(); }
+
+    // Lowers the fn into bytecode for compile-time interpretation, once.
+    // Returns null if the fn can't be lowered.
+    template<typename Lower>
+    ct_bytecode_t const* ct_bytecode(Lower const& lower) const
+    {
+        std::call_once(m_ct_bytecode_once, [&]{ m_ct_bytecode = lower(); });
+        return m_ct_bytecode.get();
+    }
     
 private:
     template<typename Fn>
@@ -517,6 +577,13 @@ private:
     // Holds the assembly code generated.
     rom_proc_ht m_rom_proc;
 
+    // The handle id of each CFG node labeled in the generated code, in preorder.
+    // Profiles refer to nodes by preorder index, as handles are not stable between runs.
+    std::vector<unsigned> m_cfg_preorder;
+
+    // Maximum iterations of loops in the generated code, keyed by the header's label.
+    std::vector<std::pair<locator_t, unsigned>> m_loop_bounds;
+
     // Aids in allocating RAM for local variables:
     lvars_manager_t m_lvars;
     std::array<std::vector<span_t>, NUM_ROMV> m_lvar_spans;
@@ -536,6 +603,9 @@ private:
     // Used for debuggable output.
     std::unique_ptr<std::stringstream> m_info_stream;
 
+    mutable std::once_flag m_ct_bytecode_once;
+    mutable std::unique_ptr<ct_bytecode_t> m_ct_bytecode;
+
     // TODO: Alter layout for less false sharing
 
     // Bitset tracking which parameters and return values have been referenced.
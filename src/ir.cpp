@@ -888,6 +888,8 @@ cfg_ht ir_t::prune_cfg(cfg_ht cfg_node)
     assert(cfg_node->input_size() == 0);
     assert(cfg_node->output_size() == 0);
 
+    loop_bounds.remove(cfg_node);
+
     cfg_ht ret = cfg_node->next;
 
     // Remove it from our list.
@@ -1055,6 +1057,12 @@ void ir_t::assert_valid() const
                 assert(ssa_it->input(0)->op() == SSA_mul8_lo);
             }
 
+            if(ssa_it->op() == SSA_mul16x8_mid || ssa_it->op() == SSA_mul16x8_hi)
+            {
+                assert(ssa_it->input(0).holds_ref());
+                assert(ssa_it->input(0)->op() == SSA_mul16x8_lo);
+            }
+
             // Cast Checks
             if(ssa_it->op() == SSA_cast)
             {
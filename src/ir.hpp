@@ -3,6 +3,7 @@
 
 #include <functional>
 #include "robin/hash.hpp"
+#include "robin/map.hpp"
 
 #include "fixed.hpp"
 #include "type.hpp"
@@ -345,6 +346,9 @@ public:
 
     gmanager_t gmanager;
 
+    // Maximum iterations of loops, keyed by loop header. Found by 'o_loop'.
+    rh::batman_map<cfg_ht, unsigned> loop_bounds;
+
     cfg_ht cfg_begin() const { return m_cfg_begin; }
     cfg_ht begin() const { return m_cfg_begin; }
     cfg_ht end() const { return {}; }
@@ -267,19 +267,17 @@ bool loop_is_parent_of(cfg_ht loop_header, cfg_ht node)
 
 bool dominates(cfg_ht a, cfg_ht b)
 {
-    assert(a);
-    while(b != a)
-    {
-        assert(a);
-        assert(b);
+    assert(a && b);
 
-        if(algo(b).postorder_i >= algo(a).postorder_i)
-            return false;
+    if(a == b)
+        return true;
 
-        b = algo(b).idom;
-    }
-    assert(dom_intersect(a, b) == a);
-    return true;
+    // 'a' dominates 'b' if 'b' is in its subtree of the dominator tree.
+    // (Unreachable nodes have an empty subtree and an UNVISITED 'dom_i', failing this.)
+    auto const& ad = algo(a);
+    bool const result = algo(b).dom_i - ad.dom_i < ad.dom_size;
+    assert(result == orderless_dominates(a, b));
+    return result;
 }
 
 bool orderless_dominates(cfg_ht a, cfg_ht b)
@@ -313,44 +311,142 @@ cfg_ht dom_intersect(cfg_ht a, cfg_ht b)
     return a;
 }
 
-// Finds the immediate dominator of every cfg node.
+// Scratch space for 'build_dominators_from_order', indexed by 'preorder_i'.
+namespace
+{
+    struct dom_d
+    {
+        unsigned parent;   // In the DFS tree.
+        unsigned semi;     // The semidominator.
+        unsigned label;    // Has the smallest 'semi' on the path to 'ancestor'.
+        unsigned ancestor; // In the link-eval forest.
+        unsigned idom;
+        unsigned size;     // Of the subtree in the dominator tree.
+        unsigned next_i;   // Where the next child goes in the dominator tree's preorder.
+    };
+}
+
+static TLS std::vector<dom_d> dom_pool;
+static TLS std::vector<unsigned> dom_stack;
+
+// Returns the node with the smallest 'semi' on the path from 'v' to its forest root,
+// compressing the path along the way.
+static unsigned _dom_eval(dom_d* pool, std::vector<unsigned>& stack, unsigned v)
+{
+    if(pool[v].ancestor == UNVISITED)
+        return v;
+
+    // Compress iteratively, as the path can be thousands of nodes long.
+    assert(stack.empty());
+    for(unsigned u = v; pool[pool[u].ancestor].ancestor != UNVISITED; u = pool[u].ancestor)
+        stack.push_back(u);
+
+    while(!stack.empty())
+    {
+        dom_d& u = pool[stack.back()];
+        dom_d const& a = pool[u.ancestor];
+        stack.pop_back();
+
+        if(pool[a.label].semi < pool[u.label].semi)
+            u.label = a.label;
+        u.ancestor = a.ancestor;
+    }
+
+    return pool[v].label;
+}
+
+// Finds the immediate dominator of every cfg node,
+// then numbers the dominator tree so that 'dominates' is constant time.
 // 
-// Paper: A Simple, Fast Dominance Algorithm
-// By Keith D. Cooper, Timothy J. Harvey, and Ken Kennedy
+// Paper: Finding Dominators in Practice
+// By Loukas Georgiadis, Robert E. Tarjan, and Renato F. Werneck
+// (The "SNCA" algorithm.)
 void build_dominators_from_order(ir_t& ir)
 {
     for(auto& algo : cfg_algo_pool)
+    {
         algo.idom = {};
+        algo.dom_i = UNVISITED;
+        algo.dom_size = 0;
+    }
+
+    unsigned const size = preorder.size();
+    if(size == 0)
+        return;
+
+    assert(preorder[0] == ir.root);
+
+    dom_pool.resize(size);
+    dom_d* const pool = dom_pool.data();
+    for(unsigned i = 0; i < size; ++i)
+    {
+        dom_d& d = pool[i];
+        d.parent = 0;
+        d.semi = i;
+        d.label = i;
+        d.ancestor = UNVISITED;
+        d.size = 1;
+    }
 
-    bool changed;
-    do
+    // Compute semidominators, in reverse preorder:
+    for(unsigned i = size - 1; i > 0; --i)
     {
-        changed = false;
+        cfg_ht const h = preorder[i];
+        dom_d& d = pool[i];
 
-        // Reverse postorder, but skip start node.
-        for(auto it = postorder.rbegin()+1; it < postorder.rend(); ++it)
+        unsigned const input_size = h->input_size();
+        for(unsigned j = 0; j < input_size; ++j)
         {
-            cfg_ht h = *it;
-            assert(h != ir.root);
-
-            cfg_ht new_idom = {};
+            unsigned const pred_i = algo(h->input(j)).preorder_i;
+            if(pred_i == UNVISITED)
+                continue; // Unreachable.
 
-            unsigned const input_size = h->input_size();
-            for(std::size_t i = 0; i < input_size; ++i)
-            {
-                cfg_ht pred = h->input(i);
-                if(pred == ir.root || algo(pred).idom)
-                    new_idom = new_idom ? dom_intersect(new_idom, pred) : pred;
-            }
+            // Every predecessor ordered before 'h' is a DFS ancestor,
+            // and the latest of those is its parent.
+            if(pred_i < i)
+                d.parent = std::max(d.parent, pred_i);
 
-            if(new_idom != algo(h).idom)
-            {
-                algo(h).idom = new_idom;
-                changed = true;
-            }
+            d.semi = std::min(d.semi, pool[_dom_eval(pool, dom_stack, pred_i)].semi);
         }
+
+        d.ancestor = d.parent;
+    }
+
+    // Each immediate dominator is the nearest common ancestor 
+    // of the node's semidominator and parent:
+    pool[0].idom = 0;
+    for(unsigned i = 1; i < size; ++i)
+    {
+        dom_d& d = pool[i];
+
+        unsigned idom = d.parent;
+        while(idom > d.semi)
+            idom = pool[idom].idom;
+        d.idom = idom;
+    }
+
+    // Number the dominator tree.
+    // Parents come before their children in 'preorder', so no recursion is needed.
+    for(unsigned i = size - 1; i > 0; --i)
+        pool[pool[i].idom].size += pool[i].size;
+
+    pool[0].next_i = 1;
+    algo(preorder[0]).dom_i = 0;
+    algo(preorder[0]).dom_size = size;
+    for(unsigned i = 1; i < size; ++i)
+    {
+        dom_d& d = pool[i];
+        dom_d& idom_d = pool[d.idom];
+
+        unsigned const dom_i = idom_d.next_i;
+        idom_d.next_i += d.size;
+        d.next_i = dom_i + 1;
+
+        auto& a = algo(preorder[i]);
+        a.idom = preorder[d.idom];
+        a.dom_i = dom_i;
+        a.dom_size = d.size;
     }
-    while(changed);
 }
 
 ////////////////////////////////////////
@@ -19,6 +19,8 @@ struct cfg_algo_d
     unsigned preorder_i = UNVISITED;
     unsigned postorder_i = UNVISITED;
     cfg_ht idom = {};
+    unsigned dom_i = UNVISITED; // Preorder index in the dominator tree.
+    unsigned dom_size = 0; // Size of this node's subtree in the dominator tree.
     cfg_ht iloop_header = {};
     unsigned dfsp = 0; // implementation detail, used inside loop generation algorithm.
     unsigned header_i = 0;
@@ -63,7 +65,8 @@ std::uint64_t depth_exp(std::uint64_t depth, std::uint64_t scale = 4, std::uint6
 // Requires that the order was built.
 void build_dominators_from_order(ir_t& ir);
 
-// If 'a' dominates 'b'
+// If 'a' dominates 'b'. Constant time.
+// Requires that the dominance tree was built.
 bool dominates(cfg_ht a, cfg_ht b); 
 
 // If 'a' dominates 'b'.
@@ -18,6 +18,7 @@ struct asm_inst_t;
 // Tracks all vars used in assembly code, assigning them an index.
 class lvars_manager_t
 {
+friend class compile_cache_t;
 public:
     lvars_manager_t() = default;
     lvars_manager_t(fn_ht fn, asm_graph_t const& graph);
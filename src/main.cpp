@@ -23,6 +23,14 @@
 #include "cg_isel.hpp"
 #include "text.hpp"
 #include "compiler_error.hpp"
+#include "compile_cache.hpp"
+#include "asset_cache.hpp"
+#include "ct_memo.hpp"
+#include "watch.hpp"
+#include "profile.hpp"
+#include "emulate.hpp"
+#include "pgo.hpp"
+#include "cycles.hpp"
 
 extern char __GIT_COMMIT;
 
@@ -46,6 +54,8 @@ void handle_options(fs::path dir, po::options_description const& cfg_desc, po::v
                 std::ifstream ifs(path.string(), std::ios::in);
                 if(ifs)
                 {
+                    watch_file(path);
+
                     fs::path cfg_dir = path;
                     cfg_dir.remove_filename();
 
@@ -73,15 +83,67 @@ void handle_options(fs::path dir, po::options_description const& cfg_desc, po::v
         for(std::string const& str : vm["resource-dir"].as<std::vector<std::string>>())
             _options.resource_dirs.push_back(dir / fs::path(str));
 
+    if(vm.count("cache-dir"))
+        _options.cache_dir = dir / fs::path(vm["cache-dir"].as<std::string>());
+
     if(vm.count("output"))
         _options.output_file = vm["output"].as<std::string>();
 
     if(vm.count("graphviz"))
         _options.graphviz = true;
 
+    if(vm.count("page-placement"))
+        _options.page_placement = true;
+
+    if(vm.count("zp-cost"))
+        _options.zp_cost = true;
+
+    if(vm.count("optimize"))
+    {
+        std::string const& level = vm["optimize"].as<std::string>();
+        if(level == "0")
+            _options.opt_level = OPT_LEVEL_0;
+        else if(level == "1")
+            _options.opt_level = OPT_LEVEL_1;
+        else if(level == "2")
+            _options.opt_level = OPT_LEVEL_2;
+        else if(level == "3")
+            _options.opt_level = OPT_LEVEL_3;
+        else if(level == "s")
+            _options.opt_level = OPT_LEVEL_S;
+        else
+            throw std::runtime_error(fmt("Unknown optimization level: -O%", level));
+    }
+
+    if(vm.count("multiply"))
+    {
+        std::string const& impl = vm["multiply"].as<std::string>();
+        if(impl == "shift")
+            _options.mul_impl = MUL_SHIFT;
+        else if(impl == "table")
+            _options.mul_impl = MUL_TABLE;
+        else
+            throw std::runtime_error(fmt("Unknown multiply routine: %", impl));
+    }
+
     if(vm.count("build-time"))
         _options.build_time = true;
 
+    if(vm.count("run-frames"))
+        _options.run_frames = vm["run-frames"].as<unsigned>();
+
+    if(vm.count("profile-generate"))
+        _options.profile_generate = vm["profile-generate"].as<std::string>();
+
+    if(vm.count("vblank-budget"))
+        _options.vblank_budget = vm["vblank-budget"].as<unsigned>();
+
+    if(vm.count("profile-use"))
+        _options.profile_use = vm["profile-use"].as<std::string>();
+
+    if(vm.count("profile-compile"))
+        _options.profile_file = vm["profile-compile"].as<std::string>();
+
     if(vm.count("error-on-warning"))
         _options.werror = true;
 
@@ -94,8 +156,8 @@ void handle_options(fs::path dir, po::options_description const& cfg_desc, po::v
 #endif
     }
 
-    if(vm.count("timelimit"))
-        _options.time_limit = std::max(vm["timelimit"].as<int>(), 0);
+    if(vm.count("time-limit"))
+        _options.time_limit = std::max(vm["time-limit"].as<int>(), 0);
 
     if(vm.count("mapper"))
         _options.raw_mn = vm["mapper"].as<std::string>();
@@ -121,8 +183,14 @@ void handle_options(fs::path dir, po::options_description const& cfg_desc, po::v
     if(vm.count("info") || vm.count("rom-info"))
         _options.rom_info = true;
 
+    if(vm.count("info") || vm.count("cycle-info"))
+        _options.cycle_info = true;
+
     if(vm.count("pause"))
         _options.pause = true;
+
+    if(vm.count("watch"))
+        _options.watch = true;
 }
 
 int main(int argc, char** argv)
@@ -154,8 +222,12 @@ int main(int argc, char** argv)
                 ("resource-dir,R", po::value<std::vector<std::string>>(), "search directory for resource files")
                 ("output,o", po::value<std::string>(), "output file")
                 ("threads,j", po::value<int>(), "number of compiler threads")
+                ("optimize,O", po::value<std::string>(), "optimization level (0, 1, 2, 3, or s)")
+                ("multiply", po::value<std::string>(), "multiplication routine (shift or table)")
+                ("cache-dir", po::value<std::string>(), "directory to cache compiled functions and converted assets in, between builds")
                 ("error-on-warning,W", "turn warnings into errors")
                 ("pause", "await input on stdin before exiting")
+                ("watch", "rebuild whenever an input file changes")
             ;
 
             po::options_description mapper_opt("Mapper options");
@@ -175,8 +247,16 @@ int main(int argc, char** argv)
                 ("ir-info", "output intermediate info")
                 ("ram-info", "output RAM info")
                 ("rom-info", "output ROM info")
+                ("cycle-info", "output static cycle counts")
                 ("time-limit,T", po::value<int>(), "interpreter execution time limit (in ms, 0 is off)")
                 ("build-time,B", "print compiler execution time")
+                ("profile-compile", po::value<std::string>(), "write per-function compile times to a Chrome trace file")
+                ("run-frames", po::value<unsigned>(), "run the ROM for N frames, then print the cycles spent in each function")
+                ("profile-generate", po::value<std::string>(), "with --run-frames, write an execution profile to a file")
+                ("profile-use", po::value<std::string>(), "optimize using an execution profile")
+                ("vblank-budget", po::value<unsigned>(), "warn when an nmi can take more than N cycles")
+                ("page-placement", "place code and tables to avoid page-crossing penalties")
+                ("zp-cost", "allocate zero page by the weighted cost of each access")
             ;
 
             po::options_description cmdline_full;
@@ -236,6 +316,9 @@ int main(int argc, char** argv)
             if(compiler_options().source_names.empty())
                 throw std::runtime_error("No input files.");
 
+            if(!compiler_options().profile_generate.empty() && !compiler_options().run_frames)
+                throw std::runtime_error("--profile-generate requires --run-frames.");
+
             using namespace std::literals;
 
             // Handle mapper:
@@ -304,10 +387,25 @@ int main(int argc, char** argv)
             }
         }
 
+        if(compiler_options().watch)
+        {
+            // Keep compiled functions between rebuilds, even if no cache was requested:
+            if(compiler_options().cache_dir.empty())
+                _options.cache_dir = fs::temp_directory_path() / "nesfab-cache";
+
+            watch(argc, argv);
+            entry_time = std::chrono::system_clock::now();
+        }
+
         ////////////////////////////////////
         // OK! Now to do the actual work: //
         ////////////////////////////////////
 
+        profile::enabled = !compiler_options().profile_file.empty();
+
+        if(!compiler_options().profile_use.empty())
+            load_pgo(compiler_options().profile_use);
+
         auto time = std::chrono::system_clock::now();
 
         auto const output_time = [&time](char const* desc)
@@ -321,6 +419,13 @@ int main(int argc, char** argv)
             }
         };
 
+        // Spawn the compiler threads once, to be shared by every parallel phase:
+        thread_pool.start(compiler_options().num_threads, []
+        {
+            ssa_pool::init();
+            cfg_pool::init();
+        });
+
         global_t::init();
         output_time("init:     ");
 
@@ -388,6 +493,7 @@ int main(int argc, char** argv)
 
         set_compiler_phase(PHASE_ORDER_COMPILE);
         global_t::build_order();
+        compile_cache_t::prepare();
         output_time("order3:   ");
 
         // Compile each global:
@@ -395,6 +501,9 @@ int main(int argc, char** argv)
         global_t::compile_all();
         output_time("compile:  ");
 
+        if(compiler_options().build_time && compile_cache_t::enabled())
+            std::printf("cache:     %u hits, %u misses\n", compile_cache_t::hits(), compile_cache_t::misses());
+
         set_compiler_phase(PHASE_ALLOC_RAM);
         alloc_ram(nullptr, ~static_used_ram);
 
@@ -424,7 +533,7 @@ int main(int argc, char** argv)
         set_compiler_phase(PHASE_PREPARE_ALLOC_ROM);
         prune_rom_data();
         alloc_rom(nullptr, rom_allocator, mapper().num_32k_banks);
-        if(compiler_options().ram_info)
+        if(compiler_options().rom_info)
         {
             std::filesystem::create_directory("info/");
 
@@ -447,6 +556,28 @@ int main(int argc, char** argv)
         std::fclose(of);
         output_time("link:     ");
 
+        if(compiler_options().cycle_info || compiler_options().vblank_budget)
+        {
+            std::ofstream of;
+            if(compiler_options().cycle_info)
+            {
+                std::filesystem::create_directory("info/");
+                of.open("info/cycles_info.txt");
+            }
+
+            check_cycles(of.is_open() ? &of : nullptr);
+            output_time("cycles:   ");
+        }
+
+        if(compiler_options().run_frames)
+        {
+            run_frames(rom, compiler_options().run_frames, std::cout);
+            output_time("run:      ");
+        }
+
+        if(profile::enabled)
+            profile::write(compiler_options().profile_file);
+
         for(fn_t const& fn : fn_ht::values())
         {
             std::filesystem::create_directory("info/");
@@ -473,6 +604,9 @@ int main(int argc, char** argv)
 
     if(compiler_options().build_time)
     {
+        std::printf("ct memo:   %u hits, %u misses\n", ct_memo_t::hits(), ct_memo_t::misses());
+        std::printf("assets:    %u hits, %u misses\n", asset_cache_t::hits(), asset_cache_t::misses());
+
         auto now = std::chrono::system_clock::now();
         unsigned long long const ms = std::chrono::duration_cast<std::chrono::milliseconds>(now - entry_time).count();
         std::printf("time total:     %8lli ms\n", ms);
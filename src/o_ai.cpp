@@ -603,16 +603,17 @@ void ai_t::insert_traces()
         if(output_size < 2)
             continue;
 
-        assert(cfg_branch->last_daisy());
-        ssa_node_t& ssa_branch = *cfg_branch->last_daisy();
+        // Use a handle, as inserting traces can reallocate SSA nodes:
+        ssa_ht const ssa_branch = cfg_branch->last_daisy();
+        assert(ssa_branch);
 
         // If the condition is const, there's no point
         // in making a trace partition out of it.
-        ssa_value_t const condition = get_condition(ssa_branch);
+        ssa_value_t const condition = get_condition(*ssa_branch);
         if(!condition.is_handle())
             continue;
 
-        if(ssa_branch.op() == SSA_if)
+        if(ssa_branch->op() == SSA_if)
         {
             // Create new CFG nodes along each branch and insert SSA_traces into them.
             for(unsigned i = 0; i < output_size; ++i)
@@ -624,10 +625,10 @@ void ai_t::insert_traces()
                 insert_trace(cfg_trace, condition.handle(), ssa_value_t(i, type_name), 0);
             }
         }
-        else if(is_switch(ssa_branch.op()))
+        else if(is_switch(ssa_branch->op()))
         {
             // Create new CFG nodes along each non-default branch and insert SSA_traces into them.
-            unsigned const cases = ssa_switch_cases(ssa_branch.op());
+            unsigned const cases = ssa_switch_cases(ssa_branch->op());
             for(unsigned i = cases, j = 1; i < output_size; ++i, ++j)
             {
                 type_name_t const type_name = condition.type().name();
@@ -635,7 +636,7 @@ void ai_t::insert_traces()
 
                 cfg_ht const cfg_trace = ir.split_edge(cfg_branch->output_edge(i));
                 new_cfg(cfg_trace);
-                insert_trace(cfg_trace, condition.handle(), ssa_value_t(ssa_branch.input(j).fixed(), type_name), 0);
+                insert_trace(cfg_trace, condition.handle(), ssa_value_t(ssa_branch->input(j).fixed(), type_name), 0);
             }
         }
         else
@@ -2364,7 +2365,7 @@ void ai_t::rewrite_loops()
         {
             ssa_value_t condition = branch->input(0);
 
-            while(ssa_input0_class(condition->op()) == INPUT_LINK)
+            while(condition.holds_ref() && ssa_input0_class(condition->op()) == INPUT_LINK)
             {
                 if(condition->input_size() != 1)
                     goto dont_rewrite;
@@ -1,5 +1,7 @@
 #include "o_id.hpp"
 
+#include <algorithm>
+#include <array>
 #include <cstdint>
 
 #include <boost/container/small_vector.hpp>
@@ -12,12 +14,88 @@
 #include "type_mask.hpp"
 #include "alloca.hpp"
 #include "worklist.hpp"
+#include "asm.hpp"
+#include "runtime.hpp"
 
 namespace bc = ::boost::container;
 
+// Estimates whether multiplying by a constant is cheaper as the shifts and adds/subtracts
+// of 'add' and 'sub', or as the 'SSA_mul8_lo' calls that byteify will create.
+// Costs are in the units isel uses: cycles, or bytes when optimizing for size.
+static bool shifts_cheaper_than_mul(ssa_node_t const& mul, unsigned const_i, 
+                                    fixed_uint_t add, fixed_uint_t sub, bool for_size)
+{
+    auto const cost = [for_size](op_t op) { return for_size ? op_size(op) : op_cycles(op); };
+
+    type_name_t const type = mul.type().name();
+    unsigned const bytes = total_bytes(type);
+    unsigned const byte_add_cost = cost(LDA_ABSOLUTE) + cost(ADC_ABSOLUTE) + cost(STA_ABSOLUTE);
+
+    // Shifts by multiples of 8 only rename bytes, so only the remaining bits cost anything.
+    unsigned shifts = 0;
+    unsigned terms = 0;
+    unsigned prev_bit = 0;
+    bitset_for_each((add | sub) >> fixed_t::shift, [&](unsigned bit)
+    {
+        shifts += (bit - prev_bit) & 7;
+        prev_bit = bit;
+        ++terms;
+    });
+    prev_bit = fixed_t::shift;
+    for(unsigned bit = fixed_t::shift-1; bit < fixed_t::shift; --bit)
+    {
+        if((add | sub) & (1ull << bit))
+        {
+            shifts += (prev_bit - bit) & 7;
+            prev_bit = bit;
+            ++terms;
+        }
+    }
+
+    unsigned const shifts_cost = (shifts * bytes * cost(ROL_ABSOLUTE)) + (terms * bytes * byte_add_cost);
+
+    // Count the byte multiplications byteify will create, mirroring its loops:
+    type_name_t const lhs_type = mul.input(!const_i).type().name();
+    fixed_uint_t const factor = mul.input(const_i).fixed().value;
+    int const result_end = end_byte(type);
+
+    unsigned mul8s = 0;
+    unsigned products = 0;
+    std::array<bool, max_total_bytes * 2> columns = {};
+    for(int li = begin_byte(lhs_type); li < int(end_byte(lhs_type)); ++li)
+    for(int ri = 0; ri < int(max_total_bytes); ++ri)
+    {
+        unsigned const byte = (factor >> (ri * 8)) & 0xFF;
+        int const lo_i = li + ri;
+        if(!byte || lo_i - int(max_frac_bytes) >= result_end)
+            continue;
+
+        columns[lo_i] = true;
+        ++products;
+
+        if(byte == 1)
+            continue;
+
+        ++mul8s;
+
+        if(lo_i + 1 - int(max_frac_bytes) < result_end)
+        {
+            columns[lo_i + 1] = true;
+            ++products;
+        }
+    }
+
+    unsigned const mul8_cost = cost(LDA_ABSOLUTE) + cost(LDY_IMMEDIATE) + cost(JSR_ABSOLUTE) 
+                             + cost(STA_ABSOLUTE) + cost(STY_ABSOLUTE) + (for_size ? 0 : mul8_cycles());
+    unsigned const sums = products - std::count(columns.begin(), columns.end(), true);
+    unsigned const mul_cost = (mul8s * mul8_cost) + (sums * byte_add_cost);
+
+    return shifts_cost <= mul_cost;
+}
+
 // Replaces single nodes with one of their inputs.
 // (e.g. X + 0 becomes X, or Y & ~0 becomes Y)
-static bool o_simple_identity(log_t* log, ir_t& ir)
+static bool o_simple_identity(log_t* log, ir_t& ir, bool for_size)
 {
     dprint(log, "SIMPLE_IDENTITY");
     bool updated = false;
@@ -934,7 +1012,7 @@ static bool o_simple_identity(log_t* log, ir_t& ir)
                         }
 
                         ssa_ht const sub = ssa_it->cfg_node()->emplace_ssa(
-                            SSA_sub, other.type(), ssa_value_t(0u, other.type().name()), other);
+                            SSA_sub, other.type(), ssa_value_t(0u, other.type().name()), other, ssa_value_t(1u, TYPE_BOOL));
 
                         ssa_it->link_remove_input(i);
                         ssa_it->link_change_input(0, sub);
@@ -982,6 +1060,13 @@ static bool o_simple_identity(log_t* log, ir_t& ir)
 
                     assert(!(add & sub));
 
+                    // Big factors can be cheaper to multiply at run-time:
+                    if(f > 0 && !is_signed(other.type().name()) && !is_signed(ssa_it->type().name())
+                       && !shifts_cheaper_than_mul(*ssa_it, i, add, sub, for_size))
+                    {
+                        continue;
+                    }
+
                     // Before generating the shifts and adds,
                     // convert the operand to the resulting type,
                     // and change the sign if necessary.
@@ -1702,7 +1787,8 @@ run_monoid_t::run_monoid_t(log_t* log, ir_t& ir)
                     carry_req = 0;
             }
 
-            if(carry_req != 0 || uses_accum)
+            // When every operand cancels out, the result is just 'accum'.
+            if(carry_req != 0 || uses_accum || operands.empty())
             {
                 operands.push_back({ ssa_value_t(accum, type.name()) });
                 carry_req = 0;
@@ -1724,7 +1810,7 @@ run_monoid_t::run_monoid_t(log_t* log, ir_t& ir)
             while(operands.size() > 1)
                 step();
 
-            if(uses_accum)
+            if(uses_accum || operands.empty())
             {
                 operands.push_back({ ssa_value_t(accum, type.name()) });
                 if(operands.size() == 2)
@@ -1824,12 +1910,12 @@ void run_monoid_t::build(ssa_op_t def_op, ssa_ht h, bool negative)
 
 } // end anonymous namespace
 
-bool o_identities(log_t* log, ir_t& ir)
+bool o_identities(log_t* log, ir_t& ir, bool for_size)
 {
     auto const simple_repeated = [&]
     {
         bool updated = false;
-        while(o_simple_identity(log, ir))
+        while(o_simple_identity(log, ir, for_size))
             updated = true;
         return updated;
     };
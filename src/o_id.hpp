@@ -6,6 +6,7 @@
 class ir_t;
 
 // Applies various math identities to the code.
-bool o_identities(log_t* log, ir_t& ir);
+// 'for_size' picks between multiplying by constants using shifts or run-time calls.
+bool o_identities(log_t* log, ir_t& ir, bool for_size);
 
 #endif
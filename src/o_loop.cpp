@@ -18,6 +18,7 @@
 #include "constraints.hpp"
 #include "o_ai.hpp"
 #include "thread.hpp"
+#include "options.hpp"
 
 namespace bc = ::boost::container;
 
@@ -631,11 +632,12 @@ bool rewrite_loop(bool is_do, bool is_byteified, iv_t& root,
 }
 
 // Returns times unrolled, or 0 if nothing happened.
-fixed_sint_t unroll_loop(cfg_ht header, fixed_sint_t iterations)
+// When 'for_size' is set, only unrolls loops fully, and only if it doesn't grow the code.
+fixed_sint_t unroll_loop(cfg_ht header, fixed_sint_t iterations, bool for_size)
 {
     auto const& hd = header_data(header);
 
-    if(!hd.simple_unroll_body)
+    if(!hd.simple_unroll_body || !opt_settings().unroll)
         return 0;
     cfg_ht const body = hd.simple_unroll_body;
 
@@ -668,14 +670,29 @@ fixed_sint_t unroll_loop(cfg_ht header, fixed_sint_t iterations)
     if(cost_per_iter == 0)
         return 0;
 
-    unsigned unroll_amount = estimate_unroll_divisor(iterations, MAX_COST / cost_per_iter);
-    passert(iterations % unroll_amount == 0, iterations, unroll_amount);
+    unsigned unroll_amount;
 
-    if(unroll_amount <= 1)
-        return 0;
+    if(for_size)
+    {
+        // Unrolling fully removes the increment, comparison, and branch.
+        constexpr unsigned LOOP_COST = 4;
+
+        if(iterations <= 1 || iterations * cost_per_iter > cost_per_iter + LOOP_COST)
+            return 0;
 
-    if(unroll_amount * 2 >= iterations)
         unroll_amount = iterations;
+    }
+    else
+    {
+        unroll_amount = estimate_unroll_divisor(iterations, MAX_COST / cost_per_iter);
+        passert(iterations % unroll_amount == 0, iterations, unroll_amount);
+
+        if(unroll_amount <= 1)
+            return 0;
+
+        if(unroll_amount * 2 >= iterations)
+            unroll_amount = iterations;
+    }
 
     auto const in_unroll = [&](cfg_ht cfg) { return cfg == header || cfg == body; };
 
@@ -798,7 +815,7 @@ fixed_sint_t unroll_loop(cfg_ht header, fixed_sint_t iterations)
     return unroll_amount;
 }
 
-bool initial_loop_processing(log_t* log, ir_t& ir, bool is_byteified)
+bool initial_loop_processing(log_t* log, ir_t& ir, bool is_byteified, bool for_size)
 {
     bool updated = false;
 
@@ -1275,7 +1292,7 @@ bool initial_loop_processing(log_t* log, ir_t& ir, bool is_byteified)
                 }
             }
 
-            if(fixed_sint_t unroll_amount = unroll_loop(header, iterations))
+            if(fixed_sint_t unroll_amount = unroll_loop(header, iterations, for_size))
             {
                 dprint(log, "UNROLLED", unroll_amount);
                 iterations /= unroll_amount;
@@ -1310,6 +1327,10 @@ bool initial_loop_processing(log_t* log, ir_t& ir, bool is_byteified)
                 prep.constraints.reset(new constraints_t(std::move(c)));
             }
 
+            // Remember the bound, for cycle counting.
+            // Later runs may fail to recognize the rewritten loop, so this isn't cleared between runs.
+            ir.loop_bounds[header] = unsigned(std::min<fixed_sint_t>(iterations, ~0u));
+
             continue;
         }
     fail:
@@ -1328,7 +1349,7 @@ bool initial_loop_processing(log_t* log, ir_t& ir, bool is_byteified)
 // LOOP //
 //////////
 
-bool o_loop(log_t* log, ir_t& ir, bool is_byteified)
+bool o_loop(log_t* log, ir_t& ir, bool is_byteified, bool for_size)
 {
     build_loops_and_order(ir);
     build_dominators_from_order(ir);
@@ -1344,7 +1365,7 @@ bool o_loop(log_t* log, ir_t& ir, bool is_byteified)
 
     ssa_data_pool::scope_guard_t<ssa_loop_d> ssa_sg(ssa_pool::array_size());
 
-    updated |= initial_loop_processing(log, ir, is_byteified);
+    updated |= initial_loop_processing(log, ir, is_byteified, for_size);
 
     return updated;
 }
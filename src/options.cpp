@@ -1,4 +1,21 @@
 #include "options.hpp"
 
+#include <cassert>
+
 options_t _options;
 
+opt_settings_t const& opt_settings(opt_level_t level)
+{
+    // Indexed by 'opt_level_t'.
+    static constexpr opt_settings_t settings[] =
+    {
+        { .max_iter = 1,   .all_passes = false, .unroll = false, .sel_size = 32, .map_size = 128, .cost_bound = 2, .pbqp = false, .asm_graph = false },
+        { .max_iter = 8,   .all_passes = true,  .unroll = true,  .sel_size = 32, .map_size = 128, .cost_bound = 2, .pbqp = true,  .asm_graph = true },
+        { .max_iter = 100, .all_passes = true,  .unroll = true,  .sel_size = 32, .map_size = 128, .cost_bound = 2, .pbqp = true,  .asm_graph = true },
+        { .max_iter = 400, .all_passes = true,  .unroll = true,  .sel_size = 64, .map_size = 256, .cost_bound = 4, .pbqp = true,  .asm_graph = true },
+        { .max_iter = 100, .all_passes = true,  .unroll = true,  .sel_size = 32, .map_size = 128, .cost_bound = 2, .pbqp = true,  .asm_graph = true },
+    };
+
+    assert(level < sizeof(settings) / sizeof(settings[0]));
+    return settings[level];
+}
@@ -3,6 +3,7 @@
 
 // Compiler options.
 
+#include <cstdint>
 #include <vector>
 #include <filesystem>
 
@@ -11,6 +12,38 @@
 
 namespace fs = ::std::filesystem;
 
+// How hard the compiler tries to optimize, set by '-O'.
+enum opt_level_t : std::uint8_t
+{
+    OPT_LEVEL_0,
+    OPT_LEVEL_1,
+    OPT_LEVEL_2, // The default.
+    OPT_LEVEL_3,
+    OPT_LEVEL_S, // Like 2, but favoring smaller code.
+};
+
+// What an optimization level controls.
+struct opt_settings_t
+{
+    unsigned max_iter;   // Iteration cap of each 'optimize_suite'.
+    bool all_passes;     // If false, only the cheap IR passes run.
+    bool unroll;         // If loops can be unrolled.
+    unsigned sel_size;   // Selections kept per CFG node in isel, before scaling by loop depth.
+    unsigned map_size;   // CPU states kept per CFG node in isel, before scaling by loop depth.
+    unsigned cost_bound; // How much worse than the best a selection can be, in 'LDA_ABSOLUTE's.
+    bool pbqp;           // If false, isel picks the cheapest selection of each CFG node when it can, ignoring the loads between them.
+    bool asm_graph;      // If 'asm_graph_t::optimize' runs.
+};
+
+opt_settings_t const& opt_settings(opt_level_t level);
+
+// Which runtime routines implement multiplication, set by '--multiply'.
+enum mul_impl_t : std::uint8_t
+{
+    MUL_SHIFT, // Shift-and-add. Small, but slow. The default.
+    MUL_TABLE, // Quarter-square tables. Fast, but takes 2KB of ROM.
+};
+
 struct options_t
 {
     int num_threads = 1;
@@ -19,9 +52,15 @@ struct options_t
     bool ir_info = false;
     bool ram_info = false;
     bool rom_info = false;
+    bool cycle_info = false;
     bool build_time = false;
     bool werror = false;
     bool pause = false;
+    bool watch = false;
+    bool page_placement = false;
+    bool zp_cost = false;
+    opt_level_t opt_level = OPT_LEVEL_2;
+    mul_impl_t mul_impl = MUL_SHIFT;
 
     nes_system_t nes_system = NES_SYSTEM_UNKNOWN;
     std::string raw_system;
@@ -39,10 +78,18 @@ struct options_t
     std::vector<fs::path> source_names;
     std::vector<fs::path> code_dirs = { fs::current_path() };
     std::vector<fs::path> resource_dirs;
+
+    fs::path cache_dir; // Empty if compiled functions aren't cached.
+    fs::path profile_file; // Empty if not profiling.
+    unsigned run_frames = 0;
+    fs::path profile_generate; // Written by '--run-frames'.
+    fs::path profile_use;
+    unsigned vblank_budget = 0; // In cycles, or 0 to not check.
 };
 
 extern options_t _options;
 inline options_t const& compiler_options() { return _options; }
 inline mapper_t const& mapper() { return _options.mapper; }
+inline opt_settings_t const& opt_settings() { return opt_settings(_options.opt_level); }
 
 #endif
@@ -0,0 +1,136 @@
+#include "pgo.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+
+#include "format.hpp"
+#include "watch.hpp"
+
+namespace
+{
+    bool enabled = false;
+    std::uint64_t frames = 0;
+    std::map<std::string, pgo_fn_t, std::less<>> fns;
+    constexpr std::uint64_t MAX_WEIGHT = 1ull << 32;
+}
+
+bool pgo_fn_t::hot() const
+{
+    return calls > 0 && calls >= frames;
+}
+
+std::optional<std::uint64_t> pgo_fn_t::count(unsigned cfg_i) const
+{
+    if(std::uint64_t const* count = labels.mapped(cfg_i))
+        return *count;
+    return std::nullopt;
+}
+
+std::optional<std::uint64_t> pgo_fn_t::block_weight(unsigned cfg_i) const
+{
+    if(!calls)
+        return std::nullopt;
+    if(auto c = count(cfg_i))
+        return std::min(MAX_WEIGHT, 1 + (*c * pgo_fn_t::ONCE_WEIGHT) / calls);
+    return std::nullopt;
+}
+
+std::optional<std::uint64_t> pgo_fn_t::edge_weight(unsigned from_i, unsigned to_i) const
+{
+    auto const from = block_weight(from_i);
+    auto const to = block_weight(to_i);
+    if(from && to)
+        return std::min(*from, *to);
+    return std::nullopt;
+}
+
+void load_pgo(fs::path const& path)
+{
+    std::ifstream file(path);
+    if(!file.is_open())
+        throw std::runtime_error(fmt("Unable to open profile %", path.string()));
+    watch_file(path);
+
+    auto const error = [&](unsigned line_number, std::string const& what)
+    {
+        throw std::runtime_error(fmt("%:%: %", path.string(), line_number, what));
+    };
+
+    std::string line;
+    for(unsigned line_number = 1; std::getline(file, line); ++line_number)
+    {
+        std::istringstream ss(line);
+        std::string kind;
+        if(!(ss >> kind) || kind[0] == '#')
+            continue;
+
+        if(kind == "frames")
+        {
+            if(!(ss >> frames))
+                error(line_number, "Expecting frame count.");
+        }
+        else if(kind == "fn")
+        {
+            std::string name;
+            std::uint64_t calls, cycles;
+            unsigned nodes;
+            if(!(ss >> name >> calls >> cycles >> nodes))
+                error(line_number, "Expecting 'fn <name> <calls> <cycles> <nodes>'.");
+            pgo_fn_t& fn = fns[name];
+            fn.calls += calls;
+            fn.cycles += cycles;
+            fn.nodes = nodes;
+        }
+        else if(kind == "label")
+        {
+            std::string name;
+            unsigned cfg_i;
+            std::uint64_t count;
+            if(!(ss >> name >> cfg_i >> count))
+                error(line_number, "Expecting 'label <fn name> <cfg> <count>'.");
+            fns[name].labels[cfg_i] += count;
+        }
+        else
+            error(line_number, fmt("Unknown record '%'.", kind));
+    }
+
+    enabled = true;
+}
+
+bool pgo_enabled() { return enabled; }
+
+pgo_fn_t const* pgo_lookup(std::string_view fn_name)
+{
+    if(!enabled)
+        return nullptr;
+    auto it = fns.find(fn_name);
+    if(it == fns.end())
+        return nullptr;
+    return &it->second;
+}
+
+void pgo_writer_t::write(fs::path const& path) const
+{
+    std::ofstream file(path);
+    if(!file.is_open())
+        throw std::runtime_error(fmt("Unable to open profile %", path.string()));
+
+    file << "# nesfab execution profile\n";
+    file << "frames " << frames << '\n';
+
+    std::vector<std::pair<unsigned, std::uint64_t>> labels;
+    for(auto const& [name, fn] : fns)
+    {
+        file << "fn " << name << ' ' << fn.calls << ' ' << fn.cycles << ' ' << fn.nodes << '\n';
+
+        labels.clear();
+        for(auto const& pair : fn.labels)
+            labels.emplace_back(pair.first, pair.second);
+        std::sort(labels.begin(), labels.end());
+        for(auto const& [cfg_i, count] : labels)
+            file << "label " << name << ' ' << cfg_i << ' ' << count << '\n';
+    }
+}
@@ -0,0 +1,77 @@
+#ifndef PGO_HPP
+#define PGO_HPP
+
+// Execution profiles, for profile-guided optimization.
+//
+// A profile is plain text, with one record per line.
+// Blank lines and lines starting with '#' are ignored.
+//
+//   frames <count>
+//       How many frames the profile covers.
+//   fn <name> <calls> <cycles> <nodes>
+//       How often a function was called, the cycles spent in it,
+//       and how many CFG nodes it had when profiled.
+//   label <fn name> <cfg> <count>
+//       How often a function's CFG node was entered.
+//       CFG nodes are numbered in depth-first preorder, with the entry node being 0.
+//       Listed nodes which never ran should have a count of 0.
+//       If the function's CFG has changed size since, its labels are ignored.
+//
+// Functions missing from the profile are optimized as if there was no profile.
+// Use '--run-frames' with '--profile-generate' to create one.
+
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <optional>
+#include <string>
+#include <string_view>
+
+#include "robin/map.hpp"
+
+namespace fs = ::std::filesystem;
+
+class pgo_fn_t
+{
+public:
+    // The weight of a node which runs once per call.
+    static constexpr std::uint64_t ONCE_WEIGHT = 16;
+
+    std::uint64_t calls = 0;
+    std::uint64_t cycles = 0;
+    unsigned nodes = 0;
+    rh::batman_map<unsigned, std::uint64_t> labels; // Maps CFG preorder indexes to counts.
+
+    // If the function ran at least once per frame.
+    bool hot() const;
+
+    // If the function is in the profile, but never ran.
+    bool cold() const { return calls == 0; }
+
+    std::optional<std::uint64_t> count(unsigned cfg_i) const;
+
+    // How often a CFG node or edge runs per call, as a cost multiplier.
+    // A node which runs once per call gets 'ONCE_WEIGHT', matching a loop depth of 1 in 'depth_exp'.
+    std::optional<std::uint64_t> block_weight(unsigned cfg_i) const;
+    std::optional<std::uint64_t> edge_weight(unsigned from_i, unsigned to_i) const;
+};
+
+// Reads a profile for '--profile-use'.
+void load_pgo(fs::path const& path);
+
+// True if a profile was loaded.
+bool pgo_enabled();
+
+// Returns null if 'fn_name' isn't profiled.
+pgo_fn_t const* pgo_lookup(std::string_view fn_name);
+
+// Used to write a profile.
+struct pgo_writer_t
+{
+    std::uint64_t frames = 0;
+    std::map<std::string, pgo_fn_t> fns;
+
+    void write(fs::path const& path) const;
+};
+
+#endif
@@ -0,0 +1,186 @@
+#include "profile.hpp"
+
+#include <cassert>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "format.hpp"
+#include "guard.hpp"
+#include "phase.hpp"
+#include "thread.hpp"
+
+namespace
+{
+    // Each thread records into its own buffer, to avoid contention.
+    struct thread_events_t
+    {
+        unsigned tid;
+        std::vector<profile_event_t> events;
+    };
+
+    std::mutex threads_mutex;
+    std::deque<thread_events_t> threads; // Deque to keep pointers stable.
+    TLS thread_events_t* this_thread = nullptr;
+
+    auto const start_time = std::chrono::steady_clock::now();
+
+    char const* phase_name(compiler_phase_t phase)
+    {
+        switch(phase)
+        {
+        case PHASE_NONE: return "none";
+        case PHASE_INIT: return "init";
+        case PHASE_PARSE: return "parse";
+        case PHASE_PARSE_CLEANUP: return "parse cleanup";
+        case PHASE_COUNT_MEMBERS: return "count members";
+        case PHASE_GROUP_MEMBERS: return "group members";
+        case PHASE_FINISH_MEMBERS: return "finish members";
+        case PHASE_RUNTIME: return "runtime";
+        case PHASE_CHARMAP_GROUPS: return "charmap groups";
+        case PHASE_CONVERT_STRINGS: return "convert strings";
+        case PHASE_COMPRESS_STRINGS: return "compress strings";
+        case PHASE_ORDER_RESOLVE: return "order resolve";
+        case PHASE_RESOLVE: return "resolve";
+        case PHASE_ORDER_PRECHECK: return "order precheck";
+        case PHASE_PRECHECK: return "precheck";
+        case PHASE_ORDER_COMPILE: return "order compile";
+        case PHASE_COMPILE: return "compile";
+        case PHASE_ALLOC_RAM: return "alloc ram";
+        case PHASE_RESET_PROC: return "reset proc";
+        case PHASE_ASM_GOTO_MODES: return "asm goto modes";
+        case PHASE_INITIAL_VALUES: return "initial values";
+        case PHASE_PREPARE_ALLOC_ROM: return "prepare alloc rom";
+        case PHASE_ALLOC_ROM: return "alloc rom";
+        case PHASE_LINK: return "link";
+        }
+        return "unknown";
+    }
+
+    // Records the span of each compiler phase.
+    class phase_profiler_t : public on_phase_change_t
+    {
+    public:
+        virtual void on_change(compiler_phase_t from, compiler_phase_t to)
+        {
+            if(!profile::enabled)
+                return;
+
+            std::int64_t const now = profile::now();
+            if(m_begin >= 0)
+                profile::record({ .name = phase_name(from), .cat = "phase", .begin = m_begin, .end = now });
+            m_begin = now;
+        }
+
+    private:
+        std::int64_t m_begin = -1;
+    };
+
+    phase_profiler_t phase_profiler;
+
+    void write_json_string(FILE* fp, std::string_view str)
+    {
+        std::fputc('"', fp);
+        for(char c : str)
+        {
+            if(c == '"' || c == '\\')
+                std::fputc('\\', fp);
+            if(static_cast<unsigned char>(c) >= 0x20)
+                std::fputc(c, fp);
+        }
+        std::fputc('"', fp);
+    }
+}
+
+namespace profile
+{
+
+std::int64_t now()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start_time).count();
+}
+
+void record(profile_event_t const& event)
+{
+    if(!this_thread)
+    {
+        std::lock_guard<std::mutex> lock(threads_mutex);
+        this_thread = &threads.emplace_back(thread_events_t{ unsigned(threads.size()) });
+    }
+
+    this_thread->events.push_back(event);
+}
+
+void write(fs::path const& path)
+{
+    FILE* fp = std::fopen(path.string().c_str(), "w");
+    if(!fp)
+        throw std::runtime_error(fmt("Unable to open profile file: %", path.string()));
+    auto scope_guard = make_scope_guard([&]{ std::fclose(fp); });
+
+    std::lock_guard<std::mutex> lock(threads_mutex);
+
+    std::fputs("{\"traceEvents\":[\n", fp);
+
+    bool first = true;
+    auto const separate = [&]
+    {
+        if(!first)
+            std::fputs(",\n", fp);
+        first = false;
+    };
+
+    for(thread_events_t const& thread : threads)
+    {
+        separate();
+        std::fprintf(fp, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"thread %u\"}}",
+                     thread.tid, thread.tid);
+
+        for(profile_event_t const& event : thread.events)
+        {
+            separate();
+            std::fputs("{\"name\":", fp);
+            write_json_string(fp, event.name);
+            std::fputs(",\"cat\":", fp);
+            write_json_string(fp, event.cat);
+            std::fprintf(fp, ",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%lld,\"dur\":%lld,\"args\":{",
+                         thread.tid, (long long)event.begin, (long long)(event.end - event.begin));
+
+            bool first_arg = true;
+            auto const separate_arg = [&]
+            {
+                if(!first_arg)
+                    std::fputc(',', fp);
+                first_arg = false;
+            };
+
+            if(!event.fn.empty())
+            {
+                separate_arg();
+                std::fputs("\"fn\":", fp);
+                write_json_string(fp, event.fn);
+            }
+
+            if(event.iter >= 0)
+            {
+                separate_arg();
+                std::fprintf(fp, "\"iter\":%i", event.iter);
+            }
+
+            if(event.changed >= 0)
+            {
+                separate_arg();
+                std::fprintf(fp, "\"changed\":%s", event.changed ? "true" : "false");
+            }
+
+            std::fputs("}}", fp);
+        }
+    }
+
+    std::fputs("\n]}\n", fp);
+}
+
+} // namespace profile
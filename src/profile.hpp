@@ -0,0 +1,67 @@
+#ifndef PROFILE_HPP
+#define PROFILE_HPP
+
+// Records how long each global and each optimization pass takes to compile,
+// for '--profile-compile'. The result is written in Chrome's trace event format,
+// viewable in 'chrome://tracing' or Perfetto.
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <string_view>
+
+namespace fs = ::std::filesystem;
+
+struct profile_event_t
+{
+    std::string_view name; // Must outlive the profiler, e.g. a string literal or global name.
+    char const* cat;
+    std::string_view fn; // Which function is being compiled, if any.
+    std::int64_t begin; // In microseconds.
+    std::int64_t end;
+    int iter = -1; // Optimization iteration, if any.
+    signed char changed = -1; // If the pass changed the IR, if known.
+};
+
+namespace profile
+{
+    inline bool enabled = false;
+
+    std::int64_t now();
+
+    // Thread-safe.
+    void record(profile_event_t const& event);
+
+    // Writes every event recorded so far.
+    void write(fs::path const& path);
+}
+
+// Records an event spanning its lifetime.
+class profile_scope_t
+{
+public:
+    profile_scope_t(std::string_view name, char const* cat, std::string_view fn = {}, int iter = -1)
+    {
+        if(profile::enabled)
+            m_event = { .name = name, .cat = cat, .fn = fn, .begin = profile::now(), .end = 0, .iter = iter };
+    }
+
+    ~profile_scope_t()
+    {
+        if(profile::enabled && m_event.cat)
+        {
+            m_event.end = profile::now();
+            profile::record(m_event);
+        }
+    }
+
+    profile_scope_t(profile_scope_t const&) = delete;
+    profile_scope_t& operator=(profile_scope_t const&) = delete;
+
+    void set_changed(bool b) { m_event.changed = b; }
+    void set_iter(int iter) { m_event.iter = iter; }
+private:
+    profile_event_t m_event = { .cat = nullptr };
+};
+
+#endif
@@ -12,6 +12,7 @@
 #include "format.hpp"
 #include "hex.hpp"
 #include "asm_proc.hpp"
+#include "asset_cache.hpp"
 #include "eternal_new.hpp"
 #include "thread.hpp"
 
@@ -952,11 +953,14 @@ foundNote:
     return false;
 }
 
-unsigned char mem_rd(unsigned address);
-void mem_wr(unsigned address, unsigned char data);
-
 #include "cpu_2a03.hpp"
 
+struct nsf_bus_t
+{
+    unsigned char mem_rd(unsigned address);
+    void mem_wr(unsigned address, unsigned char data);
+};
+
 std::array<unsigned char, 1 << 16> memory;
 std::array<int, 32> apu_registers;
 std::array<int, 32> prev_apu_registers;
@@ -985,12 +989,12 @@ bool register_allowed(unsigned address)
     }
 }
 
-unsigned char mem_rd(unsigned address)
+unsigned char nsf_bus_t::mem_rd(unsigned address)
 {
     return address < 0x2000 ? memory[address & 0x7FF] : memory[address];
 }
 
-void mem_wr(unsigned address, unsigned char data)
+void nsf_bus_t::mem_wr(unsigned address, unsigned char data)
 {
     // RAM writes:
     if(address < 0x2000)
@@ -1034,11 +1038,9 @@ void mem_wr(unsigned address, unsigned char data)
     }
 }
 
-const_ht convert_effect(pstring_t at,
-                        std::uint8_t const* const nsf_data, std::size_t nsf_size,
-                        nsf_t const& nsf, unsigned song, unsigned mode,
-                        std::deque<nsf_track_t>& nsf_tracks,
-                        std::pair<group_data_t*, group_data_ht> group_pair)
+// Runs the NSF, logging the APU registers each frame until the effect stops.
+static std::vector<std::array<int, 32>> play_effect(std::uint8_t const* const nsf_data, std::size_t nsf_size,
+                                                    nsf_t const& nsf, unsigned song, unsigned mode)
 {
     static TLS std::mutex cpu_mutex;
     std::lock_guard<std::mutex> lock(cpu_mutex);
@@ -1059,34 +1061,60 @@ const_ht convert_effect(pstring_t at,
 
     volume.fill(0);
 
+    nsf_bus_t bus;
+    cpu_2a03_t<nsf_bus_t> cpu(bus);
+
     // Init nsf code.
-    cpu_reset();
-    CPU.A = song;
-    CPU.X = mode;
-    CPU.PC.hl = nsf.init_addr;
+    cpu.reset();
+    cpu.CPU.A = song;
+    cpu.CPU.X = mode;
+    cpu.CPU.PC.hl = nsf.init_addr;
     log_cpu = false;
     for(unsigned i = 0; i < 2000; ++i) 
-        cpu_tick(); // 2000 is enough for FT init
-    cpu_reset();
+        cpu.tick(); // 2000 is enough for FT init
+    cpu.reset();
 
     std::vector<std::array<int, 32>> apu_register_log;
-    std::vector<std::array<int, 4>> volume_log;
 
     log_cpu = true;
 
     for(effect_stop = false; !effect_stop;)
     {
-        CPU.PC.hl = nsf.play_addr;
-        CPU.jam = false;
-        CPU.S = 0xFF;
+        cpu.CPU.PC.hl = nsf.play_addr;
+        cpu.CPU.jam = false;
+        cpu.CPU.S = 0xFF;
 
         for(unsigned i = 0; i < 30000/4 && !effect_stop; ++i)
-            cpu_tick();
+            cpu.tick();
 
         apu_register_log.push_back(apu_registers);
-        volume_log.push_back(volume);
     }
 
+    return apu_register_log;
+}
+
+const_ht convert_effect(pstring_t at,
+                        std::uint8_t const* const nsf_data, std::size_t nsf_size,
+                        nsf_t const& nsf, unsigned song, unsigned mode,
+                        std::deque<nsf_track_t>& nsf_tracks,
+                        std::pair<group_data_t*, group_data_ht> group_pair)
+{
+    // Emulating the NSF is slow, so the register log gets cached.
+    using log_entry_t = std::array<int, 32>;
+    asset_key_t key("puf_sfx");
+    key.bytes(nsf_data, nsf_size).add(song).add(mode);
+
+    asset_cache_t::bytes_t const bytes = asset_cache_t::get(key, [&]
+    {
+        auto const log = play_effect(nsf_data, nsf_size, nsf, song, mode);
+        asset_cache_t::bytes_t bytes(log.size() * sizeof(log_entry_t));
+        std::memcpy(bytes.data(), log.data(), bytes.size());
+        return bytes;
+    });
+
+    std::vector<log_entry_t> apu_register_log(bytes.size() / sizeof(log_entry_t));
+    std::memcpy(apu_register_log.data(), bytes.data(), apu_register_log.size() * sizeof(log_entry_t));
+
     for(unsigned k = 0; k < NUM_SFX_CHAN; ++k)
     {
         asm_proc_t proc;
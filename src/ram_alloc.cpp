@@ -7,6 +7,8 @@
 #include "group.hpp"
 #include "compiler_error.hpp"
 #include "options.hpp"
+#include "ir_algo.hpp"
+#include "pgo.hpp"
 #include "ram.hpp"
 #include "rom.hpp"
 #include "debug_print.hpp"
@@ -32,6 +34,26 @@ zp_request_t zp_request(bool valid, bool only)
     return ZP_NEVER;
 }
 
+// How much is saved by 'inst' if its argument is in zero page.
+// Cycles are weighed by how often 'inst' runs, while bytes are weighed once.
+static std::uint64_t zp_savings(asm_inst_t const& inst, std::uint64_t cycle_weight, std::uint64_t byte_weight)
+{
+    addr_mode_t const zp_mode = zp_equivalent(op_addr_mode(inst.op));
+    if(zp_mode == MODE_BAD)
+        return 0;
+
+    op_t const zp_op = get_op(op_name(inst.op), zp_mode);
+    if(zp_op == BAD_OP)
+        return 0;
+
+    std::uint64_t savings = 0;
+    if(op_cycles(inst.op) > op_cycles(zp_op))
+        savings += (op_cycles(inst.op) - op_cycles(zp_op)) * cycle_weight;
+    if(op_size(inst.op) > op_size(zp_op))
+        savings += (op_size(inst.op) - op_size(zp_op)) * byte_weight;
+    return savings;
+}
+
 // Allocates a span inside 'usable_ram'.
 static span_t alloc_ram(ram_bitset_t const& usable_ram, std::size_t size, zp_request_t zp, 
                         bool insist_alignment = false)
@@ -112,6 +134,14 @@ private:
     template<step_t Step>
     void alloc_locals(romv_t romv, fn_ht h);
 
+    // Fills 'gmember_zp_savings' and each fn's 'zp_savings'.
+    void build_zp_savings();
+
+    // How many bytes of zero page locals should get, such that
+    // the zero page bytes with the most savings are shared between locals and globals.
+    int local_zp_split(int zp_free);
+    int zp_only_bytes(fn_ht fn);
+
     struct group_vars_d
     {
         // Addresses that can be used to allocate globals.
@@ -133,6 +163,17 @@ private:
         // This is used to order in which fn lvars are allocated.
         unsigned lvar_count = 0;
 
+        // Cycles spent in the fn, from the profile.
+        // When profiled, this orders fns ahead of 'lvar_count'.
+        std::uint64_t cycles = 0;
+
+        // Indexed by lvar. With '--zp-cost', how much each lvar saves in zero page.
+        std::vector<std::uint64_t> zp_savings;
+
+        // With '--zp-cost', the zero page bytes that must be reserved
+        // for ZP-only lvars, of this fn and the fns it calls.
+        int zp_only_bytes = -1;
+
         // Addresses that can be used to allocate lvars.
         std::array<ram_bitset_t, NUM_ROMV> usable_ram;
 
@@ -157,6 +198,9 @@ private:
     std::vector<group_vars_d> group_vars_data;
     std::vector<fn_d> fn_data;
 
+    // Keyed by 'mem_head'. With '--zp-cost', how much each gmember saves in zero page.
+    rh::batman_map<locator_t, std::uint64_t> gmember_zp_savings;
+
     // Tracks allocations for an entire mode / nmi.
     // This is used to implement romv.
     std::array<std::vector<ram_bitset_t>, NUM_ROMV> romv_allocated;
@@ -169,17 +213,20 @@ ram_allocator_t::ram_allocator_t(log_t* log, ram_bitset_t const& initial_usable_
 {
     assert(compiler_phase() == PHASE_ALLOC_RAM);
 
+    group_vars_data.resize(group_vars_ht::pool().size());
+    fn_data.resize(fn_ht::pool().size());
+
+    if(compiler_options().zp_cost)
+        build_zp_savings();
+
     // Amount of bytes free in zero page
     int const zp_free = (initial_usable_ram & zp_bitset).popcount();
 
     // Amount of bytes in zp dedicated to locals
-    int const max_local_zp = 32;
+    int const max_local_zp = compiler_options().zp_cost ? local_zp_split(zp_free) : 32;
 
     // Amount of bytes in zp dedicated to gvars
-    int const max_gvar_zp = std::max(zp_free - max_local_zp, zp_free / 2);
-
-    group_vars_data.resize(group_vars_ht::pool().size());
-    fn_data.resize(fn_ht::pool().size());
+    int const max_gvar_zp = compiler_options().zp_cost ? zp_free - max_local_zp : std::max(zp_free - max_local_zp, zp_free / 2);
 
     ///////////////////
     // ALLOC GLOBALS //
@@ -318,20 +365,40 @@ ram_allocator_t::ram_allocator_t(log_t* log, ram_bitset_t const& initial_usable_
         }
 
         // Count how often gmembers appears in emitted code.
-        // We'll eventually allocate using the use count as a heuristic
+        // We'll eventually allocate using the use count as a heuristic.
+        // With a profile, each use is weighed by how often its code ran.
 
-        rh::batman_map<locator_t, unsigned> gmember_count;
+        rh::batman_map<locator_t, std::uint64_t> gmember_count;
         for(gvar_t const& gvar : gvar_ht::values())
             gvar.for_each_locator([&](locator_t loc){ gmember_count.insert({ loc.mem_head(), 0 }); });
 
+        rh::batman_map<unsigned, unsigned> preorder_i;
         for(fn_t const& fn : fn_ht::values())
         {
             rom_proc_t const& rom_proc = fn.rom_proc().safe();
 
+            pgo_fn_t const* pgo = pgo_lookup(fn.global.name);
+            if(pgo && pgo->nodes != fn.cfg_preorder().size())
+                pgo = nullptr;
+
+            if(pgo)
+            {
+                preorder_i.clear();
+                for(unsigned i = 0; i < fn.cfg_preorder().size(); ++i)
+                    preorder_i.insert({ fn.cfg_preorder()[i], i });
+            }
+
+            std::uint64_t weight = 1;
             for(asm_inst_t const& inst : rom_proc.asm_proc().code)
+            {
+                if(pgo && inst.op == ASM_LABEL && inst.arg.lclass() == LOC_CFG_LABEL && inst.arg.data() == 0)
+                    if(unsigned const* i = preorder_i.mapped(inst.arg.handle()))
+                        weight = 1 + pgo->count(*i).value_or(0);
+
                 if(inst.arg.lclass() == LOC_GMEMBER)
-                    if(unsigned* count = gmember_count.mapped(inst.arg.mem_head()))
-                        *count += 1;
+                    if(std::uint64_t* count = gmember_count.mapped(inst.arg.mem_head()))
+                        *count += weight;
+            }
         }
 
         // Find unused variables and issue a warning
@@ -343,7 +410,7 @@ ram_allocator_t::ram_allocator_t(log_t* log, ram_bitset_t const& initial_usable_
             if(is_paa(gvar.type().name()))
                 continue;
 
-            unsigned count = 0;
+            std::uint64_t count = 0;
             gvar.for_each_locator([&](locator_t loc) { count += gmember_count[loc]; });
 
             if(count == 0)
@@ -354,7 +421,7 @@ ram_allocator_t::ram_allocator_t(log_t* log, ram_bitset_t const& initial_usable_
 
         struct rank_t
         {
-            unsigned score;
+            std::uint64_t score;
             locator_t loc;
         };
 
@@ -369,6 +436,7 @@ ram_allocator_t::ram_allocator_t(log_t* log, ram_bitset_t const& initial_usable_
         {
             // Priority 1: gvar size
             // Priority 2: frequency in code
+            // (With a profile, these priorities swap, as the frequency is accurate.)
 
             constexpr unsigned size_scale = 256; // arbitrary constant
 
@@ -383,6 +451,8 @@ ram_allocator_t::ram_allocator_t(log_t* log, ram_bitset_t const& initial_usable_
             }
             else if(pair.first.mem_zp_only())
                 ordered_gmembers_zp.push_back({ pair.first.mem_size(), pair.first });
+            else if(pgo_enabled())
+                non_zp_vec.push_back({ (pair.second * size_scale) + pair.first.mem_size(), pair.first });
             else
                 non_zp_vec.push_back({ (pair.first.mem_size() * size_scale) + pair.second, pair.first });
         }
@@ -446,11 +516,28 @@ ram_allocator_t::ram_allocator_t(log_t* log, ram_bitset_t const& initial_usable_
         for(rank_t const& rank : ordered_gmembers_zp)
             estimate_gmember_loc(rank.loc);
 
-        for(rank_t const& rank : ordered_gmembers)
-            estimate_gmember_loc(rank.loc);
+        if(compiler_options().zp_cost)
+        {
+            // Estimate by savings per byte instead of the allocation order.
+            std::vector<rank_t> by_savings;
+            for(auto const& pair : gmember_zp_savings)
+                if(pair.second && !pair.first.mem_zp_only())
+                    by_savings.push_back({ pair.second / pair.first.mem_size(), pair.first });
 
-        for(rank_t const& rank : ordered_gmembers_aligned)
-            estimate_gmember_loc(rank.loc);
+            std::sort(by_savings.begin(), by_savings.end(), 
+                      [](auto const& lhs, auto const& rhs) { return lhs.score > rhs.score; });
+
+            for(rank_t const& rank : by_savings)
+                estimate_gmember_loc(rank.loc);
+        }
+        else
+        {
+            for(rank_t const& rank : ordered_gmembers)
+                estimate_gmember_loc(rank.loc);
+
+            for(rank_t const& rank : ordered_gmembers_aligned)
+                estimate_gmember_loc(rank.loc);
+        }
 
         // For global vars that have init expressions,
         // we want to allocate their group to be contigious,
@@ -460,7 +547,7 @@ ram_allocator_t::ram_allocator_t(log_t* log, ram_bitset_t const& initial_usable_
 
         struct group_inits_t
         {
-            unsigned score = 0;
+            std::uint64_t score = 0;
             std::vector<locator_t> init;
         };
 
@@ -649,6 +736,9 @@ ram_allocator_t::ram_allocator_t(log_t* log, ram_bitset_t const& initial_usable_
 
             fn_data[fn.id].lvar_count += fn->lvars().num_this_lvars();
 
+            if(pgo_fn_t const* pgo = pgo_lookup(fn->global.name))
+                fn_data[fn.id].cycles = pgo->cycles;
+
             fn->ir_calls().for_each([&](fn_ht call)
             {
                 fn_data[call.id].lvar_count += fn->lvars().num_this_lvars();
@@ -688,10 +778,168 @@ ram_allocator_t::ram_allocator_t(log_t* log, ram_bitset_t const& initial_usable_
     }
 }
 
+void ram_allocator_t::build_zp_savings()
+{
+    // Weights are relative to 'inst_weights', where code running once per call
+    // has a weight of 1, or 'ONCE_WEIGHT' with a profile.
+    std::uint64_t const byte_weight = depth_exp(pgo_enabled());
+
+    for(fn_t const& fn : fn_ht::values())
+        data(fn.handle()).zp_savings.resize(fn.lvars().num_this_lvars(), 0);
+
+    for(gvar_t const& gvar : gvar_ht::values())
+        gvar.for_each_locator([&](locator_t loc){ gmember_zp_savings.insert({ loc.mem_head(), 0 }); });
+
+    for(fn_t const& fn : fn_ht::values())
+    {
+        asm_proc_t const& asm_proc = fn.rom_proc().safe().asm_proc();
+        std::vector<std::uint64_t> const weights = inst_weights(asm_proc);
+
+        // Profiled weights are per call.
+        std::uint64_t calls = 1;
+        if(pgo_fn_t const* pgo = pgo_lookup(fn.global.name))
+            calls = pgo->calls;
+
+        for(unsigned i = 0; i < asm_proc.code.size(); ++i)
+        {
+            asm_inst_t const& inst = asm_proc.code[i];
+            std::uint64_t const savings = zp_savings(inst, weights[i] * calls, byte_weight);
+
+            if(!savings)
+                continue;
+
+            if(inst.arg.lclass() == LOC_GMEMBER)
+            {
+                if(std::uint64_t* s = gmember_zp_savings.mapped(inst.arg.mem_head()))
+                    *s += savings;
+            }
+            else if(has_fn(inst.arg.lclass()))
+            {
+                // Args and returns of called fns belong to the called fn.
+                fn_t const& owner = *inst.arg.fn();
+                int lvar_i = owner.lvars().index(inst.arg);
+
+                if(lvar_i < 0 || unsigned(lvar_i) >= owner.lvars().num_this_lvars())
+                    continue;
+
+                // Pointer hi bytes are allocated with their lo byte.
+                auto const& info = owner.lvars().this_lvar_info(lvar_i);
+                if(info.ptr_hi && info.ptr_alt >= 0)
+                    lvar_i = info.ptr_alt;
+
+                data(owner.handle()).zp_savings[lvar_i] += savings;
+            }
+        }
+    }
+}
+
+int ram_allocator_t::zp_only_bytes(fn_ht fn)
+{
+    fn_d& d = data(fn);
+    if(d.zp_only_bytes >= 0)
+        return d.zp_only_bytes;
+
+    int bytes = 0;
+    fn->ir_calls().for_each([&](fn_ht call)
+    {
+        bytes = std::max(bytes, zp_only_bytes(call));
+    });
+
+    for(unsigned i = 0; i < fn->lvars().num_this_lvars(); ++i)
+    {
+        auto const& info = fn->lvars().this_lvar_info(i);
+        if(info.zp_only && !info.ptr_hi)
+            bytes += info.size;
+    }
+
+    return d.zp_only_bytes = bytes;
+}
+
+int ram_allocator_t::local_zp_split(int const zp_free)
+{
+    // Locals of fns that don't call each other can share the same bytes,
+    // so the n-th byte of local zero page saves the sum of each fn's n-th best lvar.
+    std::vector<std::uint64_t> local_savings;
+    std::vector<std::uint64_t> sorted;
+
+    for(fn_ht fn : fn_ht::handles())
+    {
+        if(fn->fclass == FN_CT)
+            continue;
+
+        sorted.clear();
+        for(unsigned i = 0; i < fn->lvars().num_this_lvars(); ++i)
+        {
+            auto const& info = fn->lvars().this_lvar_info(i);
+            if(info.zp_valid && !info.zp_only && !info.ptr_hi && info.size == 1 && data(fn).zp_savings[i])
+                sorted.push_back(data(fn).zp_savings[i]);
+        }
+
+        std::sort(sorted.begin(), sorted.end(), std::greater<>{});
+
+        if(local_savings.size() < sorted.size())
+            local_savings.resize(sorted.size(), 0);
+        for(unsigned i = 0; i < sorted.size(); ++i)
+            local_savings[i] += sorted[i];
+    }
+
+    // ZP-only lvars have to fit, no matter the savings.
+    // These can't share with the fns they call, nor with an nmi.
+    int reserved = 0;
+    for(fn_t const* mode : global_t::modes())
+    {
+        int bytes = zp_only_bytes(mode->handle());
+        if(fn_ht nmi = mode->mode_nmi())
+            bytes += zp_only_bytes(nmi);
+        reserved = std::max(reserved, bytes);
+    }
+    for(fn_t const* nmi : global_t::nmis())
+        reserved = std::max(reserved, zp_only_bytes(nmi->handle()));
+
+    // Likewise for ZP-only globals:
+    int gmember_reserved = 0;
+    std::vector<std::uint64_t> gmember_savings;
+    for(auto const& pair : gmember_zp_savings)
+    {
+        if(pair.first.mem_zp_only())
+            gmember_reserved += pair.first.mem_size();
+        else if(pair.second && pair.first.mem_zp_valid() && pair.first.mem_size() == 1)
+            gmember_savings.push_back(pair.second);
+    }
+
+    std::sort(gmember_savings.begin(), gmember_savings.end(), std::greater<>{});
+
+    // Greedily take the best bytes of either kind.
+    int const available = zp_free - reserved - gmember_reserved;
+    unsigned local_i = 0;
+    unsigned gmember_i = 0;
+    while(int(local_i + gmember_i) < available)
+    {
+        bool const has_local = local_i < local_savings.size();
+        bool const has_gmember = gmember_i < gmember_savings.size();
+
+        if(has_gmember && (!has_local || gmember_savings[gmember_i] >= local_savings[local_i]))
+            ++gmember_i;
+        else if(has_local)
+            ++local_i;
+        else
+            break;
+    }
+
+    // Unused bytes go to locals, which take whatever zero page globals don't.
+    int const local_zp = std::max(0, zp_free - gmember_reserved - int(gmember_i));
+
+    dprint(log, "RAM_ALLOC_ZP_SPLIT", zp_free, reserved, gmember_reserved, local_i, gmember_i, local_zp);
+
+    return local_zp;
+}
+
 void ram_allocator_t::build_order(romv_t romv, std::vector<fn_ht>& fn_order, std::vector<fn_ht>& input_fns)
 {
     std::sort(input_fns.begin(), input_fns.end(), [&](fn_ht a, fn_ht b)
     {
+        if(data(a).cycles != data(b).cycles)
+            return data(a).cycles > data(b).cycles;
         return data(a).lvar_count > data(b).lvar_count;
     });
 
@@ -796,6 +1044,7 @@ void ram_allocator_t::alloc_locals(romv_t const romv, fn_ht h)
 
     struct rank_t
     {
+        std::int64_t priority; // Only used with '--zp-cost'.
         float score;
         unsigned lvar_i;
         constexpr auto operator<=>(rank_t const&) const = default;
@@ -830,7 +1079,12 @@ void ram_allocator_t::alloc_locals(romv_t const romv, fn_ht h)
         int const interferences = bitset_popcount(fn.lvars().bitset_size(), fn.lvars().lvar_interferences(i));
         float const score = float(usable - int(info.size)) / interferences;
 
-        ordered_lvars.push_back({ score, i });
+        // Allocate the lvars that save the most first, as they'll get zero page.
+        std::int64_t priority = 0;
+        if(compiler_options().zp_cost && info.zp_valid)
+            priority = -std::int64_t(std::min<std::uint64_t>(d.zp_savings[i], INT64_MAX));
+
+        ordered_lvars.push_back({ priority, score, i });
     }
 
     std::sort(ordered_lvars.begin(), ordered_lvars.end());
@@ -942,6 +1196,143 @@ void alloc_ram(log_t* log, ram_bitset_t const& initial)
     ram_allocator_t a(log, initial);
 }
 
+// Sums the sizes of a clique of 'fn's lvars, found greedily.
+// Every lvar in the clique needs its own byte, making this a lower bound.
+// If 'call' is set, only lvars that interfere with it are considered.
+static unsigned lvar_clique_size(fn_t const& fn, fn_ht call = {})
+{
+    auto const& lvars = fn.lvars();
+
+    std::vector<unsigned> candidates;
+    for(unsigned i = 0; i < lvars.num_this_lvars(); ++i)
+    {
+        auto const& info = lvars.this_lvar_info(i);
+        if(info.ptr_hi) // Counted with its lo byte.
+            continue;
+        if(call && !lvars.fn_interferences(i).count(call))
+            continue;
+        candidates.push_back(i);
+    }
+
+    std::sort(candidates.begin(), candidates.end(), [&](unsigned a, unsigned b)
+    {
+        return lvars.this_lvar_info(a).size > lvars.this_lvar_info(b).size;
+    });
+
+    std::vector<unsigned> clique;
+    unsigned size = 0;
+    for(unsigned i : candidates)
+    {
+        bool const interferes = std::all_of(clique.begin(), clique.end(), [&](unsigned j)
+        {
+            return bitset_test(lvars.lvar_interferences(i), j);
+        });
+
+        if(interferes)
+        {
+            clique.push_back(i);
+            size += lvars.this_lvar_info(i).size;
+        }
+    }
+
+    return size;
+}
+
+// A lower bound on the bytes needed by the lvars of 'fn' and the fns it calls.
+static unsigned lvar_lower_bound(fn_ht fn, std::vector<int>& memo)
+{
+    if(memo[fn.id] >= 0)
+        return memo[fn.id];
+
+    unsigned bound = lvar_clique_size(*fn);
+
+    // Lvars live across a call interfere with every lvar of the called fn.
+    fn->ir_calls().for_each([&](fn_ht call)
+    {
+        bound = std::max(bound, lvar_clique_size(*fn, call) + lvar_lower_bound(call, memo));
+    });
+
+    memo[fn.id] = bound;
+    return bound;
+}
+
+static void print_lvar_overlay(std::ostream& o)
+{
+    // The RAM used by each fn's lvars, per romv.
+    std::vector<std::array<ram_bitset_t, NUM_ROMV>> fn_ram(fn_ht::pool().size());
+    ram_bitset_t used = {};
+    unsigned unshared = 0;
+
+    for(fn_t const& fn : fn_ht::values())
+    {
+        if(fn.fclass == FN_CT)
+            continue;
+
+        for(unsigned romv = 0; romv < NUM_ROMV; ++romv)
+        {
+            auto& ram = fn_ram[fn.handle().id][romv];
+            ram.clear_all();
+
+            for(unsigned i = 0; i < fn.lvars().num_this_lvars(); ++i)
+                if(span_t const span = fn.lvar_span(romv_t(romv), i))
+                    ram |= ram_bitset_t::filled(span.addr, span.size);
+
+            used |= ram;
+            unshared += ram.popcount();
+        }
+    }
+
+    std::vector<int> memo(fn_ht::pool().size(), -1);
+    unsigned lower_bound = 0;
+
+    // An nmi interrupts its modes, so its lvars can't overlay theirs.
+    for(fn_t const* mode : global_t::modes())
+    {
+        unsigned bound = lvar_lower_bound(mode->handle(), memo);
+        if(fn_ht nmi = mode->mode_nmi())
+            bound += lvar_lower_bound(nmi, memo);
+        lower_bound = std::max(lower_bound, bound);
+    }
+
+    for(fn_t const* nmi : global_t::nmis())
+        lower_bound = std::max(lower_bound, lvar_lower_bound(nmi->handle(), memo));
+
+    o << "fn RAM overlay:\n\n";
+    o << fmt("  unshared: % bytes\n", unshared);
+    o << fmt("  used: % bytes (saved %)\n", used.popcount(), unshared - used.popcount());
+    o << fmt("  lower bound: % bytes (% above)\n\n", lower_bound, used.popcount() - std::min<unsigned>(used.popcount(), lower_bound));
+
+    for(fn_t const& fn : fn_ht::values())
+    {
+        if(fn.fclass == FN_CT)
+            continue;
+
+        auto const& ram = fn_ram[fn.handle().id];
+
+        unsigned bytes = 0;
+        for(unsigned romv = 0; romv < NUM_ROMV; ++romv)
+            bytes += ram[romv].popcount();
+
+        if(!bytes)
+            continue;
+
+        o << fmt("  %: % bytes (lower bound %)\n", fn.global.name, bytes, lvar_clique_size(fn));
+
+        // Other fns whose lvars share addresses with this fn's lvars.
+        for(fn_t const& other : fn_ht::values())
+        {
+            if(&other == &fn || other.fclass == FN_CT)
+                continue;
+
+            auto const& other_ram = fn_ram[other.handle().id];
+            unsigned const shared = ((ram[ROMV_MODE] | ram[ROMV_NMI]) & (other_ram[ROMV_MODE] | other_ram[ROMV_NMI])).popcount();
+
+            if(shared)
+                o << fmt("    overlays %: % bytes\n", other.global.name, shared);
+        }
+    }
+}
+
 void print_ram(std::ostream& o)
 {
     o << "Global variable RAM:\n\n";
@@ -991,4 +1382,7 @@ void print_ram(std::ostream& o)
             o << '\n';
         });
     }
+
+    o << '\n';
+    print_lvar_overlay(o);
 }
@@ -11,6 +11,43 @@
 #include "eternal_new.hpp"
 #include "span_allocator.hpp"
 #include "debug_print.hpp"
+#include "options.hpp"
+
+namespace
+{
+    // Estimates the cycles lost to page crossings, for '--page-placement'.
+    // Taken branches cost a cycle when their target is on another page,
+    // as do indexed reads of tables which straddle a page boundary.
+    struct page_cost_t
+    {
+        struct branch_t
+        {
+            std::uint16_t from; // Offset of the instruction after the branch.
+            std::uint16_t to;   // Offset of the branch target.
+            std::uint64_t weight;
+        };
+
+        std::vector<branch_t> branches;
+        std::uint64_t read_weight = 0; // Of indexed reads into this data.
+        unsigned size = 0;
+
+        bool empty() const { return branches.empty() && !read_weight; }
+
+        std::uint64_t operator()(std::uint16_t addr) const
+        {
+            std::uint64_t cost = 0;
+
+            for(branch_t const& branch : branches)
+                if(((addr + branch.from) ^ (addr + branch.to)) & 0xFF00)
+                    cost += branch.weight;
+
+            if(size <= 256 && (addr & 0xFF) + size > 256)
+                cost += read_weight;
+
+            return cost;
+        }
+    };
+}
 
 class rom_allocator_t
 {
@@ -44,6 +81,10 @@ private:
 
     log_t* log = nullptr;
 
+    // Indexed by handle id. Empty if not using '--page-placement'.
+    std::vector<page_cost_t> proc_page_costs;
+    std::vector<page_cost_t> array_page_costs;
+
     ///////////////
     // FUNCTIONS //
     ///////////////
@@ -74,8 +115,96 @@ private:
 
     // Allocate a DPCM span
     span_t alloc_dpcm(unsigned size);
+
+    // Builds 'proc_page_costs' and 'array_page_costs'.
+    void build_page_costs();
+
+    // Returns an empty function if 'data' has no page crossings to avoid.
+    placement_cost_t placement_cost(rom_data_ht data) const;
+
+    // Allocates 'size' bytes for 'data', avoiding page crossings if enabled.
+    span_t alloc_span(span_allocator_t& allocator, rom_data_ht data, std::uint16_t size, std::uint16_t alignment) const;
 };
 
+void rom_allocator_t::build_page_costs()
+{
+    proc_page_costs.resize(rom_proc_ht::pool().size());
+    array_page_costs.resize(rom_array_ht::pool().size());
+
+    for(rom_array_ht rom_array : rom_array_ht::handles())
+        array_page_costs[rom_array.id].size = rom_array->data().size();
+
+    for(rom_proc_ht rom_proc : rom_proc_ht::handles())
+    {
+        asm_proc_t const& asm_proc = rom_proc->asm_proc();
+        std::vector<std::uint64_t> const weights = inst_weights(asm_proc);
+
+        std::vector<std::uint16_t> offsets(asm_proc.code.size() + 1);
+        for(unsigned i = 0; i < asm_proc.code.size(); ++i)
+            offsets[i + 1] = offsets[i] + op_size(asm_proc.code[i].op);
+
+        page_cost_t& cost = proc_page_costs[rom_proc.id];
+        cost.size = rom_proc->max_size();
+
+        for(unsigned i = 0; i < asm_proc.code.size(); ++i)
+        {
+            asm_inst_t const& inst = asm_proc.code[i];
+
+            switch(op_addr_mode(inst.op))
+            {
+            case MODE_RELATIVE:
+                if(is_label(inst.arg.lclass()))
+                    if(auto const* info = asm_proc.lookup_label(inst.arg))
+                        cost.branches.push_back({ offsets[i + 1], offsets[info->index], weights[i] });
+                break;
+
+            case MODE_ABSOLUTE_X:
+            case MODE_ABSOLUTE_Y:
+                if(op_output_regs(inst.op) & REGF_M)
+                    break; // Writes always take the extra cycle.
+                if(rom_data_ht const data = inst.arg.rom_data())
+                    if(data.rclass() == ROMD_ARRAY)
+                        array_page_costs[data.handle()].read_weight += weights[i];
+                break;
+
+            default:
+                break;
+            }
+        }
+    }
+}
+
+placement_cost_t rom_allocator_t::placement_cost(rom_data_ht data) const
+{
+    page_cost_t const* cost = nullptr;
+
+    switch(data.rclass())
+    {
+    case ROMD_PROC:
+        if(data.handle() < proc_page_costs.size())
+            cost = &proc_page_costs[data.handle()];
+        break;
+    case ROMD_ARRAY:
+        if(data.handle() < array_page_costs.size())
+            cost = &array_page_costs[data.handle()];
+        break;
+    default:
+        break;
+    }
+
+    if(!cost || cost->empty())
+        return {};
+
+    return [cost](std::uint16_t addr) { return (*cost)(addr); };
+}
+
+span_t rom_allocator_t::alloc_span(span_allocator_t& allocator, rom_data_ht data, std::uint16_t size, std::uint16_t alignment) const
+{
+    if(placement_cost_t const cost = placement_cost(data))
+        return allocator.alloc_cheapest(size, alignment, cost);
+    return allocator.alloc(size, alignment);
+}
+
 rom_allocator_t::rom_allocator_t(log_t* log, span_allocator_t& allocator, unsigned num_banks)
 : initial_span(allocator.initial())
 , log(log)
@@ -109,6 +238,9 @@ rom_allocator_t::rom_allocator_t(log_t* log, span_allocator_t& allocator, unsign
         }
     }
 
+    if(compiler_options().page_placement)
+        build_page_costs();
+
     //////////////////////////
     // Convert 'rom_array's //
     //////////////////////////
@@ -178,7 +310,7 @@ rom_allocator_t::rom_allocator_t(log_t* log, span_allocator_t& allocator, unsign
         }
         else if(rom_array.rule() == ROMR_STATIC)
         {
-            span_t const span = allocator.alloc(rom_array.data().size(), alignment);
+            span_t const span = alloc_span(allocator, rom_array_h, rom_array.data().size(), alignment);
             if(!span)
                 throw std::runtime_error("Unable to allocate ROM (out of ROM space).");
             rom_array.set_alloc(ROMV_MODE, rom_static_ht::pool_make(ROMV_MODE, span, rom_array_h), rom_key_t());
@@ -522,7 +654,7 @@ void rom_allocator_t::alloc(rom_once_ht once_h)
         
         // If we succeeded in allocating manys, try to allocate 'once's span:
         // (conditional has side effect assignment)
-        if(!allocated_manys || !(once.span = bank.allocator.alloc(once.data.max_size(), once.desired_alignment)))
+        if(!allocated_manys || !(once.span = alloc_span(bank.allocator, once.data, once.data.max_size(), once.desired_alignment)))
         {
             // If we fail, free allocated 'many' memory.
             for(rom_many_ht many_h : realloced_manys)
@@ -632,7 +764,12 @@ bool rom_allocator_t::realloc_many(rom_many_ht many_h, bank_bitset_t in_banks)
     span_t const range = { max_start, min_end - max_start };
     span_t alloc_at;
 
-    if(!(alloc_at = aligned(range, many.data.max_size(), many.desired_alignment)))
+    if(placement_cost_t const cost = placement_cost(many.data))
+        alloc_at = cheapest_placement(range, many.data.max_size(), many.desired_alignment, cost);
+    else
+        alloc_at = aligned(range, many.data.max_size(), many.desired_alignment);
+
+    if(!alloc_at)
         return false;
 
     // Now allocate in each bank:
@@ -664,6 +801,8 @@ void print_rom(std::ostream& o)
 {
     o << "ROM:\n\n";
 
+    o << "MULTIPLY " << (compiler_options().mul_impl == MUL_TABLE ? "table" : "shift") << "\n\n";
+
     for(auto const& st : rom_static_ht::values())
         o << "STATIC " << st.span << '\n';
     for(auto const& many : rom_many_ht::values())
@@ -85,6 +85,10 @@ ram_bitset_t alloc_runtime_ram()
     if(compiler_options().nes_system == NES_SYSTEM_DETECT)
         _rtram_spans[RTRAM_system] = {{ a.alloc_zp(1) }};
 
+    // Four pointers into the quarter-square tables. See 'make_mul8_table'.
+    if(compiler_options().mul_impl == MUL_TABLE)
+        _rtram_spans[RTRAM_mul_ptrs] = {{ a.alloc_zp(8), a.alloc_zp(8) }};
+
     return a.allocated;
 }
 
@@ -196,11 +200,15 @@ static asm_proc_t make_nmi()
     proc.push_inst(STX_ABSOLUTE, locator_t::runtime_ram(RTRAM_nmi_saved_x));
     proc.push_inst(STY_ABSOLUTE, locator_t::runtime_ram(RTRAM_nmi_saved_y));
 
+    // This proc belongs to the mode, but it can interrupt code using the mode's 'ptr_temp'.
+    // Use the NMI's instead.
+    span_t const ptr_temp = runtime_span(RTRAM_ptr_temp, ROMV_NMI);
+
     proc.push_inst(LDY_ABSOLUTE, locator_t::runtime_ram(RTRAM_nmi_index));
     proc.push_inst(LDA_ABSOLUTE_Y, locator_t::runtime_rom(RTROM_nmi_lo_table));
-    proc.push_inst(STA_ABSOLUTE, locator_t::runtime_ram(RTRAM_ptr_temp, 0));
+    proc.push_inst(STA_ABSOLUTE, locator_t::addr(ptr_temp.addr));
     proc.push_inst(LDA_ABSOLUTE_Y, locator_t::runtime_rom(RTROM_nmi_hi_table));
-    proc.push_inst(STA_ABSOLUTE, locator_t::runtime_ram(RTRAM_ptr_temp, 1));
+    proc.push_inst(STA_ABSOLUTE, locator_t::addr(ptr_temp.addr + 1));
 
     if(mapper().bankswitches())
     {
@@ -217,7 +225,7 @@ static asm_proc_t make_nmi()
             proc.push_inst(STA_ABSOLUTE, locator_t::addr(addr));
     }
 
-    proc.push_inst(JMP_INDIRECT, locator_t::runtime_ram(RTRAM_ptr_temp));
+    proc.push_inst(JMP_INDIRECT, locator_t::addr(ptr_temp.addr));
 
     proc.initial_optimize();
     return proc;
@@ -386,6 +394,21 @@ static asm_proc_t make_reset_proc()
         proc.push_inst(STA_ABSOLUTE, locator_t::addr(PPUMASK));
     }
 
+    // Point the multiplication pointers at their tables.
+    // Only the low bytes change after this.
+    if(compiler_options().mul_impl == MUL_TABLE)
+    {
+        constexpr runtime_rom_name_t tables[] = { RTROM_sq1_lo, RTROM_sq2_lo, RTROM_sq1_hi, RTROM_sq2_hi };
+
+        for(unsigned i = 0; i < 4; ++i)
+        {
+            proc.push_inst(LDA_IMMEDIATE, locator_t::runtime_rom(tables[i]).with_is(IS_PTR_HI));
+            for(unsigned romv = 0; romv < NUM_ROMV; ++romv)
+                if(span_t const span = runtime_span(RTRAM_mul_ptrs, romv_t(romv)))
+                    proc.push_inst(STA_ZERO_PAGE, locator_t::addr(span.addr + i*2 + 1));
+        }
+    }
+
     // Init the NMI index
     proc.push_inst(LDA_IMMEDIATE, locator_t::nmi_index(main.mode_nmi()));
     proc.push_inst(STA_ABSOLUTE, locator_t::runtime_ram(RTRAM_nmi_index));
@@ -491,6 +514,158 @@ asm_proc_t make_mul8()
     return proc;
 }
 
+// Multiplies using a table of quarter squares, using the identity:
+//   a*b = f(a+b) - f(b-a), where f(x) = floor(x*x/4)
+// 'RTRAM_mul_ptrs' holds four pointers, whose high bytes point to the tables.
+// Storing 'a' (or its complement) in the low bytes lets 'b' index f(a+b) and f(b-a).
+// @param A one factor
+// @param Y another factor
+// @return low 8 bits in A; high 8 bits in Y
+asm_proc_t make_mul8_table()
+{
+    asm_proc_t proc;
+
+    locator_t const sq1_lo = locator_t::runtime_ram(RTRAM_mul_ptrs, 0);
+    locator_t const sq2_lo = locator_t::runtime_ram(RTRAM_mul_ptrs, 2);
+    locator_t const sq1_hi = locator_t::runtime_ram(RTRAM_mul_ptrs, 4);
+    locator_t const sq2_hi = locator_t::runtime_ram(RTRAM_mul_ptrs, 6);
+
+    proc.push_inst(STA_ZERO_PAGE, sq1_lo);
+    proc.push_inst(STA_ZERO_PAGE, sq1_hi);
+    proc.push_inst(EOR_IMMEDIATE, locator_t::const_byte(0xFF));
+    proc.push_inst(STA_ZERO_PAGE, sq2_lo);
+    proc.push_inst(STA_ZERO_PAGE, sq2_hi);
+    proc.push_inst(SEC_IMPLIED);
+    proc.push_inst(LDA_INDIRECT_Y, sq1_lo);
+    proc.push_inst(SBC_INDIRECT_Y, sq2_lo);
+    proc.push_inst(STA_ZERO_PAGE, sq1_lo); // The pointer gets rewritten next call, so it's free to use.
+    proc.push_inst(LDA_INDIRECT_Y, sq1_hi);
+    proc.push_inst(SBC_INDIRECT_Y, sq2_hi);
+    proc.push_inst(TAY_IMPLIED);
+    proc.push_inst(LDA_ZERO_PAGE, sq1_lo);
+    proc.push_inst(RTS_IMPLIED);
+
+    proc.initial_optimize();
+    return proc;
+}
+
+// Like 'make_mul8_table', but multiplies a 16-bit number by an 8-bit one.
+// @param A the 8-bit factor
+// @param X low 8 bits of the 16-bit factor
+// @param Y high 8 bits of the 16-bit factor
+// @return bits 0-7 in X; bits 8-15 in Y; bits 16-23 in A
+asm_proc_t make_mul16x8()
+{
+    asm_proc_t proc;
+
+    locator_t const sq1_lo = locator_t::runtime_ram(RTRAM_mul_ptrs, 0);
+    locator_t const sq2_lo = locator_t::runtime_ram(RTRAM_mul_ptrs, 2);
+    locator_t const sq1_hi = locator_t::runtime_ram(RTRAM_mul_ptrs, 4);
+    locator_t const sq2_hi = locator_t::runtime_ram(RTRAM_mul_ptrs, 6);
+    locator_t const temp_lo = locator_t::runtime_ram(RTRAM_ptr_temp, 0);
+    locator_t const temp_hi = locator_t::runtime_ram(RTRAM_ptr_temp, 1);
+
+    proc.push_inst(STA_ZERO_PAGE, sq1_lo);
+    proc.push_inst(STA_ZERO_PAGE, sq1_hi);
+    proc.push_inst(EOR_IMMEDIATE, locator_t::const_byte(0xFF));
+    proc.push_inst(STA_ZERO_PAGE, sq2_lo);
+    proc.push_inst(STA_ZERO_PAGE, sq2_hi);
+
+    // Multiply by the high byte first, saving the product:
+    proc.push_inst(SEC_IMPLIED);
+    proc.push_inst(LDA_INDIRECT_Y, sq1_lo);
+    proc.push_inst(SBC_INDIRECT_Y, sq2_lo);
+    proc.push_inst(STA_ZERO_PAGE, temp_lo);
+    proc.push_inst(LDA_INDIRECT_Y, sq1_hi);
+    proc.push_inst(SBC_INDIRECT_Y, sq2_hi);
+    proc.push_inst(STA_ZERO_PAGE, temp_hi);
+
+    // Then the low byte:
+    proc.push_inst(TXA_IMPLIED);
+    proc.push_inst(TAY_IMPLIED);
+    proc.push_inst(SEC_IMPLIED);
+    proc.push_inst(LDA_INDIRECT_Y, sq1_lo);
+    proc.push_inst(SBC_INDIRECT_Y, sq2_lo);
+    proc.push_inst(TAX_IMPLIED);
+    proc.push_inst(LDA_INDIRECT_Y, sq1_hi);
+    proc.push_inst(SBC_INDIRECT_Y, sq2_hi);
+
+    // Sum the two:
+    proc.push_inst(CLC_IMPLIED);
+    proc.push_inst(ADC_ZERO_PAGE, temp_lo);
+    proc.push_inst(TAY_IMPLIED);
+    proc.push_inst(LDA_ZERO_PAGE, temp_hi);
+    proc.push_inst(ADC_IMMEDIATE, locator_t::const_byte(0));
+    proc.push_inst(RTS_IMPLIED);
+
+    proc.initial_optimize();
+    return proc;
+}
+
+// Quarter squares for 'make_mul8_table' and 'make_mul16x8'.
+// Entry 'i' holds floor(x*x/4), where x = i - 'bias'.
+static loc_vec_t make_sq_table(int bias, bool hi)
+{
+    loc_vec_t ret;
+    ret.reserve(512);
+    for(int i = 0; i < 512; ++i)
+    {
+        int const x = i - bias;
+        unsigned const sq = unsigned(x * x) / 4;
+        ret.push_back(locator_t::const_byte(hi ? (sq >> 8) : (sq & 0xFF)));
+    }
+    return ret;
+}
+
+unsigned mul8_cycles()
+{
+    return compiler_options().mul_impl == MUL_TABLE ? 52 : 112;
+}
+
+// Unrolled restoring division.
+// @param A dividend
+// @param Y divisor
+// @return quotient in A; remainder in Y
+// Dividing by zero returns $FF in A.
+asm_proc_t make_div8()
+{
+    asm_proc_t proc;
+
+    unsigned next_label_id = 0;
+
+    locator_t const quotient = locator_t::runtime_ram(RTRAM_ptr_temp, 0);
+    locator_t const divisor = locator_t::runtime_ram(RTRAM_ptr_temp, 1);
+
+    // 'quotient' starts as the dividend, which gets shifted out as the quotient is shifted in.
+    proc.push_inst(STY_ABSOLUTE, divisor);
+    proc.push_inst(ASL_IMPLIED);
+    proc.push_inst(STA_ABSOLUTE, quotient);
+    proc.push_inst(LDA_IMMEDIATE, locator_t::const_byte(0));
+
+    for(unsigned i = 0; i < 8; ++i)
+    {
+        locator_t const subtract = proc.make_label(++next_label_id);
+        locator_t const next = proc.make_label(++next_label_id);
+
+        proc.push_inst(ROL_IMPLIED);
+        proc.push_inst(BCS_RELATIVE, subtract); // The remainder overflowed, so it's definitely bigger.
+        proc.push_inst(CMP_ZERO_PAGE, divisor);
+        proc.push_inst(BCC_RELATIVE, next);
+        proc.push_inst(ASM_LABEL, subtract);
+        proc.push_inst(SBC_ZERO_PAGE, divisor);
+        proc.push_inst(SEC_IMPLIED);
+        proc.push_inst(ASM_LABEL, next);
+        proc.push_inst(ROL_ZERO_PAGE, quotient);
+    }
+
+    proc.push_inst(TAY_IMPLIED);
+    proc.push_inst(LDA_ZERO_PAGE, quotient);
+    proc.push_inst(RTS_IMPLIED);
+
+    proc.initial_optimize();
+    return proc;
+}
+
 static loc_vec_t make_iota()
 {
     loc_vec_t ret;
@@ -584,7 +759,23 @@ span_allocator_t alloc_runtime_rom()
 
     alloc(RTROM_jsr_y_trampoline, make_bnrom_jsr_y_trampoline(), ROMVF_ALL);
     alloc(RTROM_jmp_y_trampoline, make_bnrom_jmp_y_trampoline(), ROMVF_ALL);
-    alloc(RTROM_mul8, make_mul8(), ROMVF_ALL);
+    if(compiler_options().mul_impl == MUL_TABLE)
+        alloc(RTROM_mul8, make_mul8_table(), ROMVF_ALL);
+    else
+        alloc(RTROM_mul8, make_mul8(), ROMVF_ALL);
+    alloc(RTROM_div8, make_div8(), ROMVF_ALL);
+
+    if(compiler_options().mul_impl == MUL_TABLE)
+    {
+        alloc(RTROM_mul16x8, make_mul16x8(), ROMVF_ALL);
+
+        // Each table spans two pages, and is page-aligned
+        // so that the low byte of each pointer is an offset into it.
+        alloc(RTROM_sq1_lo, make_sq_table(0, false), ROMVF_IN_MODE, 256);
+        alloc(RTROM_sq1_hi, make_sq_table(0, true), ROMVF_IN_MODE, 256);
+        alloc(RTROM_sq2_lo, make_sq_table(255, false), ROMVF_IN_MODE, 256);
+        alloc(RTROM_sq2_hi, make_sq_table(255, true), ROMVF_IN_MODE, 256);
+    }
 
     auto tables = make_nmi_tables();
     alloc(RTROM_nmi_lo_table, std::move(tables.lo), ROMVF_IN_MODE, tables.alignment);
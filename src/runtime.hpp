@@ -24,6 +24,7 @@ RT(nmi_counter) \
 RT(nmi_ready) \
 RT(mapper_state) \
 RT(system) \
+RT(mul_ptrs) \
 
 enum runtime_ram_name_t : std::uint16_t
 {
@@ -46,7 +47,13 @@ RT(reset) \
 RT(jmp_y_trampoline) \
 RT(jsr_y_trampoline) \
 RT(iota) \
-RT(mul8) 
+RT(mul8) \
+RT(div8) \
+RT(mul16x8) \
+RT(sq1_lo) \
+RT(sq1_hi) \
+RT(sq2_lo) \
+RT(sq2_hi) 
 
 enum runtime_rom_name_t : std::uint16_t
 {
@@ -56,6 +63,9 @@ RTROM_X
     NUM_RTROM,
 };
 
+// Typical cycles spent inside 'RTROM_mul8', for estimating costs.
+unsigned mul8_cycles();
+
 ram_bitset_t alloc_runtime_ram();
 span_allocator_t alloc_runtime_rom();
 
@@ -67,6 +67,43 @@ span_t span_allocator_t::alloc_linear(std::uint16_t size, std::uint16_t alignmen
     return {};
 }
 
+span_t span_allocator_t::alloc_cheapest(std::uint16_t size, std::uint16_t alignment, placement_cost_t const& cost)
+{
+    if(treap.empty())
+        return {};
+
+    if(!size)
+        size = 1;
+
+    // Start with what 'alloc' would pick:
+    auto best_it = treap.top();
+    span_t best = {};
+    std::uint64_t best_cost = ~0ull;
+
+    if(best_it->span.size >= size && (best = aligned(best_it->span, size, alignment)))
+        best_cost = cost(best.addr);
+
+    for(auto it = treap.begin(); best_cost && it != treap.end(); ++it)
+    {
+        if(it->span.size < size)
+            continue;
+
+        std::uint64_t span_cost;
+        span_t const span = cheapest_placement(it->span, size, alignment, cost, &span_cost);
+        if(span && span_cost < best_cost)
+        {
+            best_it = it;
+            best = span;
+            best_cost = span_cost;
+        }
+    }
+
+    if(!best)
+        return {};
+
+    return did_alloc(best_it, best);
+}
+
 void span_allocator_t::free(span_t span)
 {
     if(!span.size)
@@ -177,3 +214,38 @@ span_t span_allocator_t::unallocated_span_at(std::uint16_t addr) const
 
     return {};
 }
+
+span_t cheapest_placement(span_t range, std::uint16_t size, std::uint16_t alignment, 
+                          placement_cost_t const& cost, std::uint64_t* cost_out)
+{
+    span_t best = {};
+    std::uint64_t best_cost = ~0ull;
+
+    auto const consider = [&](span_t span)
+    {
+        // Tiny gaps get merged into the allocation, which would move it.
+        if(!span || (span.addr != range.addr && span.addr - range.addr < span_allocator_t::min_alloc_size))
+            return;
+
+        std::uint64_t const span_cost = cost(span.addr);
+        if(span_cost < best_cost)
+        {
+            best = span;
+            best_cost = span_cost;
+        }
+    };
+
+    consider(aligned(range, size, alignment));
+    consider(aligned_reverse(range, size, alignment));
+
+    // Try starting and ending on each page boundary:
+    for(unsigned page = (range.addr + 0xFF) & ~0xFFu; page <= range.end() && best_cost; page += 0x100)
+    {
+        consider(aligned({ .addr = std::uint16_t(page), .size = std::uint16_t(range.end() - page) }, size, alignment));
+        consider(aligned_reverse({ .addr = range.addr, .size = std::uint16_t(page - range.addr) }, size, alignment));
+    }
+
+    if(cost_out)
+        *cost_out = best_cost;
+    return best;
+}
@@ -2,6 +2,7 @@
 #define SPAN_ALLOCATOR_HPP
 
 #include <cstdint>
+#include <functional>
 
 #include <boost/intrusive/treap_set.hpp>
 
@@ -26,6 +27,9 @@ inline constexpr bool priority_order(treap_node_t const& lhs, treap_node_t const
     return lhs.span.size > rhs.span.size;
 }
 
+// Estimates the cost of placing data at an address.
+using placement_cost_t = std::function<std::uint64_t(std::uint16_t addr)>;
+
 // Allocates spans inside a larger set of spans.
 // Created to allocate ROM.
 
@@ -86,6 +90,10 @@ public:
 
     span_t alloc_linear(std::uint16_t size, std::uint16_t alignment = 1, unsigned after = 0);
 
+    // Like 'alloc', but searches every free span for the placement with the lowest 'cost'.
+    // Ties go to the placement 'alloc' would pick.
+    span_t alloc_cheapest(std::uint16_t size, std::uint16_t alignment, placement_cost_t const& cost);
+
     void free(span_t span);
 
     span_t unallocated_span_at(std::uint16_t addr) const;
@@ -115,8 +123,20 @@ private:
         }
 
         assert(free_count == m_bytes_free);
+// Finds the placement of 'size' bytes in 'range' with the lowest 'cost'.
+// Only the ends of 'range' and its page boundaries are tried, to limit fragmentation.
+// Ties go to the earliest address.
+span_t cheapest_placement(span_t range, std::uint16_t size, std::uint16_t alignment, 
+                          placement_cost_t const& cost, std::uint64_t* cost_out = nullptr);
+
 #endif
     }
 };
 
+// Finds the placement of 'size' bytes in 'range' with the lowest 'cost'.
+// Only the ends of 'range' and its page boundaries are tried, to limit fragmentation.
+// Ties go to the earliest address.
+span_t cheapest_placement(span_t range, std::uint16_t size, std::uint16_t alignment, 
+                          placement_cost_t const& cost, std::uint64_t* cost_out = nullptr);
+
 #endif
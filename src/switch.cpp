@@ -37,7 +37,59 @@ bool switch_partial_to_full(ssa_node_t& switch_node)
     return true;
 }
 
-bool switch_partial_to_full(ir_t& ir)
+// Replaces the SSA_switch_partial ending 'switch_cfg' with a chain of equality tests.
+static void switch_partial_to_chain(ir_t& ir, cfg_ht switch_cfg)
+{
+    ssa_ht const branch = switch_cfg->last_daisy();
+    assert(branch && branch->op() == SSA_switch_partial);
+
+    unsigned const input_size = branch->input_size();
+    assert(input_size == switch_cfg->output_size());
+    assert(input_size > 1);
+
+    cfg_ht const entry = ir.emplace_cfg();
+    cfg_ht current_cfg = entry;
+
+    ssa_value_t condition = branch->input(0);
+    if(condition.type() != TYPE_U)
+        condition = current_cfg->emplace_ssa(SSA_cast, TYPE_U, condition);
+
+    for(unsigned i = 1; i < input_size; ++i)
+    {
+        ssa_value_t const case_value(std::uint8_t(branch->input(i).whole()), TYPE_U);
+        ssa_ht const eq = current_cfg->emplace_ssa(SSA_eq, TYPE_BOOL, condition, case_value);
+        ssa_ht const if_ = current_cfg->emplace_ssa(SSA_if, TYPE_VOID, eq);
+        if_->append_daisy();
+
+        // False leads to the next test, or to the default case after the last one:
+        if(i + 1 < input_size)
+        {
+            cfg_ht const next_cfg = ir.emplace_cfg();
+            current_cfg->link_append_output(next_cfg, [](ssa_ht){ assert(false); return ssa_value_t(); });
+        }
+        else
+        {
+            current_cfg->link_append_output(switch_cfg->output(0), [&](ssa_ht phi)
+            {
+                return phi->input(switch_cfg->output_edge(0).index);
+            });
+        }
+
+        // True leads to the case:
+        current_cfg->link_append_output(switch_cfg->output(i), [&](ssa_ht phi)
+        {
+            return phi->input(switch_cfg->output_edge(i).index);
+        });
+
+        current_cfg = current_cfg->output(0);
+    }
+
+    switch_cfg->link_clear_outputs();
+    switch_cfg->prune_ssa(branch);
+    switch_cfg->link_append_output(entry, [](ssa_ht){ assert(false); return ssa_value_t(); });
+}
+
+bool switch_partial_to_full(ir_t& ir, bool for_size)
 {
     bool updated = false;
 
@@ -110,6 +162,23 @@ bool switch_partial_to_full(ir_t& ir)
         // Calculate
         auto const rep = calc_rep(cases);
 
+        if(for_size)
+        {
+            // Estimate the bytes of a jump table (including its range check),
+            // versus a CMP and BEQ per case:
+            unsigned const slots = ((rep.size - 1) >> rep.rshift) + 1;
+            unsigned const table_bytes = 17 + (rep.rshift * 3) + (slots * 2);
+            unsigned const chain_bytes = (rep.popcount * 4) + 3;
+
+            if(chain_bytes < table_bytes)
+            {
+                switch_partial_to_chain(ir, cfg_it);
+                ir.assert_valid();
+                updated = true;
+                continue;
+            }
+        }
+
         // Transform the branch.
 
         cfg_ht const default_cfg = cfg_it->output(0); // Where the 'default' case leads.
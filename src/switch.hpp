@@ -17,8 +17,9 @@ class ssa_node_t;
 bool switch_partial_to_full(ssa_node_t& switch_node);
 
 // Converts every SSA_switch_partial node to SSA_switch_full.
+// If 'for_size' is set, switches that are smaller as comparison chains become those instead.
 // Return 'true' if any node updated.
-bool switch_partial_to_full(ir_t& ir);
+bool switch_partial_to_full(ir_t& ir, bool for_size);
 
 using switch_table_t = std::vector<locator_t>;
 
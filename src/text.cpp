@@ -1,11 +1,17 @@
 #include "text.hpp"
 
 #include <charconv>
+#include <filesystem>
+#include <fstream>
+#include <numeric>
+#include <queue>
 
 #include "compiler_error.hpp"
 #include "globals.hpp"
 #include "group.hpp"
+#include "options.hpp"
 #include "rom.hpp"
+#include "thread.hpp"
 
 string_literal_manager_t sl_manager;
 
@@ -238,6 +244,52 @@ std::pair<ct_array_t, unsigned> string_literal_manager_t::get_byte_pairs(global_
     return { std::move(array), 1 };
 }
 
+template<typename T>
+static std::pair<ct_array_t, unsigned> to_ct_array(std::vector<T> const& vec, type_name_t type)
+{
+    if(vec.empty())
+    {
+        ct_array_t array = make_ct_array(1);
+        array[0] = ssa_value_t(0, type);
+        return { std::move(array), 1 };
+    }
+
+    ct_array_t array = make_ct_array(vec.size());
+    for(unsigned i = 0; i < vec.size(); ++i)
+        array[i] = ssa_value_t(unsigned(vec[i]), type);
+    return { std::move(array), vec.size() };
+}
+
+std::pair<ct_array_t, unsigned> string_literal_manager_t::get_flat(global_t const* charmap)
+{
+    assert(compiler_phase() > PHASE_COMPRESS_STRINGS);
+    assert(charmap);
+
+    if(auto* result = m_map.mapped(charmap))
+        return to_ct_array(result->flat, TYPE_U);
+    return to_ct_array(std::vector<std::uint8_t>(), TYPE_U);
+}
+
+std::pair<ct_array_t, unsigned> string_literal_manager_t::get_flat_offsets(global_t const* charmap)
+{
+    assert(compiler_phase() > PHASE_COMPRESS_STRINGS);
+    assert(charmap);
+
+    if(auto* result = m_map.mapped(charmap))
+        return to_ct_array(result->flat_offsets, TYPE_U20);
+    return to_ct_array(std::vector<std::uint16_t>(), TYPE_U20);
+}
+
+std::pair<ct_array_t, unsigned> string_literal_manager_t::get_flat_lengths(global_t const* charmap)
+{
+    assert(compiler_phase() > PHASE_COMPRESS_STRINGS);
+    assert(charmap);
+
+    if(auto* result = m_map.mapped(charmap))
+        return to_ct_array(result->flat_lengths, TYPE_U);
+    return to_ct_array(std::vector<std::uint8_t>(), TYPE_U);
+}
+
 // Single-threaded
 void string_literal_manager_t::convert_all()
 {
@@ -251,13 +303,35 @@ void string_literal_manager_t::convert_all()
     }
 }
 
-// Single-threaded
 void string_literal_manager_t::compress_all()
 {
     assert(compiler_phase() == PHASE_COMPRESS_STRINGS);
 
-    for(auto& i : m_map)
-        compress(i.first->impl<charmap_t>(), i.second);
+    // Each charmap compresses independently, so they can run in parallel.
+    std::atomic<unsigned> next_i = 0;
+    parallelize(compiler_options().num_threads,
+    [&](std::atomic<bool>& exception_thrown)
+    {
+        while(!exception_thrown)
+        {
+            unsigned const i = next_i++;
+            if(i >= m_map.size())
+                return;
+
+            auto& pair = m_map.begin()[i];
+            charmap_t const& charmap = pair.first->impl<charmap_t>();
+            compress(charmap, pair.second);
+            if(mod_test(charmap.mods(), MOD_flat))
+                flatten(charmap, pair.second);
+        }
+    }, []{});
+
+    for(auto const& pair : m_map)
+    {
+        charmap_t const& charmap = pair.first->impl<charmap_t>();
+        if(compiler_options().ir_info || mod_test(charmap.mods(), MOD_info))
+            write_info(charmap, pair.second);
+    }
 }
 
 void string_literal_manager_t::convert(charmap_t const& charmap, charmap_info_t& info)
@@ -300,6 +374,12 @@ void string_literal_manager_t::convert(charmap_t const& charmap, charmap_info_t&
 
 void string_literal_manager_t::compress(charmap_t const& charmap, charmap_info_t& info)
 {
+    // Uses Re-Pair, replacing the most common pair of bytes with a new byte, repeatedly.
+    // Rather than rescanning every string each round, the occurrences of each pair are
+    // tracked, and only those around each replacement get updated.
+    //
+    // Pairs are counted including overlaps, and ties go to the pair that occurs first.
+
     assert(compiler_phase() == PHASE_COMPRESS_STRINGS);
 
     assert(info.byte_pairs.empty());
@@ -307,12 +387,125 @@ void string_literal_manager_t::compress(charmap_t const& charmap, charmap_info_t
     unsigned const offset = charmap.size();
     unsigned const max_byte_pairs = 256 - offset;
 
-    // Counts how often each byte_pair appears:
-    rh::batman_map<byte_pair_t, unsigned> pair_map;
+    // Every string gets concatenated into 'bytes', linked into lists.
+    // Replacing a pair keeps its first byte, and unlinks the second.
+    constexpr int NONE = -1;
+    std::vector<std::uint8_t> bytes;
+    std::vector<int> prev;
+    std::vector<int> next;
+    std::vector<int> starts;
+
+    for(auto const& p : info.compressed)
+    {
+        std::string const& str = p.first;
+        int const start = bytes.size();
+        starts.push_back(start);
+
+        for(unsigned i = 0; i < str.size(); ++i)
+        {
+            bytes.push_back(str[i]);
+            prev.push_back(i == 0 ? NONE : start + i - 1);
+            next.push_back(i + 1 == str.size() ? NONE : start + i + 1);
+        }
+    }
+
+    auto const pair_key = [&](int i) -> unsigned
+    {
+        assert(next[i] != NONE);
+        return bytes[i] | (bytes[next[i]] << 8);
+    };
+
+    // The positions each pair occurs at are kept in a linked list, in order.
+    // As every pair added during a round contains the new byte,
+    // and these get added left to right, appending keeps the lists in order.
+    std::vector<int> occ_prev(bytes.size(), NONE);
+    std::vector<int> occ_next(bytes.size(), NONE);
+    std::vector<int> heads(1 << 16, NONE);
+    std::vector<int> tails(1 << 16, NONE);
+    std::vector<unsigned> counts(1 << 16, 0);
+
+    // Pairs, ordered most common first, then by first occurrence.
+    // Rather than updating entries in place, new ones get pushed, and stale ones are skipped.
+    struct queued_t
+    {
+        unsigned count;
+        int first;
+        unsigned key;
+
+        bool operator<(queued_t const& o) const
+        {
+            if(count != o.count)
+                return count < o.count;
+            return first > o.first;
+        }
+    };
+    std::priority_queue<queued_t> queue;
+
+    auto const push = [&](unsigned key)
+    {
+        if(counts[key])
+            queue.push({ counts[key], heads[key], key });
+    };
+
+    auto const stale = [&](queued_t const& q) -> bool
+    {
+        return counts[q.key] != q.count || heads[q.key] != q.first;
+    };
+
+    auto const append = [&](int i)
+    {
+        unsigned const key = pair_key(i);
+        assert(tails[key] < i);
+
+        occ_prev[i] = tails[key];
+        occ_next[i] = NONE;
+        if(tails[key] != NONE)
+            occ_next[tails[key]] = i;
+        else
+            heads[key] = i;
+        tails[key] = i;
+        ++counts[key];
+    };
+
+    auto const unlink = [&](int i)
+    {
+        unsigned const key = pair_key(i);
+
+        if(occ_prev[i] != NONE)
+            occ_next[occ_prev[i]] = occ_next[i];
+        else
+            heads[key] = occ_next[i];
+
+        if(occ_next[i] != NONE)
+            occ_prev[occ_next[i]] = occ_prev[i];
+        else
+            tails[key] = occ_prev[i];
 
-    // Counts how deep each byte pair goes.
+        --counts[key];
+    };
+
+    auto const add = [&](int i)
+    {
+        append(i);
+        push(pair_key(i));
+    };
+
+    auto const remove = [&](int i)
+    {
+        unlink(i);
+        push(pair_key(i));
+    };
+
+    for(int i = 0; i < int(bytes.size()); ++i)
+        if(next[i] != NONE)
+            append(i);
+    for(unsigned key = 0; key < counts.size(); ++key)
+        push(key);
+
+    // Counts how deep each byte pair goes, and how many bytes it expands to.
     // (Maintain same size as 'info.byte_pairs'.)
     std::vector<unsigned> depths;
+    std::vector<unsigned> lengths;
     
     auto const depth = [&](std::uint8_t c) -> unsigned
     {
@@ -322,72 +515,236 @@ void string_literal_manager_t::compress(charmap_t const& charmap, charmap_info_t
         return depths[c - offset];
     };
 
+    auto const length = [&](std::uint8_t c) -> unsigned
+    {
+        if(c < offset)
+            return 1;
+        assert((c - offset) < lengths.size());
+        return lengths[c - offset];
+    };
+
     auto const pair_depth = [&](byte_pair_t const& bp) -> unsigned
     {
-        return std::max(depth(bp[0]), depth(bp[1]));
+        return std::max(depth(bp[0]), depth(bp[1])) + 1;
+    };
+
+    auto const pair_length = [&](byte_pair_t const& bp) -> unsigned
+    {
+        return length(bp[0]) + length(bp[1]);
     };
 
-    // As the assembly decompressor uses recursion, 
+    auto const to_pair = [](unsigned key) -> byte_pair_t
+    {
+        return {{ std::uint8_t(key), std::uint8_t(key >> 8) }};
+    };
+
+    // The assembly decompressors count bytes of each expansion using a single byte.
+    constexpr unsigned MAX_LENGTH = 255;
+
+    // As the recursive decompressor uses the stack,
     // we should limit the depth to prevent stack overflows.
+    // Flat decompressors don't recurse, so only the length matters.
     constexpr unsigned MAX_DEPTH = 32;
+    bool const flat = mod_test(charmap.mods(), MOD_flat);
 
-    while(info.byte_pairs.size() < max_byte_pairs)
+    auto const too_big = [&](byte_pair_t const& bp) -> bool
     {
-        pair_map.clear();
+        return pair_length(bp) > MAX_LENGTH || (!flat && pair_depth(bp) > MAX_DEPTH);
+    };
 
-        // Count how often each pair appears:
-        for(auto const& p : info.compressed)
+    while(info.byte_pairs.size() < max_byte_pairs)
+    {
+        // Find the most common pair that isn't too big:
+        std::vector<queued_t> skipped;
+        queued_t top = {};
+        while(!queue.empty())
         {
-            std::string const& str = p.first;
+            top = queue.top();
+            queue.pop();
 
-            int const to = int(str.size()) - 1;
-            for(int i = 0; i < to; ++i)
-                pair_map[{ str[i], str[i+1] }] += 1;
+            if(stale(top))
+                top = {};
+            else if(too_big(to_pair(top.key)))
+            {
+                skipped.push_back(top);
+                top = {};
+            }
+            else
+                break;
         }
 
-        // If there's no pairs, abort!
-        if(pair_map.empty())
-            break;
-
-        rh::apair<byte_pair_t, unsigned> const* most_common = nullptr;
-        auto it = pair_map.begin();
-        for(; it != pair_map.end(); ++it)
-            if(pair_depth(it->first) < MAX_DEPTH)
-                goto new_most_common;
-        for(; it != pair_map.end(); ++it)
-            if(it->second > most_common->second && pair_depth(it->first) < MAX_DEPTH)
-                new_most_common: most_common = &*it;
+        for(queued_t const& q : skipped)
+            queue.push(q);
 
         // No point in replacing if it hardly occurs:
-        if(!most_common || most_common->second <= 2)
+        if(top.count <= 2)
             break;
 
-        assert(pair_depth(most_common->first) < MAX_DEPTH);
+        unsigned const key = top.key;
+        byte_pair_t const most_common = to_pair(key);
 
-        // Do the replacement
-        char const replacement = static_cast<char>(offset + info.byte_pairs.size());
-        for(auto& p : info.compressed)
+        // Do the replacement, left to right.
+        // New occurrences can't be created, as they'd contain 'replacement'.
+        std::uint8_t const replacement = offset + info.byte_pairs.size();
+        while(heads[key] != NONE)
         {
-            std::string& str = p.first;
+            int const i = heads[key];
+            int const p = prev[i];
+            int const j = next[i];
+            int const n = next[j];
+
+            if(p != NONE)
+                remove(p);
+            remove(i);
+            if(n != NONE)
+                remove(j);
+
+            bytes[i] = replacement;
+            next[i] = n;
+            if(n != NONE)
+                prev[n] = i;
+
+            if(p != NONE)
+                add(p);
+            if(n != NONE)
+                add(i);
+        }
+
+        info.byte_pairs.push_back(most_common);
+        depths.push_back(pair_depth(most_common));
+        lengths.push_back(pair_length(most_common));
+        info.max_depth = std::max(info.max_depth, depths.back());
+        info.max_length = std::max(info.max_length, lengths.back());
+    }
 
-            unsigned const size = str.size();
-            unsigned j = 0;
-            for(unsigned i = 0; i < size; ++i, ++j)
+    // Write the compressed strings back:
+    unsigned string_i = 0;
+    for(auto& p : info.compressed)
+    {
+        std::string& str = p.first;
+        unsigned j = 0;
+        if(!str.empty())
+            for(int i = starts[string_i]; i != NONE; i = next[i])
+                str[j++] = bytes[i];
+        str.resize(j);
+        ++string_i;
+    }
+}
+
+void string_literal_manager_t::flatten(charmap_t const& charmap, charmap_info_t& info)
+{
+    // Expansions are stored reversed, letting decompressors index them while counting down.
+    // As the reversed expansion of a pair contains those of its own pairs,
+    // most expansions end up inside others and take no extra space.
+
+    assert(compiler_phase() == PHASE_COMPRESS_STRINGS);
+    assert(info.flat.empty());
+
+    unsigned const offset = charmap.size();
+    unsigned const num_pairs = info.byte_pairs.size();
+
+    std::vector<std::string> expansions(num_pairs);
+    for(unsigned i = 0; i < num_pairs; ++i)
+    {
+        for(std::uint8_t c : info.byte_pairs[i])
+        {
+            if(c < offset)
+                expansions[i].push_back(c);
+            else
             {
-                if(i+1 < size
-                   && str[i+0] == most_common->first[0]
-                   && str[i+1] == most_common->first[1])
-                {
-                    str[j] = replacement;
-                    ++i;
-                }
-                else
-                    str[j] = str[i];
+                assert(c - offset < i);
+                expansions[i] += expansions[c - offset];
             }
-            str.resize(j);
+        }
+    }
+
+    for(std::string& expansion : expansions)
+        std::reverse(expansion.begin(), expansion.end());
+
+    // Placing longer expansions first gives the shorter ones something to be found in.
+    std::vector<unsigned> order(num_pairs);
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](unsigned a, unsigned b)
+    {
+        return expansions[a].size() > expansions[b].size();
+    });
+
+    std::string flat;
+    info.flat_offsets.resize(num_pairs);
+    info.flat_lengths.resize(num_pairs);
+    for(unsigned i : order)
+    {
+        std::string const& expansion = expansions[i];
+        assert(expansion.size() >= 2 && expansion.size() <= 255);
+
+        std::size_t at = flat.find(expansion);
+        if(at == std::string::npos)
+        {
+            // Overlap with the end of the table, if possible:
+            std::size_t overlap = std::min(flat.size(), expansion.size() - 1);
+            for(; overlap > 0; --overlap)
+                if(flat.compare(flat.size() - overlap, overlap, expansion, 0, overlap) == 0)
+                    break;
+
+            at = flat.size() - overlap;
+            flat.append(expansion, overlap);
         }
 
-        info.byte_pairs.push_back(most_common->first);
-        depths.push_back(pair_depth(most_common->first));
+        assert(at <= 0xFFFF);
+        info.flat_offsets[i] = at;
+        info.flat_lengths[i] = expansion.size();
     }
+
+    info.flat.assign(flat.begin(), flat.end());
+}
+
+// Worst-case cycles to decompress one character, including the 'jsr' to do so.
+// Bank switching isn't included, and branches are assumed to not cross pages.
+// These must match 'lib/decompress_string.fab' and 'lib/decompress_string_flat.fab'.
+static unsigned recursive_decode_cycles(unsigned max_length)
+{
+    assert(max_length >= 1);
+
+    // The worst case finishes one expansion, skipping every byte of it,
+    // then returns the last byte of the next.
+    constexpr unsigned ENTRY = 18;
+    constexpr unsigned READ = 11;    // Reading a byte of the string.
+    constexpr unsigned ADVANCE = 23; // Moving to the next byte of the string.
+    constexpr unsigned PAIR = 30;    // Expanding a pair.
+    constexpr unsigned SKIP = 19;    // Skipping an already returned byte.
+    constexpr unsigned RETURN = 32;  // Returning a byte.
+
+    unsigned const pairs = max_length - 1;
+    return (ENTRY 
+            + READ + pairs * PAIR + max_length * SKIP
+            + ADVANCE
+            + READ + pairs * PAIR + (max_length - 1) * SKIP + RETURN);
+}
+
+static constexpr unsigned flat_decode_cycles()
+{
+    // Reading a pair from the string, then returning the first byte of its expansion.
+    return 95;
+}
+
+void string_literal_manager_t::write_info(charmap_t const& charmap, charmap_info_t const& info) const
+{
+    std::filesystem::create_directory("info/");
+    std::ofstream of(fmt("info/%.txt", charmap.global.name));
+    if(!of.is_open())
+        return;
+
+    bool const flat = mod_test(charmap.mods(), MOD_flat);
+
+    of << "charmap " << charmap.global.name << (flat ? " (flat)" : "") << '\n';
+    of << "characters:     " << charmap.size() << '\n';
+    of << "pairs:          " << info.byte_pairs.size() << '\n';
+    of << "max depth:      " << info.max_depth << '\n';
+    of << "max expansion:  " << info.max_length << '\n';
+    if(flat)
+        of << "flat table:     " << info.flat.size() << " bytes\n";
+
+    of << "worst-case decode: " 
+       << (flat ? flat_decode_cycles() : recursive_decode_cycles(info.max_length)) 
+       << " cycles per character, plus bank switching\n";
 }
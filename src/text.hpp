@@ -38,6 +38,11 @@ public:
     rom_array_ht get_rom_array(global_t const* charmap, unsigned index, bool compressed);
     std::pair<ct_array_t, unsigned> get_byte_pairs(global_t const* charmap);
 
+    // For '+flat' charmaps, which expand pairs using a table rather than recursion.
+    std::pair<ct_array_t, unsigned> get_flat(global_t const* charmap);
+    std::pair<ct_array_t, unsigned> get_flat_offsets(global_t const* charmap);
+    std::pair<ct_array_t, unsigned> get_flat_lengths(global_t const* charmap);
+
     void convert_all();
     void compress_all();
 
@@ -61,10 +66,21 @@ private:
         rh::joker_map<std::string, data_t> compressed;
         rh::joker_map<std::string, data_t> uncompressed;
         std::vector<byte_pair_t> byte_pairs;
+
+        // The expansion of every pair, reversed, and overlapped where possible.
+        // Only built for '+flat' charmaps.
+        std::vector<std::uint8_t> flat;
+        std::vector<std::uint16_t> flat_offsets; // Pairs with 'byte_pairs'.
+        std::vector<std::uint8_t> flat_lengths;  // Pairs with 'byte_pairs'.
+
+        unsigned max_depth = 0;
+        unsigned max_length = 1;
     };
 
     void convert(charmap_t const& charmap, charmap_info_t& info);
     void compress(charmap_t const& charmap, charmap_info_t& info);
+    void flatten(charmap_t const& charmap, charmap_info_t& info);
+    void write_info(charmap_t const& charmap, charmap_info_t const& info) const;
 
     std::mutex mutex;
     rh::joker_map<global_t const*, charmap_info_t> m_map;
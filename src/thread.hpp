@@ -5,7 +5,11 @@
 #define NO_THREAD
 #endif
 
+#include <cassert>
+#include <condition_variable>
 #include <exception>
+#include <functional>
+#include <mutex>
 #include <vector>
 #include <atomic>
 #ifndef NO_THREAD
@@ -19,7 +23,142 @@
 #define TLS thread_local
 #endif
 
-// Launches a bunch of threads and waits until they finish.
+// A set of long-lived worker threads, shared by every parallel phase.
+// Reusing the same threads avoids spawning new ones each phase,
+// and keeps their thread-local state (pools, buffers) warm between phases.
+// The thread calling 'run' acts as worker 0.
+class thread_pool_t
+{
+public:
+    thread_pool_t() = default;
+    thread_pool_t(thread_pool_t const&) = delete;
+    thread_pool_t& operator=(thread_pool_t const&) = delete;
+    ~thread_pool_t() { stop(); }
+
+    unsigned size() const { return m_size; }
+
+    // (Re)starts the pool with 'num_threads' workers.
+    // 'thread_init' gets called once by each worker, including the calling thread.
+    void start(unsigned num_threads, std::function<void()> thread_init = {})
+    {
+        assert(num_threads > 0);
+        stop();
+
+        m_thread_init = std::move(thread_init);
+        if(m_thread_init)
+            m_thread_init();
+
+        m_size = num_threads;
+#ifndef NO_THREAD
+        m_threads.reserve(num_threads - 1);
+        for(unsigned i = 1; i < num_threads; ++i)
+            m_threads.emplace_back([this, i, generation = m_generation]{ worker_loop(i, generation); });
+#endif
+    }
+
+    // Restarts the pool with a different number of workers, keeping the same 'thread_init'.
+    void resize(unsigned num_threads)
+    {
+        if(num_threads != m_size)
+            start(num_threads, m_thread_init);
+    }
+
+    // Joins every worker thread.
+    void stop()
+    {
+#ifndef NO_THREAD
+        {
+            std::lock_guard lock(m_mutex);
+            m_stopping = true;
+        }
+        m_start_cv.notify_all();
+
+        for(std::thread& thread : m_threads)
+            thread.join();
+        m_threads.clear();
+        m_stopping = false;
+#endif
+        m_size = 0;
+    }
+
+    // Calls 'job(worker_i)' on every worker and waits until they all return.
+    // This acts as a barrier between phases.
+    // 'job' must not throw.
+    void run(std::function<void(unsigned)> const& job)
+    {
+        assert(m_size > 0);
+#ifndef NO_THREAD
+        if(m_size > 1)
+        {
+            {
+                std::lock_guard lock(m_mutex);
+                m_job = &job;
+                m_running = m_size - 1;
+                ++m_generation;
+            }
+            m_start_cv.notify_all();
+
+            job(0);
+
+            std::unique_lock lock(m_mutex);
+            m_done_cv.wait(lock, [this]{ return m_running == 0; });
+            m_job = nullptr;
+            return;
+        }
+#endif
+        job(0);
+    }
+
+private:
+#ifndef NO_THREAD
+    void worker_loop(unsigned worker_i, unsigned generation)
+    {
+        if(m_thread_init)
+            m_thread_init();
+
+        while(true)
+        {
+            std::function<void(unsigned)> const* job;
+
+            {
+                std::unique_lock lock(m_mutex);
+                m_start_cv.wait(lock, [&]{ return m_stopping || m_generation != generation; });
+                if(m_stopping)
+                    return;
+                generation = m_generation;
+                job = m_job;
+            }
+
+            (*job)(worker_i);
+
+            bool done;
+            {
+                std::lock_guard lock(m_mutex);
+                done = --m_running == 0;
+            }
+            if(done)
+                m_done_cv.notify_one();
+        }
+    }
+
+    std::vector<std::thread> m_threads;
+    std::mutex m_mutex;
+    std::condition_variable m_start_cv;
+    std::condition_variable m_done_cv;
+    std::function<void(unsigned)> const* m_job = nullptr;
+    unsigned m_generation = 0;
+    unsigned m_running = 0;
+    bool m_stopping = false;
+#endif
+    std::function<void()> m_thread_init;
+    unsigned m_size = 0;
+};
+
+// The pool used by 'parallelize'.
+// Start it once at startup, using 'thread_pool.start'.
+inline thread_pool_t thread_pool;
+
+// Runs 'fn' on 'num_threads' workers of 'thread_pool', and waits until they finish.
 template<typename Fn, typename OnError>
 void parallelize(unsigned const num_threads, Fn const& fn, OnError const& on_error)
 {
@@ -29,42 +168,35 @@ void parallelize(unsigned const num_threads, Fn const& fn, OnError const& on_err
     fn(exception_thrown);
     return;
 #else
-    std::vector<std::thread> threads;
-    threads.reserve(num_threads);
-
-    std::vector<std::exception_ptr> exception_ptrs;
-    exception_ptrs.resize(num_threads, nullptr);
-
     if(num_threads == 1)
     {
         fn(exception_thrown);
         return;
     }
 
-    for(unsigned i = 0; i < num_threads; ++i)
+    thread_pool.resize(num_threads);
+
+    std::vector<std::exception_ptr> exception_ptrs;
+    exception_ptrs.resize(num_threads, nullptr);
+
+    thread_pool.run(
+    [&fn, &exception_thrown, &on_error, &exception_ptrs](unsigned worker_i)
     {
-        threads.emplace_back(
-        [&fn, &exception_thrown, &on_error](std::exception_ptr& exception_ptr)
+        try
         {
-            try
-            {
-                fn(exception_thrown);
-            }
-            catch(...)
-            {
-                exception_ptr = std::current_exception();
-                exception_thrown = true;
-                on_error();
-            }
-        }, std::ref(exception_ptrs[i]));
-    }
+            fn(exception_thrown);
+        }
+        catch(...)
+        {
+            exception_ptrs[worker_i] = std::current_exception();
+            exception_thrown = true;
+            on_error();
+        }
+    });
 
     for(unsigned i = 0; i < num_threads; ++i)
-    {
-        threads[i].join();
         if(exception_ptrs[i])
             std::rethrow_exception(exception_ptrs[i]);
-    }
 #endif
 }
 
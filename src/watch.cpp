@@ -0,0 +1,163 @@
+#include "watch.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <mutex>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "platform.hpp"
+
+#ifdef PLATFORM_UNIX
+#  include <sys/types.h>
+#  include <sys/wait.h>
+#  include <unistd.h>
+#endif
+
+#include "phase.hpp"
+
+namespace
+{
+    std::mutex watch_mutex;
+
+    // In child processes, the write end of a pipe to the watching process.
+    int watch_fd = -1;
+
+    // Files read while handling options. Changing these restarts the watcher.
+    std::vector<fs::path> config_files;
+}
+
+void watch_file(fs::path const& path)
+{
+    std::error_code ec;
+    fs::path const absolute = fs::absolute(path, ec);
+    if(ec)
+        return;
+
+    std::lock_guard<std::mutex> lock(watch_mutex);
+
+#ifdef PLATFORM_UNIX
+    if(watch_fd >= 0)
+    {
+        std::string const line = absolute.string() + '\n';
+        for(std::size_t written = 0; written < line.size();)
+        {
+            ssize_t const n = ::write(watch_fd, line.data() + written, line.size() - written);
+            if(n < 0 && errno != EINTR)
+                return;
+            if(n > 0)
+                written += n;
+        }
+        return;
+    }
+#endif
+
+    if(compiler_phase() == PHASE_INIT)
+        config_files.push_back(absolute);
+}
+
+void watch(int argc, char** argv)
+{
+#ifdef PLATFORM_UNIX
+    using namespace std::literals;
+
+    auto const write_time = [](fs::path const& path)
+    {
+        std::error_code ec;
+        fs::file_time_type const time = fs::last_write_time(path, ec);
+        return ec ? fs::file_time_type::min() : time;
+    };
+
+    while(true)
+    {
+        int fds[2];
+        if(::pipe(fds) != 0)
+            throw std::runtime_error("Unable to create pipe.");
+
+        std::fflush(stdout);
+        std::fflush(stderr);
+
+        pid_t const pid = ::fork();
+        if(pid < 0)
+            throw std::runtime_error("Unable to fork.");
+
+        if(pid == 0)
+        {
+            // Child process; go compile.
+            ::close(fds[0]);
+            watch_fd = fds[1];
+            return;
+        }
+
+        ::close(fds[1]);
+
+        // Collect every file the build read:
+        std::set<fs::path> inputs(config_files.begin(), config_files.end());
+        {
+            std::string line;
+            char buffer[4096];
+            while(true)
+            {
+                ssize_t const n = ::read(fds[0], buffer, sizeof(buffer));
+                if(n < 0 && errno == EINTR)
+                    continue;
+                if(n <= 0)
+                    break;
+
+                for(ssize_t i = 0; i < n; ++i)
+                {
+                    if(buffer[i] == '\n')
+                    {
+                        inputs.insert(line);
+                        line.clear();
+                    }
+                    else
+                        line.push_back(buffer[i]);
+                }
+            }
+            ::close(fds[0]);
+        }
+
+        int status;
+        while(::waitpid(pid, &status, 0) < 0 && errno == EINTR);
+
+        std::vector<std::pair<fs::path, fs::file_time_type>> times;
+        for(fs::path const& path : inputs)
+            times.emplace_back(path, write_time(path));
+
+        std::printf("Watching %u files for changes...\n", unsigned(times.size()));
+        std::fflush(stdout);
+
+        fs::path const* changed = nullptr;
+        while(!changed)
+        {
+            std::this_thread::sleep_for(100ms);
+
+            for(auto const& pair : times)
+                if(write_time(pair.first) != pair.second)
+                    changed = &pair.first;
+        }
+
+        // Editors often save in several steps. Let them finish:
+        std::this_thread::sleep_for(50ms);
+
+        std::printf("Changed: %s\n", changed->string().c_str());
+
+        // Options are only read once, so restart if they changed:
+        if(std::find(config_files.begin(), config_files.end(), *changed) != config_files.end())
+        {
+            std::fflush(stdout);
+            ::execvp(argv[0], argv);
+            throw std::runtime_error("Unable to restart.");
+        }
+    }
+#else
+    throw std::runtime_error("--watch is not supported on this platform.");
+#endif
+}
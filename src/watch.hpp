@@ -0,0 +1,21 @@
+#ifndef WATCH_HPP
+#define WATCH_HPP
+
+// Implements '--watch', which rebuilds whenever an input file changes.
+//
+// The compiler's state can only move forward through its phases,
+// so each rebuild happens in a freshly forked process.
+// Combined with the compile cache, unchanged functions skip code generation.
+
+#include <filesystem>
+
+namespace fs = ::std::filesystem;
+
+// Records a file the build depends on.
+void watch_file(fs::path const& path);
+
+// Keeps rebuilding until killed. Only returns in a child process,
+// which should then compile as normal.
+void watch(int argc, char** argv);
+
+#endif